@@ -0,0 +1,280 @@
+// bufcache.cc
+//	Routines to cache disk sectors in memory, see bufcache.h.
+//
+//	The cache lock is never held across a disk transfer, so that a
+//	thread missing in the cache doesn't hold up the hits of the
+//	others.  Instead, the entry being transferred is marked busy, and
+//	anyone who wants it waits on "ioDone".  In particular, a dirty
+//	victim stays visible under its old sector number until it has
+//	been written back, so nobody reads a stale copy from the disk.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "bufcache.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// BufferCache::BufferCache
+// 	Initialize an empty cache.
+//
+//	"cacheDisk" -- the synchronous disk the sectors come from
+//	"numSectors" -- how many sectors to keep in memory; 0 disables
+//		the cache
+//----------------------------------------------------------------------
+
+BufferCache::BufferCache(SynchDisk *cacheDisk, int numSectors)
+{
+    disk = cacheDisk;
+    numEntries = numSectors;
+    entries = new CacheEntry[numEntries];
+    for (int i = 0; i < numEntries; i++) {
+	entries[i].sector = -1;
+	entries[i].dirty = false;
+	entries[i].busy = false;
+	entries[i].lastUsed = 0;
+    }
+    clock = 0;
+    hits = misses = readsAvoided = sectorWrites = writeBacks = 0;
+    lock = new Lock("buffer cache lock");
+    ioDone = new Condition("buffer cache io");
+}
+
+//----------------------------------------------------------------------
+// BufferCache::~BufferCache
+// 	Write back whatever is still dirty, then de-allocate the cache.
+//	This happens when Nachos halts, possibly on behalf of a thread
+//	that is finishing and can't block anymore, so the sectors are
+//	written with polled I/O.  Busy entries are left alone: they are
+//	either being read, or being written back already.
+//----------------------------------------------------------------------
+
+BufferCache::~BufferCache()
+{
+    for (int i = 0; i < numEntries; i++) {
+	CacheEntry *e = &entries[i];
+	if (e->dirty && !e->busy) {
+	    disk->WriteSectorPolled(e->sector, e->data);
+	    writeBacks++;
+	}
+    }
+    delete ioDone;
+    delete lock;
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Victim
+// 	Return the least recently used entry that is not busy, NULL if
+//	they all are.  The cache lock must be held.
+//----------------------------------------------------------------------
+
+CacheEntry *
+BufferCache::Victim()
+{
+    CacheEntry *victim = NULL;
+
+    for (int i = 0; i < numEntries; i++) {
+	CacheEntry *e = &entries[i];
+	if (e->busy)
+	    continue;
+	if (e->sector == -1)
+	    return e;				// free entry, take it
+	if (victim == NULL || e->lastUsed < victim->lastUsed)
+	    victim = e;
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Acquire
+// 	Return the entry caching "sector", loading it from disk if
+//	needed.  Returns with the cache lock held; the caller copies
+//	what it needs and releases it.
+//
+//	"wholeSector" -- the caller is about to overwrite the whole
+//		sector, so don't bother reading it from disk
+//----------------------------------------------------------------------
+
+CacheEntry *
+BufferCache::Acquire(int sector, bool wholeSector)
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    for (;;) {
+	std::unordered_map<int, CacheEntry *>::iterator found =
+	    lookup.find(sector);
+	if (found != lookup.end()) {
+	    e = found->second;
+	    if (e->busy) {			// being transferred, wait
+		ioDone->Wait(lock);
+		continue;
+	    }
+	    hits++;
+	    if (!wholeSector)
+		readsAvoided++;
+	    e->lastUsed = ++clock;
+	    return e;
+	}
+
+	e = Victim();
+	if (e == NULL) {			// everything is in transit
+	    ioDone->Wait(lock);
+	    continue;
+	}
+	if (e->dirty) {				// write the victim back first
+	    e->busy = true;
+	    lock->Release();
+	    disk->WriteSector(e->sector, e->data);
+	    lock->Acquire();
+	    e->busy = false;
+	    e->dirty = false;
+	    writeBacks++;
+	    ioDone->Broadcast(lock);
+	    continue;				// someone may have loaded
+						// "sector" meanwhile
+	}
+
+	if (e->sector != -1)
+	    lookup.erase(e->sector);
+	e->sector = sector;
+	e->lastUsed = ++clock;
+	lookup[sector] = e;
+	if (!wholeSector) {
+	    misses++;
+	    e->busy = true;
+	    lock->Release();
+	    disk->ReadSector(sector, e->data);
+	    lock->Acquire();
+	    e->busy = false;
+	    ioDone->Broadcast(lock);
+	}
+	return e;
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadBytes
+// 	Copy "numBytes" bytes of "sector", starting at "offset", into
+//	"into".
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadBytes(int sector, int offset, int numBytes, char *into)
+{
+    ASSERT(offset >= 0 && numBytes >= 0 && offset + numBytes <= SectorSize);
+    if (journal != NULL && journal->Read(sector, offset, numBytes, into))
+	return;					// written by the transaction
+    if (numEntries == 0) {			// no cache
+	char buf[SectorSize];
+	misses++;
+	disk->ReadSector(sector, buf);
+	bcopy(&buf[offset], into, numBytes);
+	return;
+    }
+    CacheEntry *e = Acquire(sector, false);
+    bcopy(&e->data[offset], into, numBytes);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteBytes
+// 	Copy "numBytes" bytes from "from" into "sector", starting at
+//	"offset".  The sector is only written to disk later, when it
+//	leaves the cache.  Writes that are part of a metadata transaction
+//	only reach the cache once the transaction is in the log.
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteBytes(int sector, int offset, int numBytes,
+			const char *from)
+{
+    bool wholeSector = (offset == 0 && numBytes == SectorSize);
+
+    ASSERT(offset >= 0 && numBytes >= 0 && offset + numBytes <= SectorSize);
+    if (journal != NULL && journal->Write(sector, offset, numBytes, from))
+	return;					// held until the commit
+    sectorWrites++;
+    if (numEntries == 0) {			// no cache, write through
+	char buf[SectorSize];
+	if (!wholeSector) {
+	    misses++;
+	    disk->ReadSector(sector, buf);
+	}
+	bcopy(from, &buf[offset], numBytes);
+	disk->WriteSector(sector, buf);
+	writeBacks++;
+	return;
+    }
+    CacheEntry *e = Acquire(sector, wholeSector);
+    bcopy(from, &e->data[offset], numBytes);
+    e->dirty = true;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadSector/WriteSector
+// 	Read or write a whole sector through the cache.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadSector(int sector, char *data)
+{
+    ReadBytes(sector, 0, SectorSize, data);
+}
+
+void
+BufferCache::WriteSector(int sector, const char *data)
+{
+    WriteBytes(sector, 0, SectorSize, data);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Flush
+// 	Write every dirty sector back to disk.  The sectors stay cached.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Flush()
+{
+    lock->Acquire();
+    for (int i = 0; i < numEntries; i++) {
+	CacheEntry *e = &entries[i];
+	while (e->busy)
+	    ioDone->Wait(lock);
+	if (!e->dirty)
+	    continue;
+	e->busy = true;
+	lock->Release();
+	disk->WriteSector(e->sector, e->data);
+	lock->Acquire();
+	e->busy = false;
+	e->dirty = false;
+	writeBacks++;
+	ioDone->Broadcast(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Print
+// 	Print how well the cache did.  Without it, every sector read and
+//	every partial sector write would have read the disk, and every
+//	sector write would have written it.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Print()
+{
+    int requests = hits + misses;
+
+    printf("Buffer cache: %d sectors, hits %d, misses %d, "
+	   "hit ratio %.1f%%\n", numEntries, hits, misses,
+	   requests > 0 ? 100.0 * hits / requests : 0.0);
+    printf("Buffer cache: disk reads saved %d, "
+	   "disk writes saved %d so far\n",
+	   readsAvoided, sectorWrites - writeBacks);
+}
@@ -0,0 +1,88 @@
+// bufcache.h
+//	Data structures for a write-back cache of disk sectors, sitting
+//	between the file system and the synchronous disk.
+//
+//	Every sector the file system reads or writes goes through the
+//	cache.  Reads of cached sectors, and writes of any sector that
+//	is cached or entirely overwritten, don't touch the disk.
+//	Modified sectors are written back when they are evicted (least
+//	recently used first), or when the cache is flushed at shutdown.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BUFCACHE_H
+#define BUFCACHE_H
+
+#include <unordered_map>
+
+#include "copyright.h"
+#include "disk.h"
+#include "synch.h"
+#include "synchdisk.h"
+
+// Default number of sectors kept in the cache, see the -bc flag
+#define DefaultCacheSectors 	32
+
+// One cached sector.  "busy" is set while the sector is being read
+// from or written to disk; other threads that want it wait until
+// the transfer is done.
+
+class CacheEntry {
+  public:
+    int sector;			// sector cached here, -1 if none
+    bool dirty;			// modified since read from disk
+    bool busy;			// disk transfer in progress
+    int lastUsed;		// clock value of the last access, for LRU
+    char data[SectorSize];	// contents of the sector
+};
+
+// The following class defines the cache itself.  With zero entries
+// every request goes straight to the disk.
+
+class BufferCache {
+  public:
+    BufferCache(SynchDisk *cacheDisk, int numSectors);
+    				// Initialize an empty cache of
+				// "numSectors" sectors in front of the disk
+    ~BufferCache();		// Flush and de-allocate the cache
+
+    void ReadSector(int sector, char *data);	// Read a whole sector
+    void WriteSector(int sector, const char *data);
+    						// Write a whole sector
+
+    void ReadBytes(int sector, int offset, int numBytes, char *into);
+    				// Read part of a sector
+    void WriteBytes(int sector, int offset, int numBytes, const char *from);
+    				// Write part of a sector; only reads it
+				// from disk if it's not already cached
+
+    void Flush();		// Write every dirty sector back to disk
+
+    void Print();		// Print hit ratio and disk I/O saved
+
+    int hits;			// requests served from the cache
+    int misses;			// requests that had to read the disk
+    int readsAvoided;		// disk reads saved by the cache
+    int sectorWrites;		// write requests
+    int writeBacks;		// dirty sectors actually written to disk
+
+  private:
+    CacheEntry *Acquire(int sector, bool wholeSector);
+				// Find or load "sector", returns it
+				// with the cache lock held
+    CacheEntry *Victim();	// Entry to reuse, the least recently used
+				// one that is not busy
+
+    SynchDisk *disk;		// where the sectors come from
+    int numEntries;		// size of the cache, in sectors
+    CacheEntry *entries;	// the cached sectors
+    std::unordered_map<int, CacheEntry *> lookup;
+				// sector -> entry caching it
+    int clock;			// access counter, for LRU
+    Lock *lock;			// protects everything above
+    Condition *ioDone;		// signalled when a busy entry is done
+};
+
+#endif // BUFCACHE_H
@@ -0,0 +1,122 @@
+// dcache.cc
+//	Routines to cache directory lookups, see dcache.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "utility.h"
+#include "dcache.h"
+#include "directory.h"
+
+//----------------------------------------------------------------------
+// KeyOf
+// 	Return the key of "name" in the directory at "dirSector".  Names
+//	are cut at FileNameMaxLen, as in the directory itself.
+//----------------------------------------------------------------------
+
+static std::string
+KeyOf(int dirSector, const char *name)
+{
+    return std::to_string(dirSector) + "/" +
+	   std::string(name, strnlen(name, FileNameMaxLen));
+}
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty cache.
+//
+//	"size" -- the most names to keep
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache(int size)
+{
+    capacity = size;
+    hits = misses = 0;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Look up "name" in the directory whose header is at "dirSector".
+//	Return false if we don't know; otherwise return true, and where
+//	the file's header is in "sector", and whether it is a directory
+//	in "isDirectory".
+//----------------------------------------------------------------------
+
+bool
+DentryCache::Lookup(int dirSector, const char *name, int *sector,
+		    bool *isDirectory)
+{
+    std::unordered_map<std::string, std::list<Dentry>::iterator>::iterator
+	found = lookup.find(KeyOf(dirSector, name));
+
+    if (found == lookup.end()) {
+	misses++;
+	return false;
+    }
+    hits++;
+    lru.splice(lru.begin(), lru, found->second);	// most recent now
+    *sector = found->second->sector;
+    *isDirectory = found->second->isDirectory;
+    return true;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Insert
+// 	Remember that "name", in the directory at "dirSector", has its
+//	header at "sector".  Drops the least recently used name if the
+//	cache is full.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Insert(int dirSector, const char *name, int sector,
+		    bool isDirectory)
+{
+    if (capacity == 0)
+	return;
+    Remove(dirSector, name);
+    if ((int) lru.size() == capacity) {
+	lookup.erase(lru.back().key);
+	lru.pop_back();
+    }
+
+    Dentry dentry;
+    dentry.key = KeyOf(dirSector, name);
+    dentry.sector = sector;
+    dentry.isDirectory = isDirectory;
+    lru.push_front(dentry);
+    lookup[dentry.key] = lru.begin();
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Remove
+// 	Forget "name" in the directory at "dirSector", if it is cached.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Remove(int dirSector, const char *name)
+{
+    std::unordered_map<std::string, std::list<Dentry>::iterator>::iterator
+	found = lookup.find(KeyOf(dirSector, name));
+
+    if (found == lookup.end())
+	return;
+    lru.erase(found->second);
+    lookup.erase(found);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Print
+// 	Print how many lookups the cache saved.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Print()
+{
+    int lookups = hits + misses;
+
+    printf("Dentry cache: %d names, hits %d, misses %d, hit ratio %.1f%%\n",
+	   (int) lru.size(), hits, misses,
+	   lookups > 0 ? 100.0 * hits / lookups : 0.0);
+}
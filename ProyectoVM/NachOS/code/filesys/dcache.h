@@ -0,0 +1,68 @@
+// dcache.h
+//	Data structures for a cache of directory entries ("dentries").
+//
+//	Resolving a path name means looking up each of its components
+//	in the directory above it, which would read every directory on
+//	the way from disk.  The dentry cache remembers the result of
+//	recent lookups -- <directory sector, name> -> <sector, is it a
+//	directory> -- so that opening a file whose path was resolved
+//	recently doesn't read any directory at all.
+//
+//	Only names that exist are cached.  The file system removes a
+//	name from the cache when it removes it from its directory.
+//
+//      We assume mutual exclusion is provided by the caller.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "copyright.h"
+
+// Default number of names kept in the cache
+#define DentryCacheSize 	64
+
+// One cached lookup.
+class Dentry {
+  public:
+    std::string key;			// directory sector and name
+    int sector;				// sector of the file's header
+    bool isDirectory;			// is the file a directory?
+};
+
+// The following class defines the cache.  When it is full, the least
+// recently used name is dropped.
+
+class DentryCache {
+  public:
+    DentryCache(int size);		// Initialize an empty cache
+
+    bool Lookup(int dirSector, const char *name, int *sector,
+		bool *isDirectory);	// Look up "name" in the directory
+					// whose header is at "dirSector";
+					// false if not cached
+    void Insert(int dirSector, const char *name, int sector,
+		bool isDirectory);	// Remember the result of a lookup
+    void Remove(int dirSector, const char *name);
+    					// Forget a name
+
+    void Print();			// Print the hit ratio
+
+    int hits;				// lookups answered by the cache
+    int misses;				// lookups that had to read a directory
+
+  private:
+    std::list<Dentry> lru;		// cached names, most recent first
+    std::unordered_map<std::string, std::list<Dentry>::iterator> lookup;
+    					// key -> its place in "lru"
+    int capacity;			// most names to keep
+};
+
+#endif // DCACHE_H
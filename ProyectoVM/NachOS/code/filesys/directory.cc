@@ -11,10 +11,8 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	When all the entries are used, the table doubles in size; the
+//	directory file grows as the new entries are written back.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -25,6 +23,18 @@
 #include "filehdr.h"
 #include "directory.h"
 
+//----------------------------------------------------------------------
+// KeyOf
+// 	Return the part of "name" that is stored in a directory entry,
+//	as the key of the hash table.
+//----------------------------------------------------------------------
+
+static std::string
+KeyOf(const char *name)
+{
+    return std::string(name, strnlen(name, FileNameMaxLen));
+}
+
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
@@ -39,8 +49,13 @@ Directory::Directory(int size)
 {
     table = new DirectoryEntry[size];
     tableSize = size;
-    for (int i = 0; i < tableSize; i++)
+    for (int i = tableSize - 1; i >= 0; i--) {
 	table[i].inUse = false;
+	freeEntries.push_back(i);
+    }
+    firstDirty = lastDirty = -1;
+    for (int i = 0; i < tableSize; i++)	// nothing on disk yet
+	Changed(i);
 }
 
 //----------------------------------------------------------------------
@@ -55,7 +70,9 @@ Directory::~Directory()
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk, and index the
+//	names in use.  The directory has as many entries as fit in
+//	the file.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,20 +80,82 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
+    delete [] table;
+    tableSize = file->Length() / sizeof(DirectoryEntry);
+    table = new DirectoryEntry[tableSize];
     file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+
+    index.clear();
+    freeEntries.clear();
+    for (int i = tableSize - 1; i >= 0; i--) {
+	if (table[i].inUse)
+	    index[KeyOf(table[i].name)] = i;
+	else
+	    freeEntries.push_back(i);
+    }
+    firstDirty = lastDirty = -1;
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Only
+//	the entries changed since the directory was read are written;
+//	if they are past the end of the file, the file grows.
+//
+//	Return false if the file couldn't grow to hold them all (the disk
+//	is full); the ones not written stay to be written next time.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 
-void
+bool
 Directory::WriteBack(OpenFile *file)
 {
-    file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    if (firstDirty == -1)
+	return true;			// nothing changed
+    int size = (lastDirty - firstDirty + 1) * sizeof(DirectoryEntry);
+    if (file->WriteAt((char *)&table[firstDirty], size,
+		      firstDirty * sizeof(DirectoryEntry)) != size)
+	return false;
+    firstDirty = lastDirty = -1;
+    return true;
+}
+
+//----------------------------------------------------------------------
+// Directory::Changed
+// 	Remember that entry "i" has to be written back.
+//----------------------------------------------------------------------
+
+void
+Directory::Changed(int i)
+{
+    if (firstDirty == -1 || i < firstDirty)
+	firstDirty = i;
+    if (i > lastDirty)
+	lastDirty = i;
+}
+
+//----------------------------------------------------------------------
+// Directory::Grow
+// 	Double the size of the table, when all the entries are in use.
+//	The new entries only make it to disk once they are used.
+//----------------------------------------------------------------------
+
+void
+Directory::Grow()
+{
+    int newSize = (tableSize > 0) ? 2 * tableSize : 1;
+    DirectoryEntry *newTable = new DirectoryEntry[newSize];
+
+    for (int i = 0; i < tableSize; i++)
+	newTable[i] = table[i];
+    for (int i = newSize - 1; i >= tableSize; i--) {
+	newTable[i].inUse = false;
+	freeEntries.push_back(i);
+    }
+    delete [] table;
+    table = newTable;
+    tableSize = newSize;
 }
 
 //----------------------------------------------------------------------
@@ -90,10 +169,12 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(const char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
-	    return i;
-    return -1;		// name not in directory
+    std::unordered_map<std::string, int>::iterator found =
+	index.find(KeyOf(name));
+
+    if (found == index.end())
+	return -1;		// name not in directory
+    return found->second;
 }
 
 //----------------------------------------------------------------------
@@ -115,31 +196,52 @@ Directory::Find(const char *name)
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Directory::IsDirectory
+// 	Return true if "name" is in the directory, and is a directory
+//	itself.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+bool
+Directory::IsDirectory(const char *name)
+{
+    int i = FindIndex(name);
+
+    return i != -1 && table[i].isDirectory;
+}
+
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return true if successful;
-//	return false if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return false if the file name is already in the directory.  If
+//	the directory is full, it grows.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"isDirectory" -- whether the file added is a directory
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(const char *name, int newSector)
+Directory::Add(const char *name, int newSector, bool isDirectory)
 { 
     if (FindIndex(name) != -1)
 	return false;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = true;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return true;
-	}
-    return false;	// no space.  Fix when we have extensible files.
+    if (freeEntries.empty())
+	Grow();
+    int i = freeEntries.back();
+    freeEntries.pop_back();
+
+    table[i].inUse = true;
+    table[i].isDirectory = isDirectory;
+    strncpy(table[i].name, name, FileNameMaxLen); 
+    table[i].name[FileNameMaxLen] = '\0';
+    table[i].sector = newSector;
+    index[KeyOf(name)] = i;
+    Changed(i);
+    return true;
 }
 
 //----------------------------------------------------------------------
@@ -158,12 +260,27 @@ Directory::Remove(const char *name)
     if (i == -1)
 	return false; 		// name not in directory
     table[i].inUse = false;
+    index.erase(KeyOf(name));
+    freeEntries.push_back(i);
+    Changed(i);
     return true;	
 }
 
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return true if no entry of the directory is in use.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsEmpty()
+{
+    return index.empty();
+}
+
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory. 
+// 	List all the file names in the directory.  Directories are
+//	listed with a trailing '/'.
 //----------------------------------------------------------------------
 
 void
@@ -171,7 +288,7 @@ Directory::List()
 {
    for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+	    printf("%s%s\n", table[i].name, table[i].isDirectory ? "/" : "");
 }
 
 //----------------------------------------------------------------------
@@ -188,7 +305,8 @@ Directory::Print()
     printf("Directory contents:\n");
     for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
+	    printf("Name: %s%s, Sector: %d\n", table[i].name,
+		   table[i].isDirectory ? "/" : "", table[i].sector);
 	    hdr->FetchFrom(table[i].sector);
 	    hdr->Print();
 	}
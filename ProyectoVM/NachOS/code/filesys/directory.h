@@ -4,7 +4,8 @@
 //      A directory is a table of pairs: <file name, sector #>,
 //	giving the name of each file in the directory, and 
 //	where to find its file header (the data structure describing
-//	where to find the file's data blocks) on disk.
+//	where to find the file's data blocks) on disk.  An entry may
+//	also name another directory, which makes the file system a tree.
 //
 //      We assume mutual exclusion is provided by the caller.
 //
@@ -17,10 +18,14 @@
 #ifndef DIRECTORY_H
 #define DIRECTORY_H
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "openfile.h"
 
-const int FileNameMaxLen = 9;		// for simplicity, we assume 
-					// file names are <= 9 characters long
+const int FileNameMaxLen = 23;		// file names are <= 23 characters
+					// long, so that an entry is 32 bytes
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -32,6 +37,7 @@ const int FileNameMaxLen = 9;		// for simplicity, we assume
 class DirectoryEntry {
   public:
     bool inUse;				// Is this directory entry in use?
+    bool isDirectory;			// Is the entry a directory?
     int sector;				// Location on disk to find the 
 					//   FileHeader for this file 
     char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
@@ -42,11 +48,15 @@ class DirectoryEntry {
 // the directory describes a file, and where to find it on disk.
 //
 // The directory data structure can be stored in memory, or on disk.
-// When it is on disk, it is stored as a regular Nachos file.
+// When it is on disk, it is stored as a regular Nachos file, which
+// grows when the table fills up.
+//
+// In memory, the names are also kept in a hash table, so that looking
+// up a name doesn't depend on how many entries the directory has.
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// from/to disk.  WriteBack only writes the entries that changed.
 
 class Directory {
   public:
@@ -55,17 +65,21 @@ class Directory {
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to 
-					// directory contents back to disk
+    bool WriteBack(OpenFile *file);	// Write modifications to 
+					// directory contents back to disk;
+					// false if the file couldn't grow
 
     int Find(const char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
+    bool IsDirectory(const char *name);	// Is "name" a directory?
 
-    bool Add(const char *name, int newSector);
+    bool Add(const char *name, int newSector, bool isDirectory);
     					// Add a file name into the directory
 
     bool Remove(const char *name);	// Remove a file from the directory
 
+    bool IsEmpty();			// Does the directory have no entries?
+
     void List();			// Print the names of all the files
 					//  in the directory
     void Print();			// Verbose print of the contents
@@ -76,9 +90,16 @@ class Directory {
     int tableSize;			// Number of directory entries
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
+    std::unordered_map<std::string, int> index;
+    					// file name -> entry in "table"
+    std::vector<int> freeEntries;	// entries not in use
+    int firstDirty, lastDirty;		// entries changed since FetchFrom,
+					// -1 if none
 
     int FindIndex(const char *name);	// Find the index into the directory 
 					//  table corresponding to "name"
+    void Grow();			// Double the size of the table
+    void Changed(int i);		// Remember to write back entry "i"
 };
 
 #endif // DIRECTORY_H
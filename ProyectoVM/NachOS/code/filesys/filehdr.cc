@@ -5,10 +5,16 @@
 //	The file header is used to locate where on disk the 
 //	file's data is stored.  We implement this as a fixed size
 //	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	disk sector containing that portion of the file data -- plus
+//	a single indirect and a double indirect block for the rest of
+//	the file.  The table size is chosen so that the file header
+//	will be just big enough to fit in one disk sector.
+//
+//	Data blocks are allocated in contiguous runs where possible:
+//	a new file gets the smallest hole big enough for it, and a file
+//	that grows continues right after its last block if that sector
+//	is free (cf. FreeMap::AllocateRun).  Sequential access then
+//	rarely has to seek.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -27,6 +33,52 @@
 #include "system.h"
 #include "filehdr.h"
 
+//----------------------------------------------------------------------
+// ReadPointer/WritePointer
+// 	Read or write entry "index" of the indirect block at "block".
+//	Only the entry itself goes through the buffer cache.
+//----------------------------------------------------------------------
+
+static int
+ReadPointer(int block, int index)
+{
+    int sector;
+
+    bufferCache->ReadBytes(block, index * sizeof(int), sizeof(int),
+			   (char *) &sector);
+    return sector;
+}
+
+static void
+WritePointer(int block, int index, int sector)
+{
+    bufferCache->WriteBytes(block, index * sizeof(int), sizeof(int),
+			    (const char *) &sector);
+}
+
+//----------------------------------------------------------------------
+// NewIndexBlock
+// 	Allocate an indirect block with every entry unused (-1), and
+//	return its sector.  The caller has made sure there is space.
+//
+//	"near" -- where we'd like the block to be: right next to the
+//		data it points to, so that reading the file sequentially
+//		doesn't have to seek to the far end of the disk for it
+//----------------------------------------------------------------------
+
+static int
+NewIndexBlock(FreeMap *freeMap, int near)
+{
+    int pointers[NumIndirect];
+    int sector = freeMap->FindNear(near);
+
+    ASSERT(sector != -1);
+    for (unsigned i = 0; i < NumIndirect; i++)
+	pointers[i] = -1;
+    bufferCache->WriteSector(sector, (const char *) pointers);
+    return sector;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -34,36 +86,183 @@
 //	Return false if there are not enough free blocks to accomodate
 //	the new file.
 //
-//	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"freeMap" is the map of free disk sectors
+//	"fileSize" is the initial size of the file, in bytes
 //----------------------------------------------------------------------
 
 bool
-FileHeader::Allocate(BitMap *freeMap, int fileSize)
+FileHeader::Allocate(FreeMap *freeMap, int fileSize)
 { 
-    numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
-	return false;		// not enough space
+    numBytes = 0;
+    numSectors = 0;
+    for (unsigned i = 0; i < NumDirect; i++)
+	dataSectors[i] = -1;
+    indirectSector = -1;
+    doubleIndirectSector = -1;
+    return Extend(freeMap, fileSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Grow the file to "newSize" bytes, allocating the data blocks (and
+//	indirect blocks) it needs beyond the ones it has.  Return false,
+//	leaving the file as it was, if the file would be too big or
+//	there are not enough free blocks.
+//
+//	The contents of the new blocks are undefined.  Neither the
+//	header nor "freeMap" are written back; the caller does that.
+//
+//	"freeMap" is the map of free disk sectors
+//	"newSize" is the new size of the file, in bytes
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Extend(FreeMap *freeMap, int newSize)
+{
+    int newSectors = divRoundUp(newSize, SectorSize);
+
+    if (newSize <= numBytes)
+	return true;
+    if (newSectors > (int) MaxFileSectors)
+	return false;			// file too big
+    if (newSectors == numSectors) {
+	numBytes = newSize;		// fits in the last block
+	return true;
+    }
 
-    for (int i = 0; i < numSectors; i++)
-	dataSectors[i] = freeMap->Find();
+    int count = newSectors - numSectors;
+    int needed = count + IndexBlocksFor(newSectors) - IndexBlocksFor(numSectors);
+    if (freeMap->NumClear() < needed)
+	return false;			// not enough space
+
+    // allocate the data blocks first, so that index blocks don't
+    // break up their runs.  If we can't continue the last run, move
+    // on to a hole at least as big as the file so far: a file that
+    // grows a little at a time then ends up in a few runs of growing
+    // size, instead of filling every small hole on the way.
+    int goal = (numSectors > 0) ? SectorOf(numSectors - 1) + 1 : -1;
+    if (goal == -1 || goal >= NumSectors || freeMap->Test(goal))
+	goal = freeMap->BestFit((count > numSectors) ? count : numSectors);
+    int *sectors = new int[count];
+    for (int done = 0; done < count; ) {
+	int length;
+	int start = freeMap->AllocateRun(goal, count - done, &length);
+	ASSERT(start != -1);
+	for (int i = 0; i < length; i++)
+	    sectors[done++] = start + i;
+	goal = start + length;
+    }
+    for (int i = 0; i < count; i++)
+	SetSector(freeMap, numSectors + i, sectors[i]);
+    delete [] sectors;
+
+    numSectors = newSectors;
+    numBytes = newSize;
     return true;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::IndexBlocksFor
+// 	Return how many indirect blocks a file of "sectors" data blocks
+//	needs, counting the double indirect block itself.
+//----------------------------------------------------------------------
+
+int
+FileHeader::IndexBlocksFor(int sectors)
+{
+    int blocks = 0;
+
+    if (sectors > (int) NumDirect)
+	blocks++;			// single indirect
+    sectors -= NumDirect + NumIndirect;
+    if (sectors > 0)			// double indirect, and its children
+	blocks += 1 + divRoundUp(sectors, NumIndirect);
+    return blocks;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorOf
+// 	Return the disk sector of data block "index" of the file.
+//----------------------------------------------------------------------
+
+int
+FileHeader::SectorOf(int index)
+{
+    ASSERT(index >= 0 && index < (int) MaxFileSectors);
+    if (index < (int) NumDirect)
+	return dataSectors[index];
+    index -= NumDirect;
+    if (index < (int) NumIndirect)
+	return ReadPointer(indirectSector, index);
+    index -= NumIndirect;
+    return ReadPointer(ReadPointer(doubleIndirectSector, index / NumIndirect),
+		       index % NumIndirect);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetSector
+// 	Make data block "index" of the file be "sector", allocating the
+//	indirect blocks on the way if they don't exist yet.
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetSector(FreeMap *freeMap, int index, int sector)
+{
+    ASSERT(index >= 0 && index < (int) MaxFileSectors);
+    if (index < (int) NumDirect) {
+	dataSectors[index] = sector;
+	return;
+    }
+    index -= NumDirect;
+    if (index < (int) NumIndirect) {
+	if (indirectSector == -1)
+	    indirectSector = NewIndexBlock(freeMap, sector + 1);
+	WritePointer(indirectSector, index, sector);
+	return;
+    }
+    index -= NumIndirect;
+    if (doubleIndirectSector == -1)
+	doubleIndirectSector = NewIndexBlock(freeMap, sector + 1);
+    int block = ReadPointer(doubleIndirectSector, index / NumIndirect);
+    if (block == -1) {
+	block = NewIndexBlock(freeMap, sector + 1);
+	WritePointer(doubleIndirectSector, index / NumIndirect, block);
+    }
+    WritePointer(block, index % NumIndirect, sector);
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	and for the indirect blocks pointing to them.  The journal is told,
+//	so that it doesn't replay old copies of them (cf. journal.h).
 //
-//	"freeMap" is the bit map of free disk sectors
+//	"freeMap" is the map of free disk sectors
 //----------------------------------------------------------------------
 
 void 
-FileHeader::Deallocate(BitMap *freeMap)
+FileHeader::Deallocate(FreeMap *freeMap)
 {
     for (int i = 0; i < numSectors; i++) {
-	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	freeMap->Clear((int) dataSectors[i]);
+	int sector = SectorOf(i);
+	ASSERT(freeMap->Test(sector));  // ought to be marked!
+	freeMap->Clear(sector);
+	journal->Revoke(sector);
+    }
+    if (doubleIndirectSector != -1) {
+	for (unsigned i = 0; i < NumIndirect; i++) {
+	    int block = ReadPointer(doubleIndirectSector, i);
+	    if (block != -1) {
+		freeMap->Clear(block);
+		journal->Revoke(block);
+	    }
+	}
+	freeMap->Clear(doubleIndirectSector);
+	journal->Revoke(doubleIndirectSector);
+    }
+    if (indirectSector != -1) {
+	freeMap->Clear(indirectSector);
+	journal->Revoke(indirectSector);
     }
 }
 
@@ -77,7 +276,7 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    bufferCache->ReadSector(sector, (char *)this);
 }
 
 //----------------------------------------------------------------------
@@ -90,7 +289,7 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this); 
+    bufferCache->WriteSector(sector, (char *)this); 
 }
 
 //----------------------------------------------------------------------
@@ -106,7 +305,7 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    return(dataSectors[offset / SectorSize]);
+    return SectorOf(offset / SectorSize);
 }
 
 //----------------------------------------------------------------------
@@ -120,6 +319,27 @@ FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::NumRuns
+// 	Return the number of runs of consecutive sectors the file's data
+//	is stored in; 1 for a file that is entirely contiguous, 0 for an
+//	empty file.
+//----------------------------------------------------------------------
+
+int
+FileHeader::NumRuns()
+{
+    int runs = 0, last = -2;
+
+    for (int i = 0; i < numSectors; i++) {
+	int sector = SectorOf(i);
+	if (sector != last + 1)
+	    runs++;
+	last = sector;
+    }
+    return runs;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -134,10 +354,14 @@ FileHeader::Print()
 
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
     for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+	printf("%d ", SectorOf(i));
+    if (indirectSector != -1)
+	printf("\nIndirect block: %d", indirectSector);
+    if (doubleIndirectSector != -1)
+	printf("\nDouble indirect block: %d", doubleIndirectSector);
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
+	bufferCache->ReadSector(SectorOf(i), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
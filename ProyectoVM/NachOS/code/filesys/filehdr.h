@@ -15,33 +15,41 @@
 #define FILEHDR_H
 
 #include "disk.h"
-#include "bitmap.h"
+#include "freemap.h"
 
-#define NumDirect	((SectorSize - 2 * sizeof(int)) / sizeof(int))
-#define MaxFileSize	(NumDirect * SectorSize)
+#define NumDirect	((SectorSize - 4 * sizeof(int)) / sizeof(int))
+#define NumIndirect	(SectorSize / sizeof(int))
+#define MaxFileSectors	(NumDirect + NumIndirect + NumIndirect * NumIndirect)
+#define MaxFileSize	(MaxFileSectors * SectorSize)
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of pointers to the first
+// NumDirect data blocks, followed by the sector of a single indirect
+// block (a sector full of pointers to the next NumIndirect data blocks)
+// and the sector of a double indirect block (a sector full of pointers
+// to indirect blocks).  Unused pointers are -1.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.  With the indirect blocks, the maximum file
+// length is a bit over 135K bytes, more than the whole disk.
 //
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// reading it from disk.  Files can grow later on, with Extend.
 
 class FileHeader {
   public:
-    bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
+    bool Allocate(FreeMap *freeMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
-    void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
-						//  data blocks
+    bool Extend(FreeMap *freeMap, int newSize);	// Grow the file to "newSize"
+						//  bytes, allocating more data
+						//  blocks as needed
+    void Deallocate(FreeMap *freeMap);  		// De-allocate this file's 
+						//  data and indirect blocks
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -54,13 +62,28 @@ class FileHeader {
     int FileLength();			// Return the length of the file 
 					// in bytes
 
+    int NumRuns();			// Number of contiguous runs the
+					// data blocks are stored in
+
     void Print();			// Print the contents of the file.
 
   private:
+    int SectorOf(int index);		// Disk sector of data block "index"
+    void SetSector(FreeMap *freeMap, int index, int sector);
+    					// Make data block "index" be
+					// "sector", allocating indirect
+					// blocks if needed
+    int IndexBlocksFor(int sectors);	// How many indirect blocks a file
+					// of "sectors" data blocks needs
+
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
     int dataSectors[NumDirect];		// Disk sector numbers for each data 
 					// block in the file
+    int indirectSector;			// Pointers to the next NumIndirect
+					// data blocks, -1 if none
+    int doubleIndirectSector;		// Pointers to indirect blocks for
+					// the rest of the file, -1 if none
 };
 
 #endif // FILEHDR_H
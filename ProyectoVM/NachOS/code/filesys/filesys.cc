@@ -7,37 +7,55 @@
 //		(the size of the file header data structure is arranged
 //		to be precisely the size of 1 disk sector)
 //	   A number of data blocks
-//	   An entry in the file system directory
+//	   An entry in the directory it is in
 //
 // 	The file system consists of several data structures:
-//	   A bitmap of free disk sectors (cf. bitmap.h)
-//	   A directory of file names and file headers
+//	   A bitmap of free disk sectors (cf. freemap.h)
+//	   A tree of directories of file names and file headers, starting
+//	     at the root directory
 //
-//      Both the bitmap and the directory are represented as normal
-//	files.  Their file headers are located in specific sectors
-//	(sector 0 and sector 1), so that the file system can find them 
-//	on bootup.
+//      Both the bitmap and the directories are represented as normal
+//	files.  The file headers of the bitmap and of the root directory
+//	are located in specific sectors (sector 0 and sector 1), so that
+//	the file system can find them on bootup.
+//
+//	Files are named by paths: names separated by '/', starting at
+//	the root (a leading '/' is optional).  There are no "." or ".."
+//	entries.  Recently used directories are kept in memory, and the
+//	results of recent lookups in the dentry cache (cf. dcache.h), so
+//	that resolving a path rarely reads a directory from disk.
 //
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written back (the two files are kept open during all this
+//	time).  If the operation fails, and we have modified part of the
+//	directory and/or bitmap, we simply discard the changed version,
+//	without writing it back to disk.
+//
+//	Each such operation goes through the journal (cf. journal.h):
+//	what it writes reaches the disk in a transaction of the log,
+//	together with the operations around it, and the log is replayed
+//	when the file system starts up.  If Nachos stops in the middle of
+//	an operation, the disk is left as it was before it, or after it.
+//
+//	Concurrent accesses are synchronized by a single file system lock,
+//	held by the operations on names and free space (Create, Open,
+//	Remove, growing a file), and by a lock per open file, held while
+//	reading or writing it (cf. filetable.h).  Reads and writes of
+//	different files, and reads of the same file, proceed in parallel;
+//	they only take the file system lock when a file has to grow.
+//	The locks are always taken in that order: a file's lock, then the
+//	file system lock, then the locks of the directory and bitmap files.
 //
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   only metadata is logged: the data written to a file when
+//	    Nachos stopped may be partly there, or not at all
+//	   disks formatted before the journal was added must be formatted
+//	    again
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -46,24 +64,23 @@
 #include "copyright.h"
 
 #include "disk.h"
-#include "bitmap.h"
+#include "freemap.h"
+#include "dcache.h"
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "journal.h"
+#include "system.h"
 
-// Sectors containing the file headers for the bitmap of free sectors,
-// and the directory of files.  These file headers are placed in well-known 
-// sectors, so that they can be located on boot-up.
-#define FreeMapSector 		0
-#define DirectorySector 	1
-
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directories; directories grow
+// as files are added to them.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
 #define NumDirEntries 		10
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
+// Number of directories, besides the root, kept in memory
+#define DirectoryCacheSize 	8
+
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format == true, the disk has
@@ -71,8 +88,11 @@
 //	an empty directory, and a bitmap of free sectors (with almost but
 //	not all of the sectors marked as free).  
 //
-//	If format == false, we just have to open the files
-//	representing the bitmap and the directory.
+//	If format == false, we replay the journal, and then we just have
+//	to open the files representing the bitmap and the directory.
+//
+//	Either way, the free map is kept in memory from then on, and
+//	written back to the bitmap file whenever it changes.
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
@@ -80,8 +100,9 @@
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    lock = new Lock("file system lock");
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
+        freeMap = new FreeMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
@@ -92,6 +113,9 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
+	for (int i = 0; i < LogSectors; i++)
+	    freeMap->Mark(LogStart + i);
+	journal->Format();
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
@@ -129,26 +153,197 @@ FileSystem::FileSystem(bool format)
 	    freeMap->Print();
 	    directory->Print();
 
-        delete freeMap; 
-	delete directory; 
 	delete mapHdr; 
 	delete dirHdr;
 	}
+	rootDirectory = directory;
     } else {
-    // if we are not formatting the disk, just open the files representing
-    // the bitmap and directory; these are left open while Nachos is running
+    // if we are not formatting the disk, finish whatever was committed
+    // before we stopped, then open the files representing the bitmap
+    // and directory; these are left open while Nachos is running
+        journal->Recover();
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        freeMap = new FreeMap(NumSectors);
+        freeMap->FetchFrom(freeMapFile);
+        rootDirectory = new Directory(NumDirEntries);
+        rootDirectory->FetchFrom(directoryFile);
+    }
+    dentryCache = new DentryCache(DentryCacheSize);
+}
+
+//----------------------------------------------------------------------
+// NextComponent
+// 	Copy the next name in "*path" into "name", and advance "*path"
+//	past it.  Return 1 if there was a name, 0 at the end of the
+//	path, and -1 if the name is too long.
+//----------------------------------------------------------------------
+
+static int
+NextComponent(const char **path, char *name)
+{
+    const char *p = *path;
+    int length = 0;
+
+    while (*p == '/')
+	p++;
+    if (*p == '\0') {
+	*path = p;
+	return 0;
+    }
+    while (p[length] != '\0' && p[length] != '/')
+	length++;
+    if (length > FileNameMaxLen)
+	return -1;
+    memcpy(name, p, length);
+    name[length] = '\0';
+    *path = p + length;
+    return 1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::GetDirectory
+// 	Return the directory whose header is at "sector", and in "*file"
+//	the open file it is stored in, to write it back.  Directories
+//	other than the root are read from disk the first time, and then
+//	kept in memory until DirectoryCacheSize others have been used
+//	more recently.  There is a single copy of each directory in
+//	memory, so changes made through it are never lost.
+//----------------------------------------------------------------------
+
+Directory *
+FileSystem::GetDirectory(int sector, OpenFile **file)
+{
+    if (sector == DirectorySector) {
+	*file = directoryFile;
+	return rootDirectory;
     }
+    for (std::list<CachedDirectory>::iterator it = directories.begin();
+	 it != directories.end(); it++)
+	if (it->sector == sector) {
+	    directories.splice(directories.begin(), directories, it);
+	    *file = it->file;
+	    return it->directory;
+	}
+
+    CachedDirectory cached;
+    cached.sector = sector;
+    cached.file = new OpenFile(sector);
+    cached.directory = new Directory(NumDirEntries);
+    cached.directory->FetchFrom(cached.file);
+    if ((int) directories.size() == DirectoryCacheSize) {
+	delete directories.back().directory;	// written back already
+	delete directories.back().file;
+	directories.pop_back();
+    }
+    directories.push_front(cached);
+    *file = cached.file;
+    return cached.directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ForgetDirectory
+// 	Drop a removed directory from memory.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ForgetDirectory(int sector)
+{
+    for (std::list<CachedDirectory>::iterator it = directories.begin();
+	 it != directories.end(); it++)
+	if (it->sector == sector) {
+	    delete it->directory;
+	    delete it->file;
+	    directories.erase(it);
+	    return;
+	}
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LookupIn
+// 	Look up "name" in the directory whose header is at "dirSector".
+//	Return false if it isn't there; otherwise return the sector of
+//	its header in "*sector", and whether it is a directory in
+//	"*isDirectory".  The dentry cache is tried first.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::LookupIn(int dirSector, const char *name, int *sector,
+		     bool *isDirectory)
+{
+    OpenFile *file;
+    Directory *directory;
+
+    if (dentryCache->Lookup(dirSector, name, sector, isDirectory))
+	return true;
+    directory = GetDirectory(dirSector, &file);
+    *sector = directory->Find(name);
+    if (*sector == -1)
+	return false;
+    *isDirectory = directory->IsDirectory(name);
+    dentryCache->Insert(dirSector, name, *sector, *isDirectory);
+    return true;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Lookup
+// 	Return the sector of the header of the file or directory named
+//	by "path", -1 if there is none.  "*isDirectory" tells which.
+//----------------------------------------------------------------------
+
+int
+FileSystem::Lookup(const char *path, bool *isDirectory)
+{
+    char name[FileNameMaxLen + 1];
+    int sector = DirectorySector;
+    bool directory = true;
+    int found;
+
+    while ((found = NextComponent(&path, name)) != 0) {
+	if (found == -1 || !directory)
+	    return -1;		// name too long, or a file in the middle
+	if (!LookupIn(sector, name, &sector, &directory))
+	    return -1;
+    }
+    *isDirectory = directory;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindParent
+// 	Return the sector of the header of the directory that "path" is
+//	in, and copy the last name in "path" into "name".  Return -1 if
+//	that directory doesn't exist, or "path" names the root.
+//----------------------------------------------------------------------
+
+int
+FileSystem::FindParent(const char *path, char *name)
+{
+    char next[FileNameMaxLen + 1];
+    int sector = DirectorySector;
+    bool directory;
+    int found;
+
+    if (NextComponent(&path, name) != 1)
+	return -1;
+    while ((found = NextComponent(&path, next)) != 0) {
+	if (found == -1)
+	    return -1;
+	if (!LookupIn(sector, name, &sector, &directory) || !directory)
+	    return -1;
+	strcpy(name, next);
+    }
+    return sector;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	"initialSize" bytes are allocated right away; the file can grow
+//	later, by writing past its end.
 //
 //	The steps to create a file are:
+//	  Find the directory the file goes in
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
@@ -159,58 +354,113 @@ FileSystem::FileSystem(bool format)
 //	Return true if everything goes ok, otherwise, return false.
 //
 // 	Create fails if:
+//		the directory the file goes in doesn't exist
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
-//
-//	"name" -- name of file to be created
+//	"name" -- path of file to be created
 //	"initialSize" -- size of file to be created
 //----------------------------------------------------------------------
 
 bool
 FileSystem::Create(const char *name, int initialSize)
 {
+    bool success;
+
+    lock->Acquire();
+    journal->Begin();
+    success = AddFile(name, initialSize, false);
+    journal->End();
+    lock->Release();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateDirectory
+// 	Create an empty directory (similar to UNIX mkdir).  Return true
+//	if everything goes ok; it fails for the same reasons as Create.
+//
+//	"name" -- path of directory to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::CreateDirectory(const char *name)
+{
+    bool success;
+
+    lock->Acquire();
+    journal->Begin();
+    success = AddFile(name, DirectoryFileSize, true);
+    journal->End();
+    lock->Release();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AddFile
+// 	Create a file or a directory, see Create.  A new directory gets
+//	its empty table written to disk.  If the parent directory can't
+//	grow to hold the new name, whatever was allocated is given back.
+//	The file system lock is held.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::AddFile(const char *path, int initialSize, bool isDirectory)
+{
+    char name[FileNameMaxLen + 1];
+    OpenFile *dirFile;
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *hdr;
-    int sector;
+    int dirSector, sector;
     bool success;
 
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    DEBUG('f', "Creating %s %s, size %d\n", isDirectory ? "directory" : "file",
+	  path, initialSize);
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    dirSector = FindParent(path, name);
+    if (dirSector == -1)
+	return false;			// no such directory
+    directory = GetDirectory(dirSector, &dirFile);
 
     if (directory->Find(name) != -1)
       success = false;			// file is already in directory
     else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
         sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = false;		// no free block for file header 
-        else if (!directory->Add(name, sector))
-            success = false;	// no space in directory
 	else {
     	    hdr = new FileHeader;
-	    if (!hdr->Allocate(freeMap, initialSize))
+	    if (!hdr->Allocate(freeMap, initialSize)) {
             	success = false;	// no space on disk for data
-	    else {	
+		freeMap->Clear(sector);
+	    } else {	
 	    	success = true;
 		// everthing worked, flush all changes back to disk
     	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
-    	    	freeMap->WriteBack(freeMapFile);
+		if (isDirectory) {
+		    Directory *empty = new Directory(NumDirEntries);
+		    OpenFile *file = new OpenFile(sector);
+		    empty->WriteBack(file);
+		    delete file;
+		    delete empty;
+		}
+		directory->Add(name, sector, isDirectory);
+		if (!directory->WriteBack(dirFile)) {
+		    // no room to grow the directory: take it all back
+		    success = false;
+		    directory->Remove(name);
+		    hdr->Deallocate(freeMap);
+		    freeMap->Clear(sector);
+		    journal->Revoke(sector);
+		} else {
+		    freeMap->WriteBack(freeMapFile);
+		    dentryCache->Insert(dirSector, name, sector, isDirectory);
+		}
 	    }
             delete hdr;
 	}
-        delete freeMap;
     }
-    delete directory;
     return success;
 }
 
@@ -218,88 +468,206 @@ FileSystem::Create(const char *name, int initialSize)
 // FileSystem::Open
 // 	Open a file for reading and writing.  
 //	To open a file:
-//	  Find the location of the file's header, using the directory 
+//	  Find the location of the file's header, following the path
+//	    from the root directory
 //	  Bring the header into memory
 //
-//	"name" -- the text name of the file to be opened
+//	Directories can't be opened this way.
+//
+//	If the file is open already, the new OpenFile shares its header.
+//	We keep the file system lock until the file is in the table of
+//	open files, so that it can't be removed under our feet.
+//
+//	"name" -- the path of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(const char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
+    bool isDirectory;
     int sector;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name); 
-    if (sector >= 0) 		
-	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
-    return openFile;				// return NULL if not found
+    lock->Acquire();
+    sector = Lookup(name, &isDirectory);
+    if (sector != -1 && !isDirectory)
+	openFile = new OpenFile(sector);
+    lock->Release();
+    return openFile;			// NULL if not found
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Remove
-// 	Delete a file from the file system.  This requires:
-//	    Remove it from the directory
+// 	Delete a file, or an empty directory, from the file system.
+//	This requires:
+//	    Remove it from its directory
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
 //	    Write changes to directory, bitmap back to disk
 //
+//	A file that is still open disappears from its directory right
+//	away, but its header and data blocks are only freed when the last
+//	OpenFile on it is closed.
+//
 //	Return true if the file was deleted, false if the file wasn't
-//	in the file system.
+//	in the file system, or is a directory that is not empty.
 //
-//	"name" -- the text name of the file to be removed
+//	"name" -- the path of the file to be removed
 //----------------------------------------------------------------------
 
 bool
 FileSystem::Remove(const char *name)
 { 
+    bool success;
+
+    lock->Acquire();
+    journal->Begin();
+    success = RemoveFile(name);
+    journal->End();
+    lock->Release();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RemoveFile
+// 	Remove a file or a directory, see Remove.  The file system lock
+//	is held.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::RemoveFile(const char *path)
+{ 
+    char name[FileNameMaxLen + 1];
+    OpenFile *dirFile, *file;
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *fileHdr;
-    int sector;
+    int dirSector, sector;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    dirSector = FindParent(path, name);
+    if (dirSector == -1)
+	return false;			// no such directory
+    directory = GetDirectory(dirSector, &dirFile);
     sector = directory->Find(name);
-    if (sector == -1) {
-       delete directory;
-       return false;			 // file not found 
+    if (sector == -1)
+	return false;			 // file not found 
+    if (directory->IsDirectory(name)) {
+	if (!GetDirectory(sector, &file)->IsEmpty())
+	    return false;		// directory not empty
+	ForgetDirectory(sector);
+    }
+    directory->Remove(name);
+    dentryCache->Remove(dirSector, name);
+    directory->WriteBack(dirFile);		// flush to disk
+
+    if (!openFileTable->Unlink(sector)) {	// not open, free it now
+	fileHdr = new FileHeader;
+	fileHdr->FetchFrom(sector);
+	Deallocate(fileHdr, sector);
+	delete fileHdr;
     }
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
+    return true;
+} 
+
+//----------------------------------------------------------------------
+// FileSystem::Deallocate
+// 	Give back the header and data blocks of a removed file, and write
+//	the free map back to disk.  Called by Remove, or by the last
+//	close of a file that was removed while open.
+//
+//	"hdr" -- the header of the file
+//	"sector" -- where the header is stored on disk
+//----------------------------------------------------------------------
 
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+void
+FileSystem::Deallocate(FileHeader *hdr, int sector)
+{
+    bool locked = lock->isHeldByCurrentThread();
 
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
+    DEBUG('f', "Freeing file at sector %d\n", sector);
+    if (!locked)
+	lock->Acquire();
+    journal->Begin();
+    hdr->Deallocate(freeMap);  			// remove data blocks
     freeMap->Clear(sector);			// remove header block
-    directory->Remove(name);
-
+    journal->Revoke(sector);
     freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
-    delete fileHdr;
-    delete directory;
-    delete freeMap;
-    return true;
-} 
+    journal->End();
+    if (!locked)
+	lock->Release();
+}
 
 //----------------------------------------------------------------------
-// FileSystem::List
-// 	List all the files in the file system directory.
+// FileSystem::Extend
+// 	Grow a file to "newSize" bytes, allocating its new blocks out of
+//	the free map, and write the header and the free map back to disk.
+//	Return false if the file can't grow that much.
+//
+//	The caller holds the file's lock.  We may hold the file system
+//	lock already, when a directory grows as a name is added to it.
+//
+//	"hdr" -- the in-memory header of the file
+//	"sector" -- where the header is stored on disk
+//	"newSize" -- the new length of the file
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Extend(FileHeader *hdr, int sector, int newSize)
+{
+    bool locked = lock->isHeldByCurrentThread();
+    bool success;
+
+    DEBUG('f', "Extending file at sector %d to %d bytes\n", sector, newSize);
+    if (!locked)
+	lock->Acquire();
+    journal->Begin();
+    success = hdr->Extend(freeMap, newSize);
+    if (success) {
+	hdr->WriteBack(sector);
+	freeMap->WriteBack(freeMapFile);
+    }
+    journal->End();
+    if (!locked)
+	lock->Release();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Get everything written so far to disk (similar to UNIX sync):
+//	commit the journal, and flush the buffer cache.
 //----------------------------------------------------------------------
 
 void
-FileSystem::List()
+FileSystem::Sync()
+{
+    lock->Acquire();
+    journal->Commit();
+    bufferCache->Flush();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::List
+// 	List all the files in a directory.  Return false if there is no
+//	such directory.
+//
+//	"name" -- the path of the directory, "/" for the root
+//----------------------------------------------------------------------
+
+bool
+FileSystem::List(const char *name)
 {
-    Directory *directory = new Directory(NumDirEntries);
+    OpenFile *file;
+    bool isDirectory;
+    int sector;
 
-    directory->FetchFrom(directoryFile);
-    directory->List();
-    delete directory;
+    lock->Acquire();
+    sector = Lookup(name, &isDirectory);
+    if (sector != -1 && isDirectory)
+	GetDirectory(sector, &file)->List();
+    lock->Release();
+    return sector != -1 && isDirectory;
 }
 
 //----------------------------------------------------------------------
@@ -317,9 +685,8 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
+    lock->Acquire();
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
     bitHdr->Print();
@@ -328,14 +695,14 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
-    directory->FetchFrom(directoryFile);
-    directory->Print();
+    rootDirectory->Print();
+    dentryCache->Print();
+    openFileTable->Print();
+    journal->Print();
+    lock->Release();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
 } 
@@ -20,9 +20,8 @@
 //	file system (in a file named "DISK"). 
 //
 //	In the "real" implementation, there are two key data structures used 
-//	in the file system.  There is a single "root" directory, listing
-//	all of the files in the file system; unlike UNIX, the baseline
-//	system does not provide a hierarchical directory structure.  
+//	in the file system.  There is a tree of directories, starting at
+//	the "root" directory, listing all of the files in the file system.
 //	In addition, there is a bitmap for allocating
 //	disk sectors.  Both the root directory and the bitmap are themselves
 //	stored as files in the Nachos file system -- this causes an interesting
@@ -65,6 +64,29 @@ class FileSystem {
 };
 
 #else // FILESYS
+#include <list>
+
+class DentryCache;
+class Directory;
+class FileHeader;
+class FreeMap;
+class Lock;
+
+// Sectors containing the file headers for the bitmap of free sectors,
+// and the directory of files.  These file headers are placed in well-known 
+// sectors, so that they can be located on boot-up.
+#define FreeMapSector 		0
+#define DirectorySector 	1
+
+// A directory kept in memory by the file system, with the open file
+// it is stored in.
+class CachedDirectory {
+  public:
+    int sector;				// where its header is
+    OpenFile *file;			// the directory file
+    Directory *directory;		// its contents
+};
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -76,20 +98,55 @@ class FileSystem {
 
     bool Create(const char *name, int initialSize);  	
 					// Create a file (UNIX creat)
+    bool CreateDirectory(const char *name);
+    					// Create a directory (UNIX mkdir)
 
     OpenFile* Open(const char *name); 	// Open a file (UNIX open)
 
-    bool Remove(const char *name);  	// Delete a file (UNIX unlink)
+    bool Remove(const char *name);  	// Delete a file, or an empty
+					// directory (UNIX unlink, rmdir)
+
+    bool Extend(FileHeader *hdr, int sector, int newSize);
+    					// Grow the file whose header is
+					// "hdr" (stored at "sector")
+    void Deallocate(FileHeader *hdr, int sector);
+    					// Free the blocks of a removed file
+
+    void Sync();			// Write everything out to disk
 
-    void List();			// List all the files in the file system
+    bool List(const char *name);	// List all the files in a directory
 
     void Print();			// List all the files and their contents
 
   private:
+   Lock* lock;				// Protects the free map, directories
+					// and caches below; file data is
+					// protected by the files' own locks
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
+   FreeMap* freeMap;			// The same, in memory, as free runs
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   Directory* rootDirectory;		// Contents of the root directory
+   std::list<CachedDirectory> directories;
+   					// Other directories in memory, most
+					// recently used first
+   DentryCache* dentryCache;		// Recent lookups of names
+
+   bool AddFile(const char *path, int initialSize, bool isDirectory);
+   					// Create a file or directory
+   bool RemoveFile(const char *path);	// Remove a file or directory
+   Directory* GetDirectory(int sector, OpenFile **file);
+   					// Directory whose header is at
+					// "sector", read in if needed
+   void ForgetDirectory(int sector);	// Drop a removed directory
+   bool LookupIn(int dirSector, const char *name, int *sector,
+		 bool *isDirectory);	// Look up a name in a directory
+   int Lookup(const char *path, bool *isDirectory);
+   					// Header sector of "path", -1 if none
+   int FindParent(const char *path, char *name);
+   					// Header sector of the directory
+					// "path" is in, and the last name
 };
 
 #endif // FILESYS
@@ -0,0 +1,155 @@
+// filetable.cc
+//	Routines to keep track of the open files, see filetable.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "filetable.h"
+#include "filehdr.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// OpenFileTable::OpenFileTable
+// 	Initialize an empty table.
+//----------------------------------------------------------------------
+
+OpenFileTable::OpenFileTable()
+{
+    lock = new Lock("open file table lock");
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::~OpenFileTable
+// 	De-allocate the table, and the nodes of the files still open.
+//----------------------------------------------------------------------
+
+OpenFileTable::~OpenFileTable()
+{
+    for (std::unordered_map<int, FileNode *>::iterator it = nodes.begin();
+	 it != nodes.end(); it++) {
+	delete it->second->lock;
+	delete it->second->hdr;
+	delete it->second;
+    }
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Open
+// 	Return the node of the file whose header is at "sector", with one
+//	more reference to it.  The first time the file is opened, its
+//	header is read in.
+//
+//	The caller makes sure the file exists: the file system holds its
+//	lock from looking up the name until the file is open, so that the
+//	file can't be removed in between.
+//----------------------------------------------------------------------
+
+FileNode *
+OpenFileTable::Open(int sector)
+{
+    FileNode *node;
+
+    lock->Acquire();
+    std::unordered_map<int, FileNode *>::iterator found = nodes.find(sector);
+    if (found != nodes.end()) {
+	node = found->second;
+	ASSERT(!node->removed);
+    } else {
+	node = new FileNode;
+	node->sector = sector;
+	node->hdr = new FileHeader;
+	node->hdr->FetchFrom(sector);
+	node->lock = new RWLock("file lock", RW_FAIR);
+	node->refCount = 0;
+	node->removed = false;
+	nodes[sector] = node;
+    }
+    node->refCount++;
+    lock->Release();
+    return node;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Close
+// 	Drop a reference to "node".  When nobody has the file open any
+//	longer, forget it; if it was removed meanwhile, it is only now
+//	that its blocks go back to the free map.
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::Close(FileNode *node)
+{
+    lock->Acquire();
+    ASSERT(node->refCount > 0);
+    if (--node->refCount > 0) {
+	lock->Release();
+	return;
+    }
+    nodes.erase(node->sector);
+    lock->Release();
+
+    if (node->removed)
+	fileSystem->Deallocate(node->hdr, node->sector);
+    delete node->lock;
+    delete node->hdr;
+    delete node;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Unlink
+// 	Note that the file at "sector" is no longer in any directory.
+//	Return true if it is open, in which case the last Close frees it;
+//	false if the caller can free it right away.
+//----------------------------------------------------------------------
+
+bool
+OpenFileTable::Unlink(int sector)
+{
+    bool open = false;
+
+    lock->Acquire();
+    std::unordered_map<int, FileNode *>::iterator found = nodes.find(sector);
+    if (found != nodes.end()) {
+	found->second->removed = true;
+	open = true;
+    }
+    lock->Release();
+    return open;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::NumOpen
+// 	Return how many files are open.
+//----------------------------------------------------------------------
+
+int
+OpenFileTable::NumOpen()
+{
+    int count;
+
+    lock->Acquire();
+    count = nodes.size();
+    lock->Release();
+    return count;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Print
+// 	Print the files that are open, and how many times.
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::Print()
+{
+    lock->Acquire();
+    printf("Open files: %d\n", (int) nodes.size());
+    for (std::unordered_map<int, FileNode *>::iterator it = nodes.begin();
+	 it != nodes.end(); it++)
+	printf("  header %d, %d bytes, open %d times%s\n", it->first,
+	       it->second->hdr->FileLength(), it->second->refCount,
+	       it->second->removed ? ", removed" : "");
+    lock->Release();
+}
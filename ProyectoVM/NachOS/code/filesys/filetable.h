@@ -0,0 +1,71 @@
+// filetable.h
+//	Data structures for the system-wide table of open files.
+//
+//	Every file that is open has exactly one FileNode, shared by all
+//	the OpenFile objects open on it (each of which only keeps its
+//	own seek position).  The node holds the one in-memory copy of the
+//	file header, so that a file grown through one OpenFile is seen
+//	at its new size through all the others, and the reader/writer
+//	lock that serializes the reads and writes of that file.
+//
+//	Reads of a file share its lock, writes hold it alone; reads and
+//	writes of different files don't wait for each other at all.
+//
+//	A file removed while it is still open keeps its header and data
+//	blocks until the last OpenFile on it is closed, as in UNIX.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FILETABLE_H
+#define FILETABLE_H
+
+#include <unordered_map>
+
+#include "copyright.h"
+#include "synch.h"
+
+class FileHeader;
+
+// An open file, shared by everybody who has it open.
+
+class FileNode {
+  public:
+    int sector;				// where the header is on disk
+    FileHeader *hdr;			// the header, in memory
+    RWLock *lock;			// readers share, writers exclusive
+    int refCount;			// number of OpenFiles on the file
+    bool removed;			// free the file on the last close
+};
+
+// The following class defines the table of open files, indexed by the
+// sector of their header.
+
+class OpenFileTable {
+  public:
+    OpenFileTable();			// Initialize an empty table
+    ~OpenFileTable();			// De-allocate the table
+
+    FileNode *Open(int sector);		// Node of the file whose header
+					// is at "sector", read in if the
+					// file isn't open yet
+    void Close(FileNode *node);		// Drop a reference to "node";
+					// on the last one, forget the
+					// node, and free the file if it
+					// was removed
+    bool Unlink(int sector);		// The file at "sector" has been
+					// removed; return true if it is
+					// still open, and so must be
+					// freed later by Close
+
+    int NumOpen();			// Number of files open
+    void Print();			// Print the open files
+
+  private:
+    std::unordered_map<int, FileNode *> nodes;
+    					// sector -> node of the open file
+    Lock *lock;				// protects "nodes" and the counts
+};
+
+#endif // FILETABLE_H
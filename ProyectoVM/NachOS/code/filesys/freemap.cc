@@ -0,0 +1,316 @@
+// freemap.cc
+//	Routines to manage the free sectors on disk, see freemap.h.
+//
+//	The bitmap and the runs always describe the same free sectors.
+//	The bitmap is what goes to disk; the runs are rebuilt from it
+//	when it is read back.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "freemap.h"
+
+//----------------------------------------------------------------------
+// FreeMap::FreeMap
+// 	Initialize a free map with every sector free.
+//
+//	"numSectors" -- the number of sectors on disk
+//----------------------------------------------------------------------
+
+FreeMap::FreeMap(int numSectors)
+{
+    bits = new BitMap(numSectors);
+    numClear = 0;
+    AddRun(0, numSectors);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::~FreeMap
+// 	De-allocate a free map.
+//----------------------------------------------------------------------
+
+FreeMap::~FreeMap()
+{
+    delete bits;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::FetchFrom
+// 	Read the bitmap from disk, and rebuild the free runs from it.
+//	This is the only operation that takes time linear in the size
+//	of the disk.
+//
+//	"file" -- the bitmap file
+//----------------------------------------------------------------------
+
+void
+FreeMap::FetchFrom(OpenFile *file)
+{
+    int numSectors = bits->getNumBits();
+    int start = -1;
+
+    bits->FetchFrom(file);
+    byStart.clear();
+    bySize.clear();
+    numClear = 0;
+    for (int i = 0; i < numSectors; i++) {
+	if (!bits->Test(i) && start == -1)
+	    start = i;
+	else if (bits->Test(i) && start != -1) {
+	    AddRun(start, i - start);
+	    start = -1;
+	}
+    }
+    if (start != -1)
+	AddRun(start, numSectors - start);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::WriteBack
+// 	Write the bitmap to disk.
+//
+//	"file" -- the bitmap file
+//----------------------------------------------------------------------
+
+void
+FreeMap::WriteBack(OpenFile *file)
+{
+    bits->WriteBack(file);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::AddRun/RemoveRun
+// 	Record a new free run, or forget one, in both indexes.
+//----------------------------------------------------------------------
+
+void
+FreeMap::AddRun(int start, int length)
+{
+    byStart[start] = length;
+    bySize.insert(std::make_pair(length, start));
+    numClear += length;
+}
+
+void
+FreeMap::RemoveRun(RunMap::iterator run)
+{
+    bySize.erase(std::make_pair(run->second, run->first));
+    numClear -= run->second;
+    byStart.erase(run);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::RunContaining
+// 	Return the free run that contains "sector", byStart.end() if the
+//	sector is allocated.
+//----------------------------------------------------------------------
+
+FreeMap::RunMap::iterator
+FreeMap::RunContaining(int sector)
+{
+    RunMap::iterator run = byStart.upper_bound(sector);
+
+    if (run == byStart.begin())
+	return byStart.end();
+    --run;					// last run starting at or
+						// before "sector"
+    if (run->first + run->second <= sector)
+	return byStart.end();
+    return run;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Take
+// 	Allocate sectors "start" to "start" + "length" - 1, which must
+//	all be in the same free run.  What is left of the run on either
+//	side stays free.
+//----------------------------------------------------------------------
+
+void
+FreeMap::Take(int start, int length)
+{
+    RunMap::iterator run = RunContaining(start);
+    ASSERT(run != byStart.end());
+
+    int runStart = run->first;
+    int runEnd = run->first + run->second;
+    ASSERT(start + length <= runEnd);
+
+    RemoveRun(run);
+    if (start > runStart)
+	AddRun(runStart, start - runStart);
+    if (start + length < runEnd)
+	AddRun(start + length, runEnd - start - length);
+    for (int i = start; i < start + length; i++)
+	bits->Mark(i);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Mark
+// 	Allocate a given sector, which must be free.
+//----------------------------------------------------------------------
+
+void
+FreeMap::Mark(int sector)
+{
+    ASSERT(!Test(sector));
+    Take(sector, 1);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Clear
+// 	Free a sector, merging it with the free runs right before and
+//	right after it, if any.
+//----------------------------------------------------------------------
+
+void
+FreeMap::Clear(int sector)
+{
+    int start = sector, length = 1;
+
+    ASSERT(Test(sector));
+    bits->Clear(sector);
+
+    RunMap::iterator next = byStart.find(sector + 1);
+    if (next != byStart.end()) {
+	length += next->second;
+	RemoveRun(next);
+    }
+    RunMap::iterator prev = byStart.lower_bound(sector);
+    if (prev != byStart.begin()) {
+	--prev;
+	if (prev->first + prev->second == sector) {
+	    start = prev->first;
+	    length += prev->second;
+	    RemoveRun(prev);
+	}
+    }
+    AddRun(start, length);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Test
+// 	Return true if "sector" is allocated.
+//----------------------------------------------------------------------
+
+bool
+FreeMap::Test(int sector)
+{
+    return bits->Test(sector);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::BestFit
+// 	Return the first sector of the smallest hole that has room for
+//	"count" sectors, or of the largest hole if none is that big; -1
+//	if the disk is full.  Nothing is allocated.
+//----------------------------------------------------------------------
+
+int
+FreeMap::BestFit(int count)
+{
+    if (bySize.empty())
+	return -1;
+
+    std::set<std::pair<int, int> >::iterator fit =
+	bySize.lower_bound(std::make_pair(count, -1));
+    if (fit == bySize.end())
+	return bySize.rbegin()->second;
+    return fit->second;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::AllocateRun
+// 	Allocate up to "count" consecutive sectors, and return the first
+//	one (-1 if the disk is full).  "*length" is set to how many we
+//	got, which is less than "count" only if there is no hole that
+//	big.
+//
+//	If "goal" is free, the run starts there, so that a file that
+//	grows can continue right after its last block.  Otherwise we
+//	take the smallest hole that fits the whole request (best fit),
+//	or failing that, all of the largest hole.
+//
+//	"goal" -- preferred first sector, -1 if none
+//	"count" -- how many sectors we want
+//	"length" -- returns how many we got
+//----------------------------------------------------------------------
+
+int
+FreeMap::AllocateRun(int goal, int count, int *length)
+{
+    int start, available;
+
+    ASSERT(count > 0);
+    RunMap::iterator run = (goal >= 0 && goal < bits->getNumBits()) ?
+				RunContaining(goal) : byStart.end();
+    if (run != byStart.end()) {
+	start = goal;
+	available = run->first + run->second - goal;
+    } else {
+	start = BestFit(count);
+	if (start == -1) {
+	    *length = 0;
+	    return -1;				// disk full
+	}
+	available = byStart[start];
+    }
+
+    *length = (available < count) ? available : count;
+    Take(start, *length);
+    return start;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Find
+// 	Allocate a single sector and return it, -1 if the disk is full.
+//	The sector comes from the front of the smallest hole.
+//----------------------------------------------------------------------
+
+int
+FreeMap::Find()
+{
+    int length;
+
+    return AllocateRun(-1, 1, &length);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::FindNear
+// 	Allocate a single sector, "goal" if it is free, otherwise as in
+//	Find.  Return -1 if the disk is full.
+//----------------------------------------------------------------------
+
+int
+FreeMap::FindNear(int goal)
+{
+    int length;
+
+    return AllocateRun(goal, 1, &length);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::LargestRun
+// 	Return the length of the largest hole, 0 if the disk is full.
+//----------------------------------------------------------------------
+
+int
+FreeMap::LargestRun()
+{
+    return bySize.empty() ? 0 : bySize.rbegin()->first;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Print
+// 	Print the allocated sectors, and how fragmented the free space is.
+//----------------------------------------------------------------------
+
+void
+FreeMap::Print()
+{
+    bits->Print();
+    printf("Free space: %d sectors in %d runs, largest %d\n",
+	   NumClear(), NumRuns(), LargestRun());
+}
@@ -0,0 +1,82 @@
+// freemap.h
+//	Data structures to manage the free sectors on disk.
+//
+//	On disk, free space is still recorded as a bitmap (stored in the
+//	bitmap file, cf. filesys.h).  In memory, the free sectors are also
+//	kept as a set of runs -- maximal stretches of consecutive free
+//	sectors -- indexed both by their first sector and by their length.
+//	That lets us hand out contiguous runs of sectors, pick the
+//	smallest hole that fits a request, and free sectors (merging
+//	them with the runs next to them), all in logarithmic time.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FREEMAP_H
+#define FREEMAP_H
+
+#include <map>
+#include <set>
+#include <utility>
+
+#include "copyright.h"
+#include "bitmap.h"
+#include "openfile.h"
+
+// The following class defines the free sector manager.  Sectors are
+// numbered 0 to "numSectors" - 1, and are all free to start with.
+
+class FreeMap {
+  public:
+    FreeMap(int numSectors);		// Initialize with every sector free
+    ~FreeMap();
+
+    void FetchFrom(OpenFile *file);	// Read the bitmap from disk, and
+					// rebuild the runs from it
+    void WriteBack(OpenFile *file);	// Write the bitmap to disk
+
+    void Mark(int sector);		// Allocate a given sector
+    void Clear(int sector);		// Free a sector
+    bool Test(int sector);		// Is the sector allocated?
+
+    int Find();				// Allocate some sector, -1 if full.
+					// Uses the smallest hole, so that
+					// the large ones are kept for runs
+    int FindNear(int goal);		// Same, but "goal" if it is free
+    int AllocateRun(int goal, int count, int *length);
+    					// Allocate up to "count" consecutive
+					// sectors, starting at "goal" if
+					// it is free.  Returns the first,
+					// and how many in "length"
+
+    int BestFit(int count);		// First sector of the smallest hole
+					// of at least "count" sectors (else
+					// of the largest); allocates nothing
+
+    int NumClear() { return numClear; }	// Number of free sectors
+    int NumRuns() { return (int) byStart.size(); }
+    					// Number of holes
+    int LargestRun();			// Length of the largest hole
+
+    void Print();			// Print the allocated sectors and the
+					// holes
+
+  private:
+    typedef std::map<int, int> RunMap;
+
+    RunMap::iterator RunContaining(int sector);
+    					// The free run "sector" is in, or
+					// byStart.end() if it's allocated
+    void AddRun(int start, int length);	// Record a free run
+    void RemoveRun(RunMap::iterator run);	// Forget a free run
+    void Take(int start, int length);	// Allocate part of a free run
+
+    BitMap *bits;			// allocated sectors, as stored on disk
+    RunMap byStart;			// free runs: first sector -> length
+    std::set<std::pair<int, int> > bySize;
+    					// free runs: (length, first sector)
+    int numClear;			// free sectors
+};
+
+#endif // FREEMAP_H
@@ -7,19 +7,30 @@
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
 //		(won't work on baseline system!)
+//	   DiskSchedulerTest -- compare the disk scheduling policies
+//	   DirectoryTest -- time lookups in a large directory
+//	   ConcurrencyTest -- read and write files from several threads
+//	   CreateRemoveTest -- time creating and removing files
+//	   DiskFullTest -- check that a create failing on a full disk
+//		leaves nothing behind
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
 
+#include <time.h>
+
 #include "copyright.h"
 
 #include "utility.h"
+#include "directory.h"
 #include "filesys.h"
+#include "freemap.h"
 #include "system.h"
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "synch.h"
 
 #define TransferSize 	10 	// make it small, just to be difficult
 
@@ -102,7 +113,13 @@ Print(const char *name)
 //	it out a bit at a time, reading it back a bit at a time, and then
 //	deleting the file.
 //
-//	Implemented as three separate routines:
+//	To see how well data blocks are kept together, the free space
+//	is fragmented first, by creating a number of small files and
+//	removing every other one.  We print how many runs of sectors the
+//	large file ends up in, and how far the disk head moved.
+//
+//	Implemented as separate routines:
+//	  FragmentDisk -- create the small files, leaving holes
 //	  FileWrite -- write the file
 //	  FileRead -- read the file
 //	  PerformanceTest -- overall control, and print out performance #'s
@@ -113,6 +130,41 @@ Print(const char *name)
 #define ContentSize 	strlen(Contents)
 #define FileSize 	((int)(ContentSize * 5000))
 
+#define NumSmallFiles	8
+#define SmallFileSize	(16 * SectorSize)
+
+static void
+SmallFileName(char *name, int i)
+{
+    snprintf(name, 10, "Small%d", i);
+}
+
+static void
+FragmentDisk()
+{
+    char name[10];
+
+    for (int i = 0; i < NumSmallFiles; i++) {
+	SmallFileName(name, i);
+	fileSystem->Create(name, SmallFileSize);
+    }
+    for (int i = 0; i < NumSmallFiles; i += 2) {
+	SmallFileName(name, i);
+	fileSystem->Remove(name);
+    }
+}
+
+static void
+RemoveSmallFiles()
+{
+    char name[10];
+
+    for (int i = 1; i < NumSmallFiles; i += 2) {
+	SmallFileName(name, i);
+	fileSystem->Remove(name);
+    }
+}
+
 static void 
 FileWrite()
 {
@@ -138,6 +190,8 @@ FileWrite()
 	    return;
 	}
     }
+    printf("%s is stored in %d runs of sectors\n", FileName,
+	   openFile->NumRuns());
     delete openFile;	// close file
 }
 
@@ -147,6 +201,8 @@ FileRead()
     OpenFile *openFile;    
     char *buffer = new char[ContentSize];
     int i, numBytes;
+    int hits = stats->numTrackBufferHits;
+    int saved = stats->trackBufferTicksSaved;
 
     printf("Sequential read of %d byte file, in %d byte chunks\n", 
 	FileSize, (int)ContentSize);
@@ -167,19 +223,475 @@ FileRead()
     }
     delete [] buffer;
     delete openFile;	// close file
+    printf("Track buffer: %d hits, %d ticks of latency saved\n",
+	   stats->numTrackBufferHits - hits,
+	   stats->trackBufferTicksSaved - saved);
 }
 
 void
 PerformanceTest()
 {
+    int diskReads, readsAvoided;
+
     printf("Starting file system performance test:\n");
     stats->Print();
+    diskReads = stats->numDiskReads;
+    readsAvoided = bufferCache->readsAvoided;
+    FragmentDisk();
+    fileSystem->Sync();			// so that the disk sees our requests
+    synchDisk->ResetStats();
     FileWrite();
     FileRead();
+    fileSystem->Sync();
+    synchDisk->PrintStats();
+    RemoveSmallFiles();
     if (!fileSystem->Remove(FileName)) {
       printf("Perf test: unable to remove %s\n", FileName);
       return;
     }
     stats->Print();
+    bufferCache->Print();
+    diskReads = stats->numDiskReads - diskReads;
+    readsAvoided = bufferCache->readsAvoided - readsAvoided;
+    printf("Perf test: %d disk reads, %d without the buffer cache\n",
+	   diskReads, diskReads + readsAvoided);
+}
+
+
+//----------------------------------------------------------------------
+// DiskSchedulerTest
+// 	Have several threads read sectors all over the disk at once, so
+//	that requests pile up in the SynchDisk queue, and see how far the
+//	head travels and how long requests wait under each scheduling
+//	policy.  Every policy gets the same sectors, in the same order.
+//
+//	The sectors are read straight from the SynchDisk, bypassing the
+//	buffer cache (which would hide most of the requests), and are
+//	not modified.
+//----------------------------------------------------------------------
+
+#define SchedThreads 	8
+#define SchedReads 	16
+
+static int schedSectors[SchedThreads][SchedReads];
+static Semaphore *schedDone;
+
+static void
+SchedReader(void *arg)
+{
+    int *sectors = schedSectors[(long) arg];
+    char buffer[SectorSize];
+
+    for (int i = 0; i < SchedReads; i++)
+	synchDisk->ReadSector(sectors[i], buffer);
+    schedDone->V();
+}
+
+void
+DiskSchedulerTest()
+{
+    static const DiskPolicy policies[] = { DISK_FCFS, DISK_SSTF, DISK_SCAN,
+					    DISK_CSCAN };
+    DiskPolicy oldPolicy = synchDisk->GetPolicy();
+
+    RandomInit(1);
+    for (int t = 0; t < SchedThreads; t++)
+	for (int i = 0; i < SchedReads; i++)
+	    schedSectors[t][i] = Random() % NumSectors;
+
+    schedDone = new Semaphore("disk scheduler test", 0);
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+	synchDisk->SetPolicy(policies[p]);
+	synchDisk->ResetStats();
+	for (long t = 0; t < SchedThreads; t++)
+	    (new Thread("disk reader"))->Fork(SchedReader, (void *) t);
+	for (int t = 0; t < SchedThreads; t++)
+	    schedDone->P();
+	synchDisk->PrintStats();
+    }
+    delete schedDone;
+    synchDisk->SetPolicy(oldPolicy);
+    synchDisk->ResetStats();
+}
+
+//----------------------------------------------------------------------
+// DirectoryTest
+// 	Fill a directory with "count" files, and time opening them: the
+//	first and last names added, over and over (answered by the dentry
+//	cache), and every name once (looked up in the directory's hash
+//	table).  Neither should depend on how big the directory is.
+//	Looking the names up reads nothing from disk; the disk reads
+//	printed are those fetching the files' headers.  The files are
+//	removed afterwards.
+//----------------------------------------------------------------------
+
+#define DirTestName	"/dirtest"
+#define DirTestOpens	1000
+
+static double
+HostMicroseconds()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+static void
+DirTestFileName(char *name, int i)
+{
+    snprintf(name, 32, "%s/file%d", DirTestName, i);
+}
+
+// Open "name" "times" times, and print the average cost
+static void
+TimeOpens(const char *what, const char *name, int times)
+{
+    int diskReads = stats->numDiskReads;
+    double start = HostMicroseconds();
+
+    for (int i = 0; i < times; i++) {
+	OpenFile *openFile = fileSystem->Open(name);
+	ASSERT(openFile != NULL);
+	delete openFile;
+    }
+    printf("Open %s: %.2f us each, %d disk reads\n", what,
+	   (HostMicroseconds() - start) / times,
+	   stats->numDiskReads - diskReads);
+}
+
+void
+DirectoryTest(int count)
+{
+    char name[32];
+    int created;
+
+    if (!fileSystem->CreateDirectory(DirTestName)) {
+	printf("Directory test: can't create %s\n", DirTestName);
+	return;
+    }
+    for (created = 0; created < count; created++) {
+	DirTestFileName(name, created);
+	if (!fileSystem->Create(name, 0))
+	    break;
+    }
+    printf("Directory test: %d files in %s\n", created, DirTestName);
+
+    if (created > 0) {
+	DirTestFileName(name, 0);
+	TimeOpens("of the first file", name, DirTestOpens);
+	DirTestFileName(name, created - 1);
+	TimeOpens("of the last file", name, DirTestOpens);
+
+	int diskReads = stats->numDiskReads;
+	double start = HostMicroseconds();
+	for (int i = 0; i < created; i++) {
+	    DirTestFileName(name, i);
+	    delete fileSystem->Open(name);
+	}
+	printf("Open of every file once: %.2f us each, %d disk reads\n",
+	       (HostMicroseconds() - start) / created,
+	       stats->numDiskReads - diskReads);
+    }
+
+    for (int i = 0; i < created; i++) {
+	DirTestFileName(name, i);
+	fileSystem->Remove(name);
+    }
+    if (!fileSystem->Remove(DirTestName))
+	printf("Directory test: can't remove %s\n", DirTestName);
+}
+
+
+//----------------------------------------------------------------------
+// ConcurrencyTest
+// 	Have several threads use the file system at once:
+//	  each of ConcWriters threads writes a file of its own, growing
+//	    it as it goes, and reads it back;
+//	  two threads write interleaved records to the same file, each
+//	    through an OpenFile of its own, so that both grow the one
+//	    shared header;
+//	and check that nothing got lost or mixed up.  Then remove a file
+//	that is still open, and check it can still be read until closed.
+//----------------------------------------------------------------------
+
+#define ConcWriters 	4
+#define ConcRecords 	64
+#define ConcRecordSize 	64
+#define ConcShared 	"/concshared"
+
+static Semaphore *concDone;
+static int concErrors;
+
+static void
+ConcFileName(char *name, int i)
+{
+    snprintf(name, 16, "/conc%d", i);
 }
 
+static void
+ConcWriter(void *arg)
+{
+    int t = (long) arg;
+    char name[16], record[ConcRecordSize], buffer[ConcRecordSize];
+    OpenFile *openFile;
+
+    ConcFileName(name, t);
+    openFile = fileSystem->Open(name);
+    ASSERT(openFile != NULL);
+    memset(record, 'a' + t, ConcRecordSize);
+    for (int i = 0; i < ConcRecords; i++)
+	if (openFile->Write(record, ConcRecordSize) != ConcRecordSize)
+	    concErrors++;
+    for (int i = 0; i < ConcRecords; i++)
+	if (openFile->ReadAt(buffer, ConcRecordSize, i * ConcRecordSize)
+		!= ConcRecordSize
+	    || memcmp(buffer, record, ConcRecordSize) != 0)
+	    concErrors++;
+    delete openFile;
+    concDone->V();
+}
+
+static void
+SharedWriter(void *arg)
+{
+    int t = (long) arg;
+    char record[ConcRecordSize];
+    OpenFile *openFile = fileSystem->Open(ConcShared);
+
+    ASSERT(openFile != NULL);
+    memset(record, 'A' + t, ConcRecordSize);
+    for (int i = 0; i < ConcRecords; i++)
+	if (openFile->WriteAt(record, ConcRecordSize,
+			      (2 * i + t) * ConcRecordSize) != ConcRecordSize)
+	    concErrors++;
+    delete openFile;
+    concDone->V();
+}
+
+void
+ConcurrencyTest()
+{
+    char name[16], buffer[ConcRecordSize];
+    int start = stats->totalTicks;
+    OpenFile *openFile;
+
+    concErrors = 0;
+    concDone = new Semaphore("concurrency test", 0);
+    for (int t = 0; t < ConcWriters; t++) {
+	ConcFileName(name, t);
+	fileSystem->Create(name, 0);
+    }
+    fileSystem->Create(ConcShared, 0);
+
+    for (long t = 0; t < ConcWriters; t++)
+	(new Thread("file writer"))->Fork(ConcWriter, (void *) t);
+    for (long t = 0; t < 2; t++)
+	(new Thread("shared writer"))->Fork(SharedWriter, (void *) t);
+    for (int t = 0; t < ConcWriters + 2; t++)
+	concDone->P();
+    printf("Concurrency test: %d threads done in %d ticks\n",
+	   ConcWriters + 2, stats->totalTicks - start);
+
+    openFile = fileSystem->Open(ConcShared);
+    ASSERT(openFile != NULL);
+    if (openFile->Length() != 2 * ConcRecords * ConcRecordSize)
+	concErrors++;
+    for (int i = 0; i < 2 * ConcRecords; i++) {
+	openFile->Read(buffer, ConcRecordSize);
+	for (int j = 0; j < ConcRecordSize; j++)
+	    if (buffer[j] != 'A' + i % 2) {
+		concErrors++;
+		break;
+	    }
+    }
+    delete openFile;
+
+    // a removed file lives on until it is closed
+    ConcFileName(name, 0);
+    openFile = fileSystem->Open(name);
+    ASSERT(openFile != NULL);
+    int openFiles = openFileTable->NumOpen();
+    if (!fileSystem->Remove(name) || fileSystem->Open(name) != NULL)
+	concErrors++;
+    if (openFile->ReadAt(buffer, ConcRecordSize, 0) != ConcRecordSize
+	|| buffer[0] != 'a')
+	concErrors++;
+    delete openFile;
+    if (openFileTable->NumOpen() != openFiles - 1)
+	concErrors++;
+
+    for (int t = 1; t < ConcWriters; t++) {
+	ConcFileName(name, t);
+	fileSystem->Remove(name);
+    }
+    fileSystem->Remove(ConcShared);
+    delete concDone;
+    printf("Concurrency test: %d errors\n", concErrors);
+}
+
+//----------------------------------------------------------------------
+// CreateRemoveTest
+// 	Create "count" empty files, then remove them, and print what each
+//	operation cost: simulated time, and disk writes (including the
+//	ones to get everything to disk at the end, by a Sync).  Run
+//	with -nj to see the cost without the journal, and
+//	with -nj -bc 0 for metadata written in place, synchronously.
+//----------------------------------------------------------------------
+
+static void
+CreateRemoveName(char *name, int i)
+{
+    snprintf(name, 16, "cr%d", i);
+}
+
+// Run "count" creates or removes, and print their cost
+static void
+TimeCreateRemove(bool create, int count)
+{
+    char name[16];
+    int start = stats->totalTicks;
+    int diskWrites = stats->numDiskWrites;
+    int done = 0;
+
+    for (int i = 0; i < count; i++) {
+	CreateRemoveName(name, i);
+	if (create ? fileSystem->Create(name, 0) : fileSystem->Remove(name))
+	    done++;
+    }
+    fileSystem->Sync();
+    if (done == 0)
+	return;
+    printf("%s %d files: %d ticks, %.1f disk writes each, "
+	   "%.0f per second of simulated time\n",
+	   create ? "Create" : "Remove", done, (stats->totalTicks - start) / done,
+	   (double) (stats->numDiskWrites - diskWrites) / done,
+	   done * 1e6 / (stats->totalTicks - start));
+}
+
+void
+CreateRemoveTest(int count)
+{
+    fileSystem->Sync();
+    TimeCreateRemove(true, count);
+    TimeCreateRemove(false, count);
+    journal->Print();
+}
+
+//----------------------------------------------------------------------
+// DiskFullTest
+// 	Fill the disk with empty files, then create files in a directory
+//	of their own, making room one sector at a time, until a create
+//	fails because the directory can't grow.  Check, from what is on
+//	disk, that the failed create left nothing behind: the name isn't
+//	in the directory, and its header sector is free again once the
+//	free map is next written (removing a file does that).  The files
+//	are removed afterwards.
+//----------------------------------------------------------------------
+
+#define DiskFullDir	"/diskfull"
+#define DiskFullSub	"/diskfull/sub"
+
+static void
+DiskFullName(char *name, const char *dir, int i)
+{
+    snprintf(name, 32, "%s/file%d", dir, i);
+}
+
+// The directory whose header is at "sector", as it is on disk
+static Directory *
+DirectoryOnDisk(int sector)
+{
+    Directory *directory = new Directory(0);
+    OpenFile *file = new OpenFile(sector);
+
+    fileSystem->Sync();				// commit the journal
+    directory->FetchFrom(file);
+    delete file;
+    return directory;
+}
+
+// Number of free sectors, as the free map on disk says
+static int
+FreeSectorsOnDisk()
+{
+    FreeMap *freeMap = new FreeMap(NumSectors);
+    OpenFile *file = new OpenFile(FreeMapSector);
+
+    fileSystem->Sync();				// commit the journal
+    freeMap->FetchFrom(file);
+    int free = freeMap->NumClear();
+    delete file;
+    delete freeMap;
+    return free;
+}
+
+void
+DiskFullTest()
+{
+    char name[32], entry[16];
+    int filled, added, removed = 0, errors = 0;
+
+    if (!fileSystem->CreateDirectory(DiskFullDir)
+	|| !fileSystem->CreateDirectory(DiskFullSub)) {
+	printf("Disk full test: can't create %s\n", DiskFullSub);
+	return;
+    }
+    for (filled = 0; ; filled++) {
+	DiskFullName(name, DiskFullDir, filled);
+	if (!fileSystem->Create(name, 0))
+	    break;
+    }
+
+    // a sector left free after a failed create means the header was
+    // found, but not room for the name
+    int freeBefore;
+    for (added = 0; ; added++) {
+	DiskFullName(name, DiskFullSub, added);
+	freeBefore = FreeSectorsOnDisk();
+	if (fileSystem->Create(name, 0))
+	    continue;
+	if (freeBefore > 0 && FreeSectorsOnDisk() == freeBefore)
+	    break;
+	if (removed == filled) {
+	    printf("Disk full test: the directory never had to grow\n");
+	    errors++;
+	    break;
+	}
+	DiskFullName(name, DiskFullDir, removed++);
+	fileSystem->Remove(name);
+	added--;				// try the same name again
+    }
+    printf("Disk full test: %d files, then %d more after removing %d\n",
+	   filled, added, removed);
+
+    if (fileSystem->Open(name) != NULL)
+	errors++;
+    Directory *root = DirectoryOnDisk(DirectorySector);
+    Directory *dir = DirectoryOnDisk(root->Find("diskfull"));
+    Directory *sub = DirectoryOnDisk(dir->Find("sub"));
+    snprintf(entry, sizeof(entry), "file%d", added);
+    if (sub->Find(entry) != -1)
+	errors++;
+    delete sub;
+    delete dir;
+    delete root;
+
+    freeBefore = FreeSectorsOnDisk();
+    DiskFullName(name, DiskFullDir, removed++);
+    fileSystem->Remove(name);
+    if (FreeSectorsOnDisk() != freeBefore + 1)
+	errors++;
+
+    for (int i = 0; i < added; i++) {
+	DiskFullName(name, DiskFullSub, i);
+	fileSystem->Remove(name);
+    }
+    for (int i = removed; i < filled; i++) {
+	DiskFullName(name, DiskFullDir, i);
+	fileSystem->Remove(name);
+    }
+    if (!fileSystem->Remove(DiskFullSub) || !fileSystem->Remove(DiskFullDir))
+	errors++;
+    printf("Disk full test: %d errors\n", errors);
+}
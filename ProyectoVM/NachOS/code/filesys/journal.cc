@@ -0,0 +1,450 @@
+// journal.cc
+//	Routines to log file system metadata, see journal.h.
+//
+//	A transaction only goes to the buffer cache once it is in the
+//	log, so the cache can never write half of one to its real place.
+//	The sectors written by the transaction are kept in "pending"
+//	meanwhile; the buffer cache asks us first about every sector it
+//	is asked to read, and about every sector the thread running an
+//	operation writes.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+
+// Layout of the log header, and of the first descriptor sector of a
+// transaction; sector numbers continue into more descriptor sectors
+// if they don't fit in one.
+#define HeadMagic 	0x4c4f4748	// head: magic, next sequence number
+#define TxnMagic 	0x4c4f4754	// descriptor: magic, sequence number,
+#define DescHeader 	5		//   # logged, # revoked, checksum,
+					//   logged sectors, revoked sectors
+#define IntsPerSector 	(SectorSize / (int) sizeof(int))
+
+//----------------------------------------------------------------------
+// LogSector
+// 	Return the disk sector of block "pos" of the log (0 is the header).
+//	The blocks are interleaved, every other sector: by the time we have
+//	been told that one block is written and ask for the next one, the
+//	sector right after it has started to go past the head, and writing
+//	it would take a whole revolution.  The second half of the log
+//	fills the sectors skipped by the first.
+//----------------------------------------------------------------------
+
+static int
+LogSector(int pos)
+{
+    return LogStart + (2 * pos) % LogSectors + (2 * pos) / LogSectors;
+}
+
+//----------------------------------------------------------------------
+// Checksum
+// 	Hash "numBytes" bytes at "data" (FNV-1a), so that the replay can
+//	tell a transaction that was only partly written to the log.
+//----------------------------------------------------------------------
+
+static unsigned
+Checksum(const char *data, int numBytes)
+{
+    unsigned hash = 2166136261u;
+
+    for (int i = 0; i < numBytes; i++) {
+	hash ^= (unsigned char) data[i];
+	hash *= 16777619u;
+    }
+    return hash;
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal.  The log on disk is set up by Format or
+//	Recover, when the file system starts.
+//
+//	"logDisk" -- the disk the log is on
+//	"logging" -- if false, transactions are not logged, and their
+//		sectors go to the buffer cache as they are written
+//----------------------------------------------------------------------
+
+Journal::Journal(SynchDisk *logDisk, bool logging)
+{
+    disk = logDisk;
+    enabled = logging;
+    owner = NULL;
+    depth = 0;
+    nextSeq = 1;
+    tail = 1;
+    groupStart = 0;
+    transactions = logWrites = checkpoints = replayed = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.  This happens when Nachos halts, after
+//	the buffer cache has been flushed, so that everything committed
+//	is in place; the transaction not committed yet goes in place too.
+//	Nothing is left to replay then, and we empty the log.  As in the
+//	buffer cache, we can't block any more, so the disk is polled.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    for (std::map<int, char *>::iterator it = pending.begin();
+	 it != pending.end(); it++) {
+	disk->WriteSectorPolled(it->first, it->second);
+	delete [] it->second;
+    }
+    if (enabled && (tail > 1 || !pending.empty())) {
+	int head[IntsPerSector];
+
+	memset(head, 0, sizeof(head));
+	head[0] = HeadMagic;
+	head[1] = nextSeq;
+	disk->WriteSectorPolled(LogSector(0), (char *) head);
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHead
+// 	Write the log header: transactions numbered from "nextSeq" on,
+//	starting right after the header, are the ones to replay.  Older
+//	ones still in the log are ignored.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHead()
+{
+    int head[IntsPerSector];
+
+    memset(head, 0, sizeof(head));
+    head[0] = HeadMagic;
+    head[1] = nextSeq;
+    disk->WriteSector(LogSector(0), (char *) head);
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Start an empty log on a freshly formatted disk.  Whatever was in
+//	the log region before might look like a transaction, so the place
+//	of the first one is cleared as well.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    char zeros[SectorSize];
+
+    memset(zeros, 0, SectorSize);
+    disk->WriteSector(LogSector(1), zeros);
+    nextSeq = 1;
+    tail = 1;
+    logged.clear();
+    WriteHead();
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Replay the log: write every sector logged by a complete
+//	transaction to its real place, in the order the transactions were
+//	committed, except for sectors freed afterwards.  Then empty the
+//	log.  Called when the file system starts up, before anything is
+//	read through the buffer cache.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    std::vector<std::vector<char> > found;
+    std::map<int, int> lastRevoke;	// sector -> last txn revoking it
+    int head[IntsPerSector];
+    int pos = 1;
+
+    disk->ReadSector(LogSector(0), (char *) head);
+    if (head[0] != HeadMagic) {		// no log yet
+	Format();
+	return;
+    }
+    nextSeq = head[1];
+
+    // find the transactions that made it to the log entirely
+    while (pos < LogSectors) {
+	char first[SectorSize];
+	int *desc = (int *) first;
+
+	disk->ReadSector(LogSector(pos), first);
+	if (desc[0] != TxnMagic || desc[1] != nextSeq
+	    || desc[2] < 0 || desc[3] < 0 || desc[2] + desc[3] > NumSectors)
+	    break;
+	int numLogged = desc[2], numRevoked = desc[3];
+	int size = divRoundUp(DescHeader + numLogged + numRevoked,
+			      IntsPerSector) + numLogged;
+	if (pos + size > LogSectors)
+	    break;
+
+	std::vector<char> txn(size * SectorSize);
+	memcpy(&txn[0], first, SectorSize);
+	for (int i = 1; i < size; i++)
+	    disk->ReadSector(LogSector(pos + i), &txn[i * SectorSize]);
+	desc = (int *) &txn[0];
+	int checksum = desc[4];
+	desc[4] = 0;
+	if ((int) Checksum(&txn[0], txn.size()) != checksum)
+	    break;			// torn write, the log ends here
+	for (int i = 0; i < numRevoked; i++)
+	    lastRevoke[desc[DescHeader + numLogged + i]] = found.size();
+	found.push_back(txn);
+	pos += size;
+	nextSeq++;
+    }
+
+    // and redo them
+    for (int t = 0; t < (int) found.size(); t++) {
+	int *desc = (int *) &found[t][0];
+	int numLogged = desc[2];
+	char *data = &found[t][divRoundUp(DescHeader + numLogged + desc[3],
+					  IntsPerSector) * SectorSize];
+
+	for (int i = 0; i < numLogged; i++) {
+	    int sector = desc[DescHeader + i];
+	    std::map<int, int>::iterator revoke = lastRevoke.find(sector);
+	    if (revoke != lastRevoke.end() && revoke->second >= t)
+		continue;		// freed since, maybe reused for data
+	    disk->WriteSector(sector, &data[i * SectorSize]);
+	}
+    }
+    replayed = found.size();
+    if (replayed > 0)
+	printf("Journal: replayed %d transactions\n", replayed);
+
+    tail = 1;
+    logged.clear();
+    WriteHead();
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start an operation on behalf of the current thread, which holds
+//	the file system lock.  If it is running one already, the new one
+//	is part of it.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    if (depth++ == 0) {
+	owner = currentThread;
+	if (pending.empty() && revoked.empty())
+	    groupStart = stats->totalTicks;
+    } else
+	ASSERT(owner == currentThread);
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	End an operation.  Its sectors join the transaction being put
+//	together; that is written to the log once it is big enough, or
+//	old enough.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    ASSERT(depth > 0 && owner == currentThread);
+    if (--depth > 0)
+	return;
+    owner = NULL;			// from now on, writes go to the cache
+    if ((int) pending.size() >= GroupSectors
+	|| stats->totalTicks - groupStart >= CommitInterval)
+	Commit();
+}
+
+//----------------------------------------------------------------------
+// Journal::Write
+// 	If the current thread is in the middle of an operation, apply a
+//	write to our copy of "sector" instead of the buffer cache, and
+//	return true.  The first time we see the sector, our copy starts
+//	out as what the cache has, unless it is overwritten entirely.
+//----------------------------------------------------------------------
+
+bool
+Journal::Write(int sector, int offset, int numBytes, const char *from)
+{
+    if (!enabled || owner != currentThread)
+	return false;
+
+    std::map<int, char *>::iterator found = pending.find(sector);
+    char *data;
+    if (found != pending.end())
+	data = found->second;
+    else {
+	data = new char[SectorSize];
+	if (offset != 0 || numBytes != SectorSize)
+	    bufferCache->ReadSector(sector, data);
+	pending[sector] = data;
+    }
+    bcopy(from, &data[offset], numBytes);
+    return true;
+}
+
+//----------------------------------------------------------------------
+// Journal::Read
+// 	If the transaction being put together has written "sector", read
+//	it from our copy and return true.  This applies to every thread:
+//	a file grown by one thread is read by others before the
+//	transaction is committed.
+//----------------------------------------------------------------------
+
+bool
+Journal::Read(int sector, int offset, int numBytes, char *into)
+{
+    std::map<int, char *>::iterator found = pending.find(sector);
+
+    if (found == pending.end())
+	return false;
+    bcopy(&found->second[offset], into, numBytes);
+    return true;
+}
+
+//----------------------------------------------------------------------
+// Journal::Revoke
+// 	"sector" has just been freed by the current operation.  It may be
+//	reused as a data block right away, so we drop our copy of it, if
+//	any, and if the log has a copy, the replay must not write it back.
+//----------------------------------------------------------------------
+
+void
+Journal::Revoke(int sector)
+{
+    if (!enabled || owner != currentThread)
+	return;
+
+    std::map<int, char *>::iterator found = pending.find(sector);
+    if (found != pending.end()) {
+	delete [] found->second;
+	pending.erase(found);
+    }
+    if (logged.count(sector) > 0)
+	revoked.push_back(sector);
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the transaction put together so far to the log --
+//	descriptor sectors, then the logged sectors, in one sequential
+//	pass -- and then hand the sectors to the buffer cache, which
+//	writes them to their real place later on.  The file system lock
+//	is held, and no operation is in progress.
+//
+//	If the log is too full, we checkpoint first.  A transaction too
+//	big for the log at all is written in place, after a checkpoint;
+//	it is then not atomic, but everything before it is safe.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    ASSERT(depth == 0);
+    if (pending.empty() && revoked.empty())
+	return;
+
+    int numLogged = pending.size(), numRevoked = revoked.size();
+    int descSectors = divRoundUp(DescHeader + numLogged + numRevoked,
+				 IntsPerSector);
+    int size = descSectors + numLogged;
+
+    if (size > LogSectors - 1) {
+	DEBUG('f', "Transaction of %d sectors too big for the log\n", size);
+	Checkpoint();
+	Install();
+	bufferCache->Flush();
+	return;
+    }
+    if (tail + size > LogSectors)
+	Checkpoint();
+
+    char *log = new char[size * SectorSize];
+    int *desc = (int *) log;
+    int i = DescHeader;
+    memset(log, 0, descSectors * SectorSize);
+    desc[0] = TxnMagic;
+    desc[1] = nextSeq;
+    desc[2] = numLogged;
+    desc[3] = numRevoked;
+    for (std::map<int, char *>::iterator it = pending.begin();
+	 it != pending.end(); it++, i++) {
+	desc[i] = it->first;
+	bcopy(it->second, &log[(descSectors + i - DescHeader) * SectorSize],
+	      SectorSize);
+    }
+    for (unsigned r = 0; r < revoked.size(); r++)
+	desc[i++] = revoked[r];
+    desc[4] = Checksum(log, size * SectorSize);
+
+    DEBUG('f', "Committing transaction %d: %d sectors, %d revoked\n",
+	  nextSeq, numLogged, numRevoked);
+    for (i = 0; i < size; i++)
+	disk->WriteSector(LogSector(tail + i), &log[i * SectorSize]);
+    delete [] log;
+    logWrites += size;
+    tail += size;
+    nextSeq++;
+    transactions++;
+
+    for (std::map<int, char *>::iterator it = pending.begin();
+	 it != pending.end(); it++)
+	logged.insert(it->first);
+    Install();
+}
+
+//----------------------------------------------------------------------
+// Journal::Install
+// 	Hand the sectors of the transaction just committed to the buffer
+//	cache, and forget the transaction.  Other threads may read the
+//	sectors meanwhile, so each one stays in "pending" until the cache
+//	has it.
+//----------------------------------------------------------------------
+
+void
+Journal::Install()
+{
+    while (!pending.empty()) {
+	std::map<int, char *>::iterator it = pending.begin();
+	bufferCache->WriteSector(it->first, it->second);
+	delete [] it->second;
+	pending.erase(it);
+    }
+    revoked.clear();
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Make sure every transaction in the log is in its real place, by
+//	flushing the buffer cache, and start over with an empty log.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    DEBUG('f', "Journal checkpoint at transaction %d\n", nextSeq);
+    bufferCache->Flush();
+    tail = 1;
+    logged.clear();
+    WriteHead();
+    checkpoints++;
+}
+
+//----------------------------------------------------------------------
+// Journal::Print
+// 	Print how much has been logged.
+//----------------------------------------------------------------------
+
+void
+Journal::Print()
+{
+    printf("Journal: %d transactions, %d log sectors written, "
+	   "%d checkpoints%s\n", transactions, logWrites, checkpoints,
+	   enabled ? "" : " (disabled)");
+}
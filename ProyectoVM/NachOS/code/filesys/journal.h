@@ -0,0 +1,119 @@
+// journal.h
+//	Data structures for a write-ahead log of file system metadata.
+//
+//	An operation that changes the file system (creating or removing
+//	a file, growing one) writes several sectors: the bitmap, the
+//	directory, the file header, indirect blocks.  If Nachos stops
+//	half way, the disk is left inconsistent.  So the sectors written
+//	by operations are kept aside, and then written together, in one
+//	pass, to a log region at a well-known place on disk.  Only then
+//	do they go to the buffer cache, to be written to their real place
+//	whenever the cache gets to it.  When the file system starts up,
+//	it replays the log.
+//
+//	To make the most of each write to the log, a transaction groups
+//	the operations of a while: it is committed once it has
+//	GroupSectors sectors, or once its first operation is
+//	CommitInterval ticks old (or when Nachos halts).  After a crash,
+//	the disk is as it was after some operation; the last few
+//	operations may be lost, but no operation is ever half done.
+//
+//	Only metadata is logged: the data blocks of files are written in
+//	place, as before.  Metadata is whatever the thread holding the
+//	file system lock writes inside an operation.
+//
+//	The log is a header sector, followed by transactions, one after
+//	the other.  A transaction is one or more descriptor sectors --
+//	the list of sectors logged, and of sectors freed -- then the
+//	contents of the logged sectors.  A checksum tells whether the
+//	transaction made it to disk entirely.  When the log is full, the
+//	buffer cache is flushed, so that everything logged is in place,
+//	and the log starts over (a "checkpoint").
+//
+//	A sector logged, then freed and reused as a data block, must not
+//	be overwritten by the replay.  Transactions record the sectors
+//	they free ("revoke"), and the replay skips the logged copies of
+//	sectors revoked by the same or a later transaction.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "copyright.h"
+#include "disk.h"
+#include "synchdisk.h"
+
+class Thread;
+
+// Where the log is on disk: right after the headers of the bitmap and
+// of the root directory (cf. filesys.cc), two tracks long.
+#define LogStart 	2
+#define LogSectors 	64
+
+// When to commit the transaction being put together
+#define GroupSectors 	16		// sectors written
+#define CommitInterval 	100000		// ticks since its first operation
+
+// The following class defines the journal.  Operations are started
+// and ended by the thread holding the file system lock, so there is
+// at most one at a time; they nest, and only the outermost one counts.
+
+class Journal {
+  public:
+    Journal(SynchDisk *logDisk, bool logging);
+    				// Initialize; "logging" is false to
+				// write metadata in place, unlogged
+    ~Journal();
+
+    void Format();		// Start an empty log on a new disk
+    void Recover();		// Replay the committed transactions in
+				// the log, then start an empty one
+
+    void Begin();		// Start an operation
+    void End();			// End it; commit the transaction if
+				// it is big or old enough
+    void Commit();		// Write the transaction to the log now
+
+    bool Write(int sector, int offset, int numBytes, const char *from);
+    				// Keep a write of the current operation
+				// aside; false if there is none
+    bool Read(int sector, int offset, int numBytes, char *into);
+    				// Read a sector written by the transaction
+				// not committed yet; false if it wasn't
+    void Revoke(int sector);	// "sector" has been freed
+
+    void Print();		// Print how much was logged
+
+    int transactions;		// transactions committed
+    int logWrites;		// sectors written to the log
+    int checkpoints;		// times the log was emptied
+    int replayed;		// transactions replayed at start-up
+
+  private:
+    void Checkpoint();		// Flush the cache, and empty the log
+    void WriteHead();		// Write the log header
+    void Install();		// Hand the logged sectors to the cache
+
+    SynchDisk *disk;		// where the log is
+    bool enabled;		// logging at all?
+    Thread *owner;		// thread running the transaction
+    int depth;			// nesting of Begin calls
+    int groupStart;		// when the transaction started
+    std::map<int, char *> pending;
+    				// sectors written by the transaction,
+				// with their new contents
+    std::vector<int> revoked;	// logged sectors freed by the transaction
+    std::set<int> logged;	// sectors in the log since the last
+				// checkpoint
+    int nextSeq;		// sequence number of the next transaction
+    int tail;			// block of the log where it goes
+};
+
+#endif // JOURNAL_H
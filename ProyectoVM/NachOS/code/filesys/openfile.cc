@@ -5,7 +5,8 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  There is one copy of it however
+//	many times the file is open, in the open file table.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -13,32 +14,33 @@
 
 #include "copyright.h"
 #include "filehdr.h"
+#include "filetable.h"
 #include "openfile.h"
 #include "system.h"
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless it is open already.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    node = openFileTable->Open(sector);
     seekPosition = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
-// 	Close a Nachos file, de-allocating any in-memory data structures.
+// 	Close a Nachos file, de-allocating any in-memory data structures
+//	nobody else is using.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    openFileTable->Close(node);
 }
 
 //----------------------------------------------------------------------
@@ -91,17 +93,18 @@ OpenFile::Write(const char *into, int numBytes)
 //	no side effects (except that Write modifies the file, of course).
 //
 //	There is no guarantee the request starts or ends on an even disk sector
-//	boundary; however the disk only knows how to read/write a whole disk
-//	sector at a time.  Thus:
+//	boundary.  Each sector touched by the request is handed to the
+//	buffer cache with the byte range we are interested in; the cache
+//	only goes to the disk for sectors it doesn't hold (and, on a
+//	write, only if the sector is partially written).
 //
-//	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
-//	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	A write past the end of the file makes the file grow; if the
+//	disk is full, we write only what fits in the file as it is.
+//	Bytes skipped over by a write past the end read as zeros.
+//
+//	Reads hold the file's lock shared, and writes exclusive, so that
+//	a read never sees half of a write, and two writes never mix.
+//	Only growing the file takes the file system lock, to allocate.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -113,72 +116,76 @@ OpenFile::Write(const char *into, int numBytes)
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    FileHeader *hdr = node->hdr;
+    int fileLength, done, offset, chunk;
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    node->lock->AcquireRead();
+    fileLength = hdr->FileLength();
+    if ((numBytes <= 0) || (position < 0) || (position >= fileLength)) {
+	node->lock->ReleaseRead();
     	return 0; 				// check request
+    }
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    // copy the part we want of every full or partial sector
+    for (done = 0; done < numBytes; done += chunk) {
+	offset = (position + done) % SectorSize;
+	chunk = SectorSize - offset;
+	if (chunk > numBytes - done)
+	    chunk = numBytes - done;
+	bufferCache->ReadBytes(hdr->ByteToSector(position + done), offset,
+			       chunk, &into[done]);
+    }
+    node->lock->ReleaseRead();
     return numBytes;
 }
 
 int
 OpenFile::WriteAt(const char *from, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    static const char zeros[SectorSize] = { 0 };
+    FileHeader *hdr = node->hdr;
+    int fileLength, done, offset, chunk;
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position < 0))
 	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-	numBytes = fileLength - position;
+    node->lock->AcquireWrite();
+    fileLength = hdr->FileLength();
+    if ((position + numBytes) > fileLength) {
+	if (fileSystem->Extend(hdr, node->sector, position + numBytes)) {
+	    // zero the gap between the old end of file and "position"
+	    for (done = fileLength; done < position; done += chunk) {
+		offset = done % SectorSize;
+		chunk = SectorSize - offset;
+		if (chunk > position - done)
+		    chunk = position - done;
+		bufferCache->WriteBytes(hdr->ByteToSector(done), offset,
+					chunk, zeros);
+	    }
+	    fileLength = hdr->FileLength();
+	} else if (position >= fileLength) {
+	    node->lock->ReleaseWrite();
+	    return 0;				// no room to grow
+	} else {
+	    numBytes = fileLength - position;
+	}
+    }
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+    // copy in the bytes we want to change, sector by sector
+    for (done = 0; done < numBytes; done += chunk) {
+	offset = (position + done) % SectorSize;
+	chunk = SectorSize - offset;
+	if (chunk > numBytes - done)
+	    chunk = numBytes - done;
+	bufferCache->WriteBytes(hdr->ByteToSector(position + done), offset,
+				chunk, &from[done]);
+    }
+    node->lock->ReleaseWrite();
     return numBytes;
 }
 
@@ -190,5 +197,27 @@ OpenFile::WriteAt(const char *from, int numBytes, int position)
 int
 OpenFile::Length() 
 { 
-    return hdr->FileLength(); 
+    int length;
+
+    node->lock->AcquireRead();
+    length = node->hdr->FileLength(); 
+    node->lock->ReleaseRead();
+    return length;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::NumRuns
+// 	Return how many runs of consecutive sectors the file is stored
+//	in, to measure how fragmented it is.
+//----------------------------------------------------------------------
+
+int
+OpenFile::NumRuns()
+{
+    int runs;
+
+    node->lock->AcquireRead();
+    runs = node->hdr->NumRuns();
+    node->lock->ReleaseRead();
+    return runs;
 }
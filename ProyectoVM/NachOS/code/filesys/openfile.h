@@ -9,9 +9,10 @@
 //
 //	The other is the "real" implementation, that turns these
 //	operations into read and write disk sector requests. 
-//	In this baseline implementation of the file system, we don't 
-//	worry about concurrent accesses to the file system
-//	by different threads -- this is part of the assignment.
+//	Several OpenFiles can be open on the same file, each with its
+//	own seek position; they share the file's header and lock through
+//	the table of open files (cf. filetable.h).  Each ReadAt and
+//	WriteAt is atomic with respect to the others on the same file.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -59,13 +60,15 @@ class OpenFile {
 };
 
 #else // FILESYS
-class FileHeader;
+class FileNode;
 
 class OpenFile {
   public:
     OpenFile(int sector);		// Open a file whose header is located
 					// at "sector" on the disk
-    ~OpenFile();			// Close the file
+    ~OpenFile();			// Close the file; the file is freed
+					// if it was removed, and this was
+					// the last OpenFile on it
 
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
@@ -86,9 +89,13 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+
+    int NumRuns();			// Number of contiguous runs of
+					// sectors the file is stored in
     
   private:
-    FileHeader *hdr;			// Header for this file 
+    FileNode *node;			// The file, with its header and lock,
+					// shared with other OpenFiles on it
     int seekPosition;			// Current position within the file
 };
 
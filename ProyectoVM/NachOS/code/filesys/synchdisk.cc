@@ -5,10 +5,11 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Because the physical disk can only handle one operation at a
+//	time, requests that arrive while it is busy are queued.  The
+//	disk interrupt handler wakes up the thread whose request just
+//	finished, and sends the next request to the disk, chosen by the
+//	scheduling policy.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +17,7 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -42,9 +44,12 @@ DiskRequestDone (void* arg)
 
 SynchDisk::SynchDisk(const char* name)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
     disk = new Disk(name, DiskRequestDone, this);
+    policy = DISK_FCFS;
+    current = NULL;
+    headTrack = 0;
+    sweepingUp = true;
+    ResetStats();
 }
 
 //----------------------------------------------------------------------
@@ -56,8 +61,6 @@ SynchDisk::SynchDisk(const char* name)
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
 }
 
 //----------------------------------------------------------------------
@@ -72,10 +75,14 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    DiskRequest request = { sectorNumber, data, false, currentThread,
+			    false, stats->totalTicks };
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    Queue(&request);
+    while (!request.done)		// wait for interrupt
+	currentThread->Sleep();
+    interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
@@ -90,20 +97,188 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, const char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    DiskRequest request = { sectorNumber, (char *) data, true, currentThread,
+			    false, stats->totalTicks };
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    Queue(&request);
+    while (!request.done)		// wait for interrupt
+	currentThread->Sleep();
+    interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectorPolled
+// 	Write a sector when the current thread can't go to sleep, for
+//	instance once the machine is halting and the current thread is
+//	about to be destroyed.  Instead of sleeping, we let simulated
+//	time run until the disk has served our request (and whatever was
+//	queued before it).  Interrupts stay off, so no other thread runs
+//	meanwhile.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectorPolled(int sectorNumber, const char* data)
+{
+    DiskRequest request = { sectorNumber, (char *) data, true, NULL,
+			    false, stats->totalTicks };
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    Queue(&request);
+    while (!request.done)
+	interrupt->Idle();
+    interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Queue
+// 	Send a request to the disk if it is idle, otherwise leave it
+//	on the queue for RequestDone.  Interrupts must be off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Queue(DiskRequest *request)
+{
+    ASSERT(interrupt->getLevel() == IntOff);
+    if (current == NULL) {
+	Dispatch(request);
+	return;
+    }
+    queue.push_back(request);
+    if ((int) queue.size() > maxQueue)
+	maxQueue = queue.size();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Dispatch
+// 	Send a request to the raw disk, keeping track of the head.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Dispatch(DiskRequest *request)
+{
+    int track = request->sector / SectorsPerTrack;
+
+    current = request;
+    seekTracks += (track > headTrack) ? track - headTrack : headTrack - track;
+    if (track != headTrack)
+	sweepingUp = (track > headTrack);
+    headTrack = track;
+    if (request->writing)
+	disk->WriteRequest(request->sector, request->data);
+    else
+	disk->ReadRequest(request->sector, request->data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::NextRequest
+// 	Remove from the queue the request to serve next, NULL if there is
+//	none.  Ties go to the request that arrived first.
+//
+//	SSTF may starve requests far from a busy region of the disk; SCAN
+//	and C-SCAN sweep the whole disk, so every request is served within
+//	one or two sweeps.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::NextRequest()
+{
+    int best = -1, bestDistance = 0;
+
+    for (int i = 0; i < (int) queue.size(); i++) {
+	int track = queue[i]->sector / SectorsPerTrack;
+	int distance;
+
+	switch (policy) {
+	  case DISK_FCFS:
+	    distance = 0;			// the first one wins
+	    break;
+	  case DISK_SSTF:
+	    distance = (track > headTrack) ? track - headTrack
+					   : headTrack - track;
+	    break;
+	  case DISK_SCAN:
+	    // tracks ahead of us in the sweep first, then the ones behind,
+	    // nearest first
+	    if (sweepingUp)
+		distance = (track >= headTrack) ? track - headTrack
+						: NumTracks + headTrack - track;
+	    else
+		distance = (track <= headTrack) ? headTrack - track
+						: NumTracks + track - headTrack;
+	    break;
+	  case DISK_CSCAN:
+	  default:
+	    // tracks from the head up, then from track 0 up
+	    distance = (track >= headTrack) ? track - headTrack
+					    : NumTracks + track;
+	    break;
+	}
+	if (best == -1 || distance < bestDistance) {
+	    best = i;
+	    bestDistance = distance;
+	}
+    }
+    if (best == -1)
+	return NULL;
+
+    DiskRequest *request = queue[best];
+    queue.erase(queue.begin() + best);
+    return request;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Wake up the thread waiting for the disk
+//	request that just finished, and start the next one.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::RequestDone()
 { 
-    semaphore->V();
+    DiskRequest *request = current;
+    int latency = stats->totalTicks - request->arrival;
+
+    requests++;
+    totalLatency += latency;
+    if (latency > maxLatency)
+	maxLatency = latency;
+
+    request->done = true;
+    if (request->waiter != NULL)
+	scheduler->ReadyToRun(request->waiter);
+
+    current = NULL;
+    DiskRequest *next = NextRequest();
+    if (next != NULL)
+	Dispatch(next);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ResetStats/PrintStats
+// 	Keep track of how well the scheduling policy does: how far the
+//	head moved per request, and how long requests took from the time
+//	they were queued until they were done.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ResetStats()
+{
+    requests = seekTracks = totalLatency = maxLatency = maxQueue = 0;
+}
+
+void
+SynchDisk::PrintStats()
+{
+    static const char *policyNames[] = { "FCFS", "SSTF", "SCAN", "C-SCAN" };
+
+    printf("Disk scheduling (%s): %d requests, average seek %.2f tracks, "
+	   "average latency %.0f ticks, max latency %d ticks, "
+	   "max queue %d\n", policyNames[policy], requests,
+	   requests > 0 ? (double) seekTracks / requests : 0.0,
+	   requests > 0 ? (double) totalLatency / requests : 0.0,
+	   maxLatency, maxQueue);
 }
@@ -11,8 +11,29 @@
 #ifndef SYNCHDISK_H
 #define SYNCHDISK_H
 
+#include <vector>
+
 #include "disk.h"
-#include "synch.h"
+#include "thread.h"
+
+// Order in which queued requests are sent to the disk
+enum DiskPolicy {
+    DISK_FCFS,		// first come, first served
+    DISK_SSTF,		// shortest seek (track distance) first
+    DISK_SCAN,		// elevator: sweep up, then down, then up...
+    DISK_CSCAN		// sweep up only, then jump back to the lowest track
+};
+
+// A request waiting for the disk, or being served by it.  Lives on the
+// stack of the thread that asked for it.
+struct DiskRequest {
+    int sector;			// sector to read or write
+    char *data;			// where to read to, or write from
+    bool writing;		// WriteRequest instead of ReadRequest
+    Thread *waiter;		// thread to wake when done, NULL if polled
+    bool done;			// set by the interrupt handler
+    int arrival;		// stats->totalTicks when queued
+};
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -24,6 +45,10 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// Requests from different threads are queued while the disk is busy,
+// and the interrupt handler picks the next one to serve according to
+// the scheduling policy, to cut down the time spent seeking.
 class SynchDisk {
   public:
     SynchDisk(const char* name);    	// Initialize a synchronous disk,
@@ -33,21 +58,45 @@ class SynchDisk {
     void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
-					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
+					// or written.  These queue the
+    					// request and wait until it is done.
     void WriteSector(int sectorNumber, const char* data);
+
+    void WriteSectorPolled(int sectorNumber, const char* data);
+    					// Same, but waits by advancing
+					// simulated time instead of
+					// sleeping.  For shutdown, when
+					// the current thread can't block.
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
 
+    void SetPolicy(DiskPolicy newPolicy) { policy = newPolicy; }
+    DiskPolicy GetPolicy() { return policy; }
+    void SetTrackBuffers(int tracks) { disk->SetTrackBuffers(tracks); }
+    void ResetStats();			// Forget the numbers so far
+    void PrintStats();			// Print seek distance and latency
+
   private:
+    void Queue(DiskRequest *request);	// Send to the disk, or queue it
+    void Dispatch(DiskRequest *request);	// Send to the disk
+    DiskRequest *NextRequest();		// Take the next request to serve
+					// off the queue, per the policy
+
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskPolicy policy;			// how to pick the next request
+    std::vector<DiskRequest *> queue;	// requests waiting for the disk,
+					// in arrival order
+    DiskRequest *current;		// request being served, NULL if idle
+    int headTrack;			// track the head is over
+    bool sweepingUp;			// SCAN direction
+
+    int requests;			// requests served
+    int seekTracks;			// tracks crossed to serve them
+    int totalLatency;			// ticks from queueing to completion
+    int maxLatency;			// worst of those
+    int maxQueue;			// most requests waiting at once
 };
 
 #endif // SYNCHDISK_H
@@ -17,6 +17,8 @@
 #include "console.h"
 #include "system.h"
 
+#include <poll.h>
+
 // Dummy functions because C++ is weird about pointers to member functions
 static void ConsoleReadPoll(void* c) 
 { Console *console = (Console *)c; console->CheckCharAvail(); }
@@ -56,8 +58,9 @@ Console::Console(const char *readFile, const char *writeFile,
     putBusy = false;
     incoming = EOF;
 
-    // start polling for incoming packets
-    interrupt->Schedule(ConsoleReadPoll, this, ConsoleTime, ConsoleReadInt);
+    // wait for the first character
+    interrupt->WatchFd(readFileNo, POLLIN, ConsoleReadPoll, this,
+		       ConsoleReadInt);
 }
 
 //----------------------------------------------------------------------
@@ -67,6 +70,7 @@ Console::Console(const char *readFile, const char *writeFile,
 
 Console::~Console()
 {
+    interrupt->UnwatchFd(readFileNo);
     if (readFileNo != 0)
 	Close(readFileNo);
     if (writeFileNo != 1)
@@ -75,11 +79,11 @@ Console::~Console()
 
 //----------------------------------------------------------------------
 // Console::CheckCharAvail()
-// 	Periodically called to check if a character is available for
-//	input from the simulated keyboard (eg, has it been typed?).
+// 	Called when the simulated keyboard has input (eg, a key has been
+//	typed).  We only wait for it when there is buffer space for a
+//	character (when the previous one has been grabbed out of the
+//	buffer by the Nachos kernel).
 //
-//	Only read it in if there is buffer space for it (if the previous
-//	character has been grabbed out of the buffer by the Nachos kernel).
 //	Invoke the "read" interrupt handler, once the character has been 
 //	put into the buffer. 
 //----------------------------------------------------------------------
@@ -89,13 +93,13 @@ Console::CheckCharAvail()
 {
     char c;
 
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(ConsoleReadPoll, this, ConsoleTime, 
-			ConsoleReadInt);
-
-    // do nothing if character is already buffered, or none to be read
-    if ((incoming != EOF) || !PollFile(readFileNo))
+    if (incoming != EOF)	// GetChar will wait for the next one
+	return;
+    if (!PollFile(readFileNo)) {	// nothing to be read after all
+	interrupt->WatchFd(readFileNo, POLLIN, ConsoleReadPoll, this,
+			   ConsoleReadInt);
 	return;	  
+    }
 
     // otherwise, read character and tell user about it
     Read(readFileNo, &c, sizeof(char));
@@ -130,6 +134,9 @@ Console::GetChar()
 {
    char ch = incoming;
 
+   if (ch != EOF)		// room for the next one
+	interrupt->WatchFd(readFileNo, POLLIN, ConsoleReadPoll, this,
+			   ConsoleReadInt);
    incoming = EOF;
    return ch;
 }
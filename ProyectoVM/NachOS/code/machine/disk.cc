@@ -50,6 +50,11 @@ Disk::Disk(const char* name, VoidFunctionPtr callWhenDone, void* callArg)
     handlerArg = callArg;
     lastSector = 0;
     bufferInit = 0;
+#ifndef NOTRACKBUF
+    SetTrackBuffers(1);
+#else
+    SetTrackBuffers(0);
+#endif
     
     fileno = OpenForReadWrite(name, false);
     if (fileno >= 0) {		 	// file exists, check magic number 
@@ -64,17 +69,24 @@ Disk::Disk(const char* name, VoidFunctionPtr callWhenDone, void* callArg)
         Lseek(fileno, DiskSize - sizeof(int), 0);	
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+#ifndef NODISKMAP
+    image = MapFile(fileno, DiskSize);
+#else
+    image = NULL;
+#endif
     active = false;
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
-// 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+// 	Clean up disk simulation, by writing back the mapping (if any) and
+//	closing the UNIX file representing the disk.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    if (image != NULL)
+	UnmapFile(image, DiskSize);
     Close(fileno);
 }
 
@@ -100,7 +112,8 @@ PrintSector (bool writing, int sector, const char *data)
 //----------------------------------------------------------------------
 // Disk::ReadRequest/WriteRequest
 // 	Simulate a request to read/write a single disk sector
-//	   Do the read/write immediately to the UNIX file
+//	   Do the read/write immediately to the UNIX file (or its
+//	      mapping in memory)
 //	   Set up an interrupt handler to be called later,
 //	      that will notify the caller when the simulator says
 //	      the operation has completed.
@@ -115,19 +128,29 @@ PrintSector (bool writing, int sector, const char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, false);
+    int saved;
+    int ticks = Latency(sectorNumber, false, &saved);
 
     ASSERT(!active);				// only one request at a time
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
     
     DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    if (image != NULL)
+	memcpy(data, image + SectorSize * sectorNumber + MagicSize, SectorSize);
+    else
+	ReadAt(fileno, data, SectorSize, SectorSize * sectorNumber + MagicSize);
     if (DebugIsEnabled('d'))
 	PrintSector(false, sectorNumber, data);
     
     active = true;
-    UpdateLast(sectorNumber);
+    if (saved >= 0) {
+	stats->numTrackBufferHits++;
+	stats->trackBufferTicksSaved += saved;
+    }
+    // a sector from the buffer of another track doesn't move the head
+    if (saved < 0 || sectorNumber / SectorsPerTrack
+			== lastSector / SectorsPerTrack)
+	UpdateLast(sectorNumber);
     stats->numDiskReads++;
     interrupt->Schedule(DiskDone, this, ticks, DiskInt);
 }
@@ -141,8 +164,10 @@ Disk::WriteRequest(int sectorNumber, const char* data)
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
     
     DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    if (image != NULL)
+	memcpy(image + SectorSize * sectorNumber + MagicSize, data, SectorSize);
+    else
+	WriteAt(fileno, data, SectorSize, SectorSize * sectorNumber + MagicSize);
     if (DebugIsEnabled('d'))
 	PrintSector(true, sectorNumber, data);
     
@@ -226,30 +251,86 @@ Disk::ModuloDiff(int to, int from)
 //   	the contents of the current disk track into the buffer.  This allows 
 //   	read requests to the current track to be satisfied more quickly.
 //   	The contents of the track buffer are discarded after every seek to 
-//   	a new track.
+//   	a new track -- unless the controller has room for several tracks,
+//	in which case it keeps what it read of the last few (cf.
+//	SetTrackBuffers).
 //----------------------------------------------------------------------
 
 int
 Disk::ComputeLatency(int newSector, bool writing)
+{
+    int saved;
+
+    return Latency(newSector, writing, &saved);
+}
+
+int
+Disk::Latency(int newSector, bool writing, int *saved)
 {
     int rotation;
     int seek = TimeToSeek(newSector, &rotation);
     int timeAfter = stats->totalTicks + seek + rotation;
+    int latency = seek + rotation + RotationTime
+	+ ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+    bool buffered = false;
+
+    if (!writing && numTrackBuffers > 0) {
+	// check if the buffer of the current track applies
+	if ((seek == 0) && (((timeAfter - bufferInit) / RotationTime) 
+			> ModuloDiff(newSector, bufferInit / RotationTime)))
+	    buffered = true;
+
+	// or the buffer of a track the head was on before
+	int slot = FindOldTrack(newSector / SectorsPerTrack);
+	if (!buffered && slot != -1) {
+	    TrackBuffer *old = &oldTracks[slot];
+	    if ((old->end - old->start) / RotationTime
+			> ModuloDiff(newSector, old->start / RotationTime)) {
+		old->lastUsed = stats->totalTicks;
+		buffered = true;
+	    }
+	}
+    }
 
-#ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
-    // check if track buffer applies
-    if ((writing == false) && (seek == 0) 
-		&& (((timeAfter - bufferInit) / RotationTime) 
-	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
+    if (buffered) {
+	*saved = latency - RotationTime;
         DEBUG('d', "Request latency = %d\n", RotationTime);
 	return RotationTime; // time to transfer sector from the track buffer
     }
-#endif
+    *saved = -1;
+    DEBUG('d', "Request latency = %d\n", latency);
+    return latency;
+}
+
+//----------------------------------------------------------------------
+// Disk::SetTrackBuffers
+// 	Set how many tracks the controller can buffer: the one under the
+//	head, plus "tracks" - 1 tracks the head was on before, the most
+//	recently used ones.  0 means no track buffer at all.
+//----------------------------------------------------------------------
 
-    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+void
+Disk::SetTrackBuffers(int tracks)
+{
+    ASSERT((tracks >= 0) && (tracks <= NumTracks));
+    numTrackBuffers = tracks;
+    for (int i = 0; i < NumTracks; i++)
+	oldTracks[i].track = -1;
+}
 
-    DEBUG('d', "Request latency = %d\n", seek + rotation + RotationTime);
-    return(seek + rotation + RotationTime);
+//----------------------------------------------------------------------
+// Disk::FindOldTrack
+// 	Return the slot of "track" among the tracks buffered that the
+//	head isn't on, or -1 if it isn't buffered.
+//----------------------------------------------------------------------
+
+int
+Disk::FindOldTrack(int track)
+{
+    for (int i = 0; i < numTrackBuffers - 1; i++)
+	if (oldTracks[i].track == track)
+	    return i;
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -264,8 +345,46 @@ Disk::UpdateLast(int newSector)
     int rotate;
     int seek = TimeToSeek(newSector, &rotate);
     
-    if (seek != 0)
+    if (seek != 0) {
+	if (numTrackBuffers > 1)
+	    KeepOldTrack();
 	bufferInit = stats->totalTicks + seek + rotate;
+    }
     lastSector = newSector;
     DEBUG('d', "Updating last sector = %d, %d\n", lastSector, bufferInit);
 }
+
+//----------------------------------------------------------------------
+// Disk::KeepOldTrack
+//   	The head is about to leave its track: keep what was read of it
+//	in a buffer of its own, in place of the least recently used one.
+//	If the track is buffered already, keep the longer of the two
+//	reads.
+//----------------------------------------------------------------------
+
+void
+Disk::KeepOldTrack()
+{
+    int track = lastSector / SectorsPerTrack;
+    int slot = FindOldTrack(track);
+
+    if (slot == -1) {
+	slot = 0;
+	for (int i = 0; i < numTrackBuffers - 1; i++) {
+	    if (oldTracks[i].track == -1) {
+		slot = i;
+		break;
+	    }
+	    if (oldTracks[i].lastUsed < oldTracks[slot].lastUsed)
+		slot = i;
+	}
+    } else if (oldTracks[slot].end - oldTracks[slot].start
+			>= stats->totalTicks - bufferInit) {
+	oldTracks[slot].lastUsed = stats->totalTicks;
+	return;
+    }
+    oldTracks[slot].track = track;
+    oldTracks[slot].start = bufferInit;
+    oldTracks[slot].end = stats->totalTicks;
+    oldTracks[slot].lastUsed = stats->totalTicks;
+}
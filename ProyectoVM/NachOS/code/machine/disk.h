@@ -44,7 +44,16 @@
 // quickly, because its contents are in the track buffer.  Most 
 // disks these days now come with a track buffer.
 //
-// The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+// The track buffer simulation can be disabled by compiling with -DNOTRACKBUF,
+// or by calling SetTrackBuffers(0).  The controller can also be given
+// room for more than one track: then it keeps what it read of the last
+// few tracks the head was on, and a read that finds its sector there
+// takes only the transfer time, without moving the head at all.
+//
+// The UNIX file is mapped into memory, so that a request is a copy to or
+// from the mapping, instead of system calls.  Compiling with -DNODISKMAP
+// (or a file that can't be mapped) uses pread/pwrite instead.  Either way,
+// the simulated time of the requests is the same.
 
 const int SectorSize = 128;	// number of bytes per disk sector
 const int SectorsPerTrack = 32;	// number of sectors per disk track 
@@ -52,6 +61,17 @@ const int NumTracks = 32;	// number of tracks per disk
 const int NumSectors = SectorsPerTrack * NumTracks;
 					// total # of sectors per disk
 
+// What the controller kept of a track the head has moved away from: the
+// sectors that passed under the head between "start" and "end".
+
+class TrackBuffer {
+  public:
+    int track;				// -1 if the slot is unused
+    int start;				// when the head got to the track
+    int end;				// when it left
+    int lastUsed;			// when a read last hit, for LRU
+};
+
 class Disk {
   public:
     Disk(const char* name, VoidFunctionPtr callWhenDone, void* callArg);
@@ -75,8 +95,15 @@ class Disk {
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
 
+    void SetTrackBuffers(int tracks);	// Buffer the last "tracks" tracks
+					// read, counting the one under the
+					// head (1, the default, buffers just
+					// that one; 0 turns buffering off)
+
   private:
     int fileno;				// UNIX file number for simulated disk 
+    char *image;			// The file, mapped into memory; NULL
+					// if we use pread/pwrite
     VoidFunctionPtr handler;		// Interrupt handler, to be invoked 
 					// when any disk request finishes
     void* handlerArg;			// Argument to interrupt handler 
@@ -85,8 +112,18 @@ class Disk {
     int bufferInit;			// When the track buffer started 
 					// being loaded
 
+    int numTrackBuffers;		// tracks the controller can buffer
+    TrackBuffer oldTracks[NumTracks];	// tracks buffered, besides the one
+					// under the head
+
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
+    int Latency(int newSector, bool writing, int *saved);
+    					// ComputeLatency; "saved" is set to
+					// the time saved by the track buffer,
+					// -1 if it didn't have the sector
+    int FindOldTrack(int track);	// slot in oldTracks of "track", or -1
+    void KeepOldTrack();		// Buffer the track the head is leaving
     void UpdateLast(int newSector);
 };
 
@@ -14,6 +14,10 @@
 //		a user instruction is executed
 //		there is nothing in the ready queue
 //
+//	When there is nothing in the ready queue, and host files are
+//	being watched, time also advances with real time, as we wait
+//	for them (cf. CheckHost).
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -24,11 +28,20 @@
 #include "interrupt.h"
 #include "system.h"
 
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MaxHostEvents	16	// host files handled per check, at most
+
 // String definitions for debugging messages
 
 static const char *intLevelNames[] = { "off", "on"};
 static const char *intTypeNames[] = { "timer", "disk", "console write", 
-				      "console read", "network send", "network recv"};
+				      "console read", "network send", "network recv",
+				      "host poll"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -64,6 +77,10 @@ Interrupt::Interrupt()
     inHandler = false;
     yieldOnReturn = false;
     status = SystemMode;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    ASSERT(epollFd != -1);
+    numArmed = 0;
+    lastHostCheck = 0;
 }
 
 //----------------------------------------------------------------------
@@ -76,6 +93,10 @@ Interrupt::~Interrupt()
     while (!pending->IsEmpty())
 	delete pending->Remove();
     delete pending;
+    for (std::map<int, HostWatch*>::iterator it = watched.begin();
+	 it != watched.end(); it++)
+	delete it->second;
+    close(epollFd);
 }
 
 //----------------------------------------------------------------------
@@ -156,9 +177,13 @@ Interrupt::OneTick()
     if (status == SystemMode) {
         stats->totalTicks += SystemTick;
 	stats->systemTicks += SystemTick;
+	if (currentThread != NULL)
+	    currentThread->accounting.systemTicks += SystemTick;
     } else {					// USER_PROGRAM
 	stats->totalTicks += UserTick;
 	stats->userTicks += UserTick;
+	if (currentThread != NULL)
+	    currentThread->accounting.userTicks += UserTick;
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
@@ -168,12 +193,14 @@ Interrupt::OneTick()
 					// interrupts disabled)
     while (CheckIfDue(false))		// check for pending interrupts
 	;
+    if (numArmed > 0 && stats->totalTicks - lastHostCheck >= HostCheckTicks)
+	CheckHost(false);		// and for host files that are ready
     ChangeLevel(IntOff, IntOn);		// re-enable interrupts
     if (yieldOnReturn) {		// if the timer device handler asked 
 					// for a context switch, ok to do it now
 	yieldOnReturn = false;
  	status = SystemMode;		// yield is a kernel routine
-	currentThread->Yield();
+	currentThread->Yield(true);
 	status = old;
     }
 }
@@ -204,28 +231,35 @@ Interrupt::YieldOnReturn()
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
 //
-//	If there are no pending interrupts, stop.  There's nothing
-//	more for us to do.
+//	If host files are being watched, wait for them in the meantime,
+//	as long as it takes to get there.
+//
+//	If there are no pending interrupts, and no host files to wait
+//	for, stop.  There's nothing more for us to do.
 //----------------------------------------------------------------------
 void
 Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
-    if (CheckIfDue(true)) {		// check for any pending interrupts
-    	while (CheckIfDue(false))	// check for any other pending 
-	    ;				// interrupts
-        yieldOnReturn = false;		// since there's nothing in the
+    do {
+	if (CheckHost(true) || CheckIfDue(true)) {
+					// check for host files, and
+					// any pending interrupts
+	    while (CheckIfDue(false))	// check for any other pending 
+		;			// interrupts
+	    yieldOnReturn = false;	// since there's nothing in the
 					// ready queue, the yield is automatic
-        status = SystemMode;
-	return;				// return in case there's now
+	    status = SystemMode;
+	    return;			// return in case there's now
 					// a runnable thread
-    }
+	}
+    } while (numArmed > 0);
 
     // if there are no pending interrupts, and nothing is on the ready
     // queue, it is time to stop.   If the console or the network is 
-    // operating, there are *always* pending interrupts, so this code
-    // is not reached.  Instead, the halt must be invoked by the user program.
+    // operating, they always wait for the host, so this code is not
+    // reached.  Instead, the halt must be invoked by the user program.
 
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
@@ -242,6 +276,7 @@ Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
     stats->Print();
+    stats->Dump();
     Cleanup();     // Never returns.
 }
 
@@ -285,7 +320,8 @@ Interrupt::Schedule(VoidFunctionPtr handler, void* arg, int fromNow, IntType typ
 //		so we should simply advance the clock to when the next 
 //		pending interrupt would occur (if any).  If the pending
 //		interrupt is just the time-slice daemon, however, then 
-//		we're done!
+//		we're done!  (Other timers, such as the post office's,
+//		use TimerInt too, but only with no timer device.)
 //----------------------------------------------------------------------
 bool
 Interrupt::CheckIfDue(bool advanceClock)
@@ -313,7 +349,7 @@ Interrupt::CheckIfDue(bool advanceClock)
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
+				&& pending->IsEmpty() && (timer != NULL)) {
 	 pending->SortedInsert(toOccur, when);
 	 return false;
     }
@@ -335,6 +371,164 @@ Interrupt::CheckIfDue(bool advanceClock)
     return true;
 }
 
+//----------------------------------------------------------------------
+// Interrupt::WatchFd
+// 	Arrange for the CPU to be interrupted once the host file "fd" is
+//	ready.  Only once: the device calls WatchFd again when it wants
+//	more, typically after the kernel has taken what it got.
+//
+//	Files epoll can't watch, like regular files, are always ready:
+//	the interrupt is simply scheduled for the next tick.
+//
+//	"fd" -- the host file
+//	"events" -- what to wait for: POLLIN (input to read) and/or
+//		POLLOUT (room to write)
+//	"handler", "arg", "type" -- as in Schedule
+//----------------------------------------------------------------------
+void
+Interrupt::WatchFd(int fd, int events, VoidFunctionPtr handler, void* arg,
+		   IntType type)
+{
+    struct epoll_event event;
+    std::map<int, HostWatch*>::iterator found = watched.find(fd);
+
+    event.events = EPOLLONESHOT | ((events & POLLIN) ? EPOLLIN : 0)
+		   | ((events & POLLOUT) ? EPOLLOUT : 0);
+    event.data.fd = fd;
+    if (found == watched.end()
+	|| epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == -1) {
+					// new, or closed and opened again
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+	    ASSERT(errno == EPERM);
+	    Schedule(handler, arg, 1, type);
+	    return;
+	}
+	if (found == watched.end()) {
+	    found = watched.insert(std::make_pair(fd, new HostWatch)).first;
+	    found->second->armed = false;
+	}
+    }
+    HostWatch *watch = found->second;
+    DEBUG('i', "Watching host file %d for the %s\n", fd, intTypeNames[type]);
+    watch->events = events;
+    watch->handler = handler;
+    watch->arg = arg;
+    watch->type = type;
+    if (!watch->armed) {
+	watch->armed = true;
+	numArmed++;
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::UnwatchFd
+// 	Forget about the host file "fd"; it must be done before it is
+//	closed.
+//----------------------------------------------------------------------
+void
+Interrupt::UnwatchFd(int fd)
+{
+    std::map<int, HostWatch*>::iterator found = watched.find(fd);
+
+    if (found == watched.end())
+	return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+    if (found->second->armed)
+	numArmed--;
+    delete found->second;
+    watched.erase(found);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckHost
+// 	Check the host files being watched, and invoke the interrupt
+//	handlers of the ones that are ready.
+//
+//	If "idle", there is nothing in the ready queue: wait on the host
+//	until one of them is ready, or until the next pending interrupt
+//	is due, letting simulated time go by at IdleTicksPerMs.  This way,
+//	a packet or a key wakes Nachos up right away, and Nachos doesn't
+//	spin meanwhile.  If nothing can happen but a host file (the
+//	time-slice daemon doesn't count: it has nothing to preempt), wait
+//	for as long as it takes.  An interrupt due in less than a
+//	millisecond isn't waited for: the caller advances the clock to
+//	it, as ever.
+//
+// Returns:
+//	true, if we fired off any interrupt handlers
+//----------------------------------------------------------------------
+bool
+Interrupt::CheckHost(bool idle)
+{
+    struct epoll_event ready[MaxHostEvents];
+    struct timespec start, end;
+    int timeout = 0;			// milliseconds
+    int when = -1;			// when to be done waiting
+
+    ASSERT(level == IntOff);		// interrupts need to be disabled,
+					// to invoke an interrupt handler
+    if (numArmed == 0)
+	return false;
+    if (idle) {
+	PendingInterrupt *next = pending->SortedRemove(&when);
+	if (next != NULL) {
+	    if (timer != NULL && next->type == TimerInt && pending->IsEmpty())
+		when = -1;
+	    pending->SortedInsert(next, when);
+	}
+	if (when == -1)
+	    timeout = -1;
+	else if (when > stats->totalTicks)
+	    timeout = (when - stats->totalTicks) / IdleTicksPerMs;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+
+    // (epoll_wait, and not ppoll: glibc's ppoll needs a stack more
+    // aligned than a thread's may be)
+    int count = epoll_wait(epollFd, ready, MaxHostEvents, timeout);
+
+    if (timeout != 0) {			// advance the clock
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	long long ticks = ((long long) (end.tv_sec - start.tv_sec)
+			   * 1000000000 + end.tv_nsec - start.tv_nsec)
+			  * IdleTicksPerMs / 1000000;
+	if (when != -1 && stats->totalTicks + ticks > when)
+	    ticks = when - stats->totalTicks;
+	if (ticks > 0) {
+	    stats->idleTicks += ticks;
+	    stats->totalTicks += ticks;
+	}
+    }
+    lastHostCheck = stats->totalTicks;
+
+    bool fired = false;
+    for (int i = 0; i < count; i++) {
+	// look it up again: an earlier handler may have stopped watching it
+	std::map<int, HostWatch*>::iterator found =
+					watched.find(ready[i].data.fd);
+	if (found == watched.end() || !found->second->armed)
+	    continue;
+	HostWatch *watch = found->second;
+	watch->armed = false;
+	numArmed--;
+	DEBUG('i', "Invoking interrupt handler for the %s (host file %d) "
+	      "at time %d\n", intTypeNames[watch->type], ready[i].data.fd,
+	      stats->totalTicks);
+#ifdef USER_PROGRAM
+	if (machine != NULL)
+	    machine->DelayedLoad(0, 0);
+#endif
+	MachineStatus old = status;
+	inHandler = true;
+	status = SystemMode;
+	(*(watch->handler))(watch->arg);	// it may watch the file again
+	status = old;
+	inHandler = false;
+	fired = true;
+    }
+    return fired;
+}
+
 //----------------------------------------------------------------------
 // PrintPending
 // 	Print information about an interrupt that is scheduled to occur.
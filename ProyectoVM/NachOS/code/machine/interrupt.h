@@ -20,6 +20,17 @@
 //	simulated time advances (so that it becomes time to invoke an
 //	interrupt in the hardware simulation).
 //
+//	Devices that get their input from the host -- the console, the
+//	network, the sockets of user programs -- don't poll for it.  They
+//	ask to hear when a host file is ready (WatchFd), and the
+//	interrupt simulation checks all of those files at once, with
+//	epoll: every HostCheckTicks while there is something to run,
+//	and, when there isn't, waiting on the host until one is ready
+//	or the next interrupt is due.  Then it calls the device's handler,
+//	as if the device had interrupted the CPU.  While idle, waiting
+//	on the host, simulated time goes by at IdleTicksPerMs ticks per
+//	millisecond.
+//
 //	NOTE: this means that incorrectly synchronized code may work
 //	fine on this hardware simulation (even with randomized time slices),
 //	but it wouldn't work on real hardware.  (Just because we can't
@@ -35,6 +46,8 @@
 #ifndef INTERRUPT_H
 #define INTERRUPT_H
 
+#include <map>
+
 #include "copyright.h"
 #include "list.h"
 
@@ -48,9 +61,10 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network; the last one is for the host
+// files kernel threads wait for (cf. sysPoller.h).
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				NetworkSendInt, NetworkRecvInt};
+				NetworkSendInt, NetworkRecvInt, HostPollInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -69,6 +83,18 @@ class PendingInterrupt {
     IntType type;		// for debugging
 };
 
+// The following class defines a host file (a socket, a pipe, a terminal)
+// a device is waiting for.
+
+class HostWatch {
+  public:
+    int events;			// POLLIN and/or POLLOUT, as in poll(2)
+    VoidFunctionPtr handler;	// What to call once it is ready
+    void* arg;			// The argument to the function
+    IntType type;		// for debugging
+    bool armed;			// Still waiting; false once it was ready
+};
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -112,6 +138,12 @@ class Interrupt {
     
     void OneTick();       		// Advance simulated time
 
+    void WatchFd(int fd, int events, 	// Interrupt, calling "handler",
+	VoidFunctionPtr handler, void* arg,// once the host file "fd" is
+	IntType type);			// ready for "events"; just once,
+					// call again to hear of it again
+    void UnwatchFd(int fd);		// Stop watching "fd"
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
     List<PendingInterrupt*> *pending;	// the list of interrupts scheduled
@@ -125,6 +157,14 @@ class Interrupt {
 
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    bool CheckHost(bool idle);		// Call the handlers of the host
+					// files that are ready; if "idle",
+					// wait for one
+
+    int epollFd;			// the host files watched, for epoll
+    std::map<int, HostWatch*> watched;	// the same, by file
+    int numArmed;			// how many are still waited for
+    int lastHostCheck;			// when they were last checked
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
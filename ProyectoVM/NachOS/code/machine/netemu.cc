@@ -0,0 +1,288 @@
+// netemu.cc
+//	Routines to emulate the links between the machines on the
+//	network: latency, bandwidth, queueing, loss and reordering.
+//	See netemu.h for the link file.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "netemu.h"
+#include "system.h"
+
+#include <math.h>
+
+#define DefaultQueueSize 	1024	// bytes, when a line gives none
+
+//----------------------------------------------------------------------
+// LinkParameters::LinkParameters
+// 	Initialize the parameters of a perfect link, between any two
+//	machines.
+//----------------------------------------------------------------------
+
+LinkParameters::LinkParameters()
+{
+    from = to = -1;
+    latency = jitter = 0;
+    jitterKind = JitterUniform;
+    bandwidth = 0;
+    queueSize = DefaultQueueSize;
+    loss = burstEnter = burstLeave = reorder = 0;
+}
+
+//----------------------------------------------------------------------
+// Link::Link
+// 	Initialize a link with parameters "params", idle, and not in a
+//	burst of losses.
+//----------------------------------------------------------------------
+
+Link::Link(LinkParameters *linkParams)
+{
+    params = *linkParams;
+    busyUntil = 0;
+    inBurst = false;
+}
+
+//----------------------------------------------------------------------
+// BadLine
+// 	Complain about a line of the link file we can't make sense of.
+//----------------------------------------------------------------------
+
+static void
+BadLine(const char *linkFile, int line, const char *what)
+{
+    fprintf(stderr, "%s, line %d: %s\n", linkFile, line, what);
+    ASSERT(false);
+}
+
+//----------------------------------------------------------------------
+// ParseMachine
+// 	Return the machine ID "word" stands for, -1 for "*".
+//----------------------------------------------------------------------
+
+static int
+ParseMachine(const char *word)
+{
+    return strcmp(word, "*") ? atoi(word) : -1;
+}
+
+//----------------------------------------------------------------------
+// NetworkEmulator::NetworkEmulator
+// 	Read the link file, keeping the lines about links out of this
+//	machine.  The links themselves are set up as they are used.
+//
+//	"self" -- this machine's network address
+//	"linkFile" -- the UNIX file with the links
+//----------------------------------------------------------------------
+
+NetworkEmulator::NetworkEmulator(int self, const char *linkFile)
+{
+    char buffer[256];
+    int line = 0;
+    int fileSeed = 0;
+    FILE *fp = fopen(linkFile, "r");
+
+    if (fp == NULL)
+	BadLine(linkFile, 0, "can't open the file");
+    ident = self;
+    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
+	line++;
+	char *comment = strchr(buffer, '#');
+	if (comment != NULL)
+	    *comment = '\0';
+
+	std::vector<const char *> words;
+	for (char *word = strtok(buffer, " \t\n"); word != NULL;
+	     word = strtok(NULL, " \t\n"))
+	    words.push_back(word);
+	words.push_back(NULL);			// so we can look one ahead
+	unsigned n = words.size() - 1;
+
+	if (n == 0)
+	    continue;				// blank line
+	if (!strcmp(words[0], "seed")) {
+	    if (n != 2)
+		BadLine(linkFile, line, "expected \"seed <number>\"");
+	    fileSeed = atoi(words[1]);
+	    continue;
+	}
+	if (strcmp(words[0], "link") || n < 3)
+	    BadLine(linkFile, line, "expected \"link <from> <to> ...\"");
+
+	LinkParameters params;
+	params.from = ParseMachine(words[1]);
+	params.to = ParseMachine(words[2]);
+	for (unsigned w = 3; w < n; w += 2) {
+	    const char *word = words[w], *value = words[w + 1];
+	    if (value == NULL)
+		BadLine(linkFile, line, "parameter without a value");
+	    if (!strcmp(word, "latency"))
+		params.latency = atoi(value);
+	    else if (!strcmp(word, "jitter")) {
+		params.jitter = atoi(value);
+		const char *kind = words[w + 2];	// optional
+		if (kind != NULL && !strcmp(kind, "uniform"))
+		    params.jitterKind = JitterUniform;
+		else if (kind != NULL && !strcmp(kind, "normal"))
+		    params.jitterKind = JitterNormal;
+		else if (kind != NULL && !strcmp(kind, "exponential"))
+		    params.jitterKind = JitterExponential;
+		else
+		    continue;
+		w++;
+	    } else if (!strcmp(word, "bandwidth"))
+		params.bandwidth = atoi(value);
+	    else if (!strcmp(word, "queue"))
+		params.queueSize = atoi(value);
+	    else if (!strcmp(word, "loss"))
+		params.loss = atof(value);
+	    else if (!strcmp(word, "burst")) {
+		if (words[w + 2] == NULL)
+		    BadLine(linkFile, line, "burst takes two probabilities");
+		params.burstEnter = atof(value);
+		params.burstLeave = atof(words[w + 2]);
+		w++;
+	    } else if (!strcmp(word, "reorder"))
+		params.reorder = atof(value);
+	    else
+		BadLine(linkFile, line, "unknown parameter");
+	}
+	if (params.latency < 0 || params.jitter < 0 || params.bandwidth < 0
+	    || params.queueSize < 0)
+	    BadLine(linkFile, line, "negative time or size");
+
+	if (params.from == -1 || params.from == self)
+	    lines.push_back(params);
+    }
+    fclose(fp);
+
+    seed[0] = 0x330e;
+    seed[1] = (unsigned short) self;
+    seed[2] = (unsigned short) fileSeed;
+}
+
+//----------------------------------------------------------------------
+// NetworkEmulator::~NetworkEmulator
+// 	De-allocate the links.
+//----------------------------------------------------------------------
+
+NetworkEmulator::~NetworkEmulator()
+{
+    for (std::map<int, Link *>::iterator it = links.begin();
+	 it != links.end(); it++)
+	delete it->second;
+}
+
+//----------------------------------------------------------------------
+// NetworkEmulator::LinkTo
+// 	Return the link to machine "to", setting it up with the last line
+//	of the link file that matches it, if it is the first packet on it.
+//----------------------------------------------------------------------
+
+Link *
+NetworkEmulator::LinkTo(int to)
+{
+    std::map<int, Link *>::iterator found = links.find(to);
+    if (found != links.end())
+	return found->second;
+
+    LinkParameters perfect;
+    LinkParameters *params = &perfect;
+    for (unsigned i = 0; i < lines.size(); i++)
+	if (lines[i].to == -1 || lines[i].to == to)
+	    params = &lines[i];
+    Link *link = new Link(params);
+    links[to] = link;
+    return link;
+}
+
+//----------------------------------------------------------------------
+// NetworkEmulator::Uniform
+// 	Return a random number between 0 (included) and 1 (excluded).
+//----------------------------------------------------------------------
+
+double
+NetworkEmulator::Uniform()
+{
+    return erand48(seed);
+}
+
+//----------------------------------------------------------------------
+// NetworkEmulator::Jitter
+// 	Return the random part of the latency of a packet on a link with
+//	parameters "params".
+//----------------------------------------------------------------------
+
+int
+NetworkEmulator::Jitter(LinkParameters *params)
+{
+    if (params->jitter == 0)
+	return 0;
+
+    double u = 1 - Uniform();			// in (0, 1], for the log
+    switch (params->jitterKind) {
+      case JitterNormal:			// Box-Muller
+	return (int) fabs(sqrt(-2 * log(u)) * cos(2 * M_PI * Uniform())
+			  * params->jitter);
+      case JitterExponential:
+	return (int) (-log(u) * params->jitter);
+      default:
+	return (int) ((1 - u) * params->jitter);
+    }
+}
+
+//----------------------------------------------------------------------
+// NetworkEmulator::Transmit
+// 	Put a packet on the link to another machine.  It waits until the
+//	packets ahead of it are out on the link -- or is dropped, if there
+//	isn't room for it in the queue -- then takes its size over the
+//	bandwidth to go out, then the latency to get there.  On the way,
+//	it may be lost.
+//
+//	Return in how many ticks the packet gets to the other machine,
+//	or -1 if it never does.
+//
+//	"to" -- the other machine
+//	"bytes" -- size of the packet, headers and all
+//----------------------------------------------------------------------
+
+int
+NetworkEmulator::Transmit(int to, int bytes)
+{
+    Link *link = LinkTo(to);
+    LinkParameters *params = &link->params;
+    int now = stats->totalTicks;
+    int out = now;				// when it is all on the link
+
+    if (params->bandwidth > 0) {
+	if (link->busyUntil > now) {
+	    double backlog = (double) (link->busyUntil - now)
+				* params->bandwidth / 1000;
+	    if (backlog + bytes > params->queueSize) {
+		DEBUG('n', "queue to %d full, ", to);
+		return -1;
+	    }
+	    out = link->busyUntil;
+	}
+	out += divRoundUp(bytes * 1000, params->bandwidth);
+	link->busyUntil = out;
+    }
+
+    bool lost = link->inBurst || Uniform() < params->loss;
+    if (link->inBurst) {
+	if (Uniform() < params->burstLeave)
+	    link->inBurst = false;
+    } else if (Uniform() < params->burstEnter)
+	link->inBurst = true;
+    if (lost) {
+	DEBUG('n', "lost on the link to %d, ", to);
+	return -1;
+    }
+
+    if (params->reorder > 0 && Uniform() < params->reorder)
+	return out - now;			// overtakes the others
+    return out - now + params->latency + Jitter(params);
+}
@@ -0,0 +1,124 @@
+// netemu.h
+//	Data structures to emulate the links between the machines on the
+//	network.  By default, a packet that the network doesn't drop gets
+//	to the other machine right away.  With a link file, each packet
+//	a machine sends goes through a model of the link to its
+//	destination first:
+//
+//	  latency -- a fixed delay, plus a random one (the "jitter"),
+//		uniform, normal or exponential
+//	  bandwidth -- packets go out on the link one after the other,
+//		each taking its size over the bandwidth; the ones that
+//		find the link busy wait in a queue of limited size, and
+//		are dropped if it is full
+//	  loss -- a packet is lost with some probability, and the link
+//		goes into bursts in which every packet is lost (a
+//		Gilbert-Elliott model: it enters a burst after a packet
+//		with one probability, and leaves it with another)
+//	  reordering -- some packets skip the latency, and so overtake
+//		the ones sent before them (jitter reorders packets too)
+//
+//	The link file has one line per link; "#" starts a comment:
+//
+//	  link <from> <to> [latency <ticks>] [jitter <ticks> [uniform|
+//		normal|exponential]] [bandwidth <bytes per 1000 ticks>]
+//		[queue <bytes>] [loss <probability>] [burst <enter> <leave>]
+//		[reorder <probability>]
+//	  seed <number>
+//
+//	<from> and <to> are machine IDs, or "*" for any machine.  A packet
+//	goes through the last line that matches its link; what the line
+//	doesn't give is as on a perfect link.  For instance,
+//
+//	  link * * latency 2000 jitter 500 normal bandwidth 6400 queue 640
+//	  link 0 1 latency 200 loss 0.01 burst 0.002 0.2
+//
+//	Every machine reads the same file, and models the links out of
+//	it: a packet is held by the machine that sends it, and written to
+//	the socket of the other machine once it gets there.  Times are in
+//	ticks of the sender.
+//
+//	Delays and losses use their own random numbers, seeded with the
+//	machine ID (and the "seed" line), so that the links don't all
+//	lose the same packets, and the rest of Nachos sees the same
+//	random numbers with or without the emulation.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef NETEMU_H
+#define NETEMU_H
+
+#include <map>
+#include <vector>
+
+#include "copyright.h"
+#include "utility.h"
+
+// How the random part of the latency is distributed
+enum JitterKind { JitterUniform,	// between 0 and the jitter
+		  JitterNormal,		// |N(0, jitter)|
+		  JitterExponential };	// mean jitter
+
+// What a line of the link file says about the links it matches
+
+class LinkParameters {
+  public:
+    LinkParameters();		// A perfect link
+
+    int from, to;		// Machines; -1 for any
+    int latency;		// Fixed delay, in ticks
+    int jitter;			// Scale of the random delay
+    JitterKind jitterKind;
+    int bandwidth;		// Bytes per 1000 ticks; 0 for no limit
+    int queueSize;		// Bytes that can wait for the link
+    double loss;		// Chance to lose a packet
+    double burstEnter;		// Chance to start losing every packet
+    double burstLeave;		// Chance to stop again
+    double reorder;		// Chance for a packet to skip the latency
+};
+
+// The following class defines the link from this machine to another
+// one: its parameters, and its state.
+
+class Link {
+  public:
+    Link(LinkParameters *params);
+
+    LinkParameters params;
+    int busyUntil;		// When the last packet queued is out
+    bool inBurst;		// Losing every packet
+};
+
+// The following class defines the links from this machine to the
+// other ones, as read from a link file.
+
+class NetworkEmulator {
+  public:
+    NetworkEmulator(int self, const char *linkFile);
+				// Read the links out of machine "self"
+    ~NetworkEmulator();
+
+    int Transmit(int to, int bytes);
+				// Put a packet of "bytes" bytes on the link
+				// to machine "to"; return in how many
+				// ticks it gets there, or -1 if it is lost
+
+  private:
+    Link *LinkTo(int to);	// The link to "to", set up the first time
+    double Uniform();		// Random number in [0, 1)
+    int Jitter(LinkParameters *params);
+				// Random part of the latency
+
+    int ident;			// This machine
+    std::vector<LinkParameters> lines;
+				// Lines of the link file, in order
+    std::map<int, Link *> links;
+				// Links used so far, by destination
+    unsigned short seed[3];	// State of the random numbers
+};
+
+#endif // NETEMU_H
@@ -11,12 +11,23 @@
 #include "copyright.h"
 #include "system.h"
 
+#include <poll.h>
+
 // Dummy functions because C++ can't call member functions indirectly 
 static void NetworkReadPoll(void* arg)
 { Network *net = (Network *)arg; net->CheckPktAvail(); }
 static void NetworkSendDone(void* arg)
 { Network *net = (Network *)arg; net->SendDone(); }
 
+// A packet held by an emulated link until it gets to the other machine
+struct HeldPacket {
+    Network *network;
+    char wire[MaxWireSize];
+};
+
+static void NetworkDeliver(void* arg)
+{ HeldPacket *p = (HeldPacket *)arg; p->network->Deliver(p->wire); delete p; }
+
 // Initialize the network emulation
 //   addr is used to generate the socket name
 //   reliability says whether we drop packets to emulate unreliable links
@@ -35,35 +46,47 @@ Network::Network(NetworkAddress addr, double reliability,
     handlerArg = callArg;
     sendBusy = false;
     inHdr.length = 0;
+    links = NULL;
     
     sock = OpenSocket();
     sprintf(sockName, "SOCKET_%d", (int)addr);
     AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
 						 // in the current directory.
 
-    // start polling for incoming packets
-    interrupt->Schedule(NetworkReadPoll, this, NetworkTime, NetworkRecvInt);
+    // wait for the first incoming packet
+    interrupt->WatchFd(sock, POLLIN, NetworkReadPoll, this, NetworkRecvInt);
 }
 
 Network::~Network()
 {
+    interrupt->UnwatchFd(sock);
     CloseSocket(sock);
     DeAssignNameToSocket(sockName);
+    delete links;
 }
 
-// if a packet is already buffered, we simply delay reading 
-// the incoming packet.  In real life, the incoming 
+// from now on, packets go through the links described in "linkFile"
+void
+Network::EmulateLinks(const char *linkFile)
+{
+    delete links;
+    links = new NetworkEmulator(ident, linkFile);
+}
+
+// called when the socket has an incoming packet.  We only wait for
+// one when no packet is buffered: until the last one is pulled off,
+// we simply delay reading the next.  In real life, the incoming 
 // packet might be dropped if we can't read it in time.
 void
 Network::CheckPktAvail()
 {
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(NetworkReadPoll, this, NetworkTime, NetworkRecvInt);
-
-    if (inHdr.length != 0) 	// do nothing if packet is already buffered
+    if (inHdr.length != 0) 	// Receive will wait for the next one
 	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
+    if (!PollSocket(sock)) {	// no packet to be read after all
+	interrupt->WatchFd(sock, POLLIN, NetworkReadPoll, this,
+			   NetworkRecvInt);
 	return;
+    }
 
     // otherwise, read packet in
     char *buffer = new char[MaxWireSize];
@@ -112,15 +135,43 @@ Network::Send(PacketHeader hdr, const char* data)
 
     if (Random() % 100 >= chanceToWork * 100) { // emulate a lost packet
 	DEBUG('n', "oops, lost it! (chanceToWork: %f)\n", chanceToWork );
+	stats->numPacketsLost++;
 	return;
     }
 
-    // concatenate hdr and data into a single buffer, and send it out
-    char *buffer = new char[MaxWireSize];
-    *(PacketHeader *)buffer = hdr;
-    bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
-    SendToSocket(sock, buffer, MaxWireSize, toName);
-    delete []buffer;
+    // on an emulated link, the packet may be lost, or take a while
+    int delay = 0;
+    if (links != NULL) {
+	delay = links->Transmit(hdr.to, sizeof(PacketHeader) + hdr.length);
+	if (delay < 0) {
+	    DEBUG('n', "dropped by the link\n");
+	    stats->numPacketsLost++;
+	    return;
+	}
+    }
+
+    // concatenate hdr and data into a single buffer, and send it out,
+    // or hold on to it until it gets there
+    HeldPacket *packet = new HeldPacket;
+    packet->network = this;
+    *(PacketHeader *)packet->wire = hdr;
+    bcopy(data, packet->wire + sizeof(PacketHeader), hdr.length);
+    if (delay > 0) {
+	interrupt->Schedule(NetworkDeliver, packet, delay, NetworkSendInt);
+	return;
+    }
+    SendToSocket(sock, packet->wire, MaxWireSize, toName);
+    delete packet;
+}
+
+// a packet held by an emulated link gets to the other machine
+void
+Network::Deliver(char *wire)
+{
+    char toName[32];
+
+    sprintf(toName, "SOCKET_%d", (int)((PacketHeader *)wire)->to);
+    SendToSocket(sock, wire, MaxWireSize, toName);
 }
 
 // read a packet, if one is buffered
@@ -130,7 +181,10 @@ Network::Receive(char* data)
     PacketHeader hdr = inHdr;
 
     inHdr.length = 0;
-    if (hdr.length != 0)
+    if (hdr.length != 0) {
     	bcopy(inbox, data, hdr.length);
+	interrupt->WatchFd(sock, POLLIN, NetworkReadPoll, this,
+			   NetworkRecvInt);	// room for the next one
+    }
     return hdr;
 }
@@ -2,6 +2,9 @@
 //	Data structures to emulate a physical network connection.
 //	The network provides the abstraction of ordered, unreliable,
 //	fixed-size packet delivery to other machines on the network.
+//	The links between the machines can be given latency, bandwidth,
+//	burst losses and reordering, cf. netemu.h; then packets may also
+//	arrive out of order.
 //
 //	You may note that the interface to the network is similar to 
 //	the console device -- both are full duplex channels.
@@ -17,6 +20,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "netemu.h"
 
 // Network address -- uniquely identifies a machine.  This machine's ID 
 //  is given on the command line.
@@ -76,9 +80,16 @@ class Network {
 				// If no packet is waiting, return a header 
 				// with length 0.
 
+    void EmulateLinks(const char *linkFile);
+    				// Send packets through the links described
+				// in "linkFile", instead of right away
+
     void SendDone();		// Interrupt handler, called when message is 
 				// sent
     void CheckPktAvail();	// Check if there is an incoming packet
+    void Deliver(char *wire);	// Interrupt handler, called when a packet
+				// held by the emulated link gets to the
+				// other machine
 
   private:
     NetworkAddress ident;	// This machine's network address
@@ -96,6 +107,7 @@ class Network {
 				//   network
     PacketHeader inHdr;		// Information about arrived packet
     char inbox[MaxPacketSize];  // Data for arrived packet
+    NetworkEmulator *links;	// Emulated links, or NULL
 };
 
 #endif // NETWORK_H
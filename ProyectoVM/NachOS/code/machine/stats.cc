@@ -3,6 +3,11 @@
 //
 // DO NOT CHANGE -- these stats are maintained by the machine emulation.
 //
+// That still holds for the global counters.  Besides them, Statistics
+// keeps log-bucketed histograms of scheduling and system call latency,
+// and the accounting of every thread, which can be dumped as JSON at
+// exit (-stats <file>).  Those are the kernel's, and change with it.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -36,9 +41,216 @@ Statistics::Print()
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    if (numTrackBufferHits > 0)
+	printf("Track buffer: hits %d, latency saved %d ticks\n",
+	    numTrackBufferHits, trackBufferTicksSaved);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
     printf("Paging: faults %d\n", numPageFaults);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+    if (numPacketsLost > 0)
+	printf("Network losses: packets dropped %d\n", numPacketsLost);
+    if (numRetransmits > 0)
+	printf("Reliable channels: retransmissions %d\n", numRetransmits);
+    if (readyWait.Count() > 0)
+	readyWait.Print("Ready queue wait");
+    if (syscallLatency.Count() > 0)
+	syscallLatency.Print("Syscall latency");
+}
+
+//----------------------------------------------------------------------
+// Statistics::TrackThread
+// 	Watch the accounting of a thread that was just created, so that
+//	it shows up in the dump even if the thread is still alive (ready
+//	or blocked) when Nachos halts.
+//----------------------------------------------------------------------
+
+void
+Statistics::TrackThread(const char* name, const ThreadStats* threadStats)
+{
+    liveThreads.push_back({name, threadStats});
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordThread
+// 	Keep the accounting of a thread, usually because it is being
+//	destroyed, so that it shows up in the dump at exit.  The thread
+//	is no longer watched.
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordThread(const char* name, const ThreadStats& threadStats)
+{
+    threads.push_back({name != NULL ? name : "", threadStats});
+    for (size_t i = 0; i < liveThreads.size(); i++) {
+	if (liveThreads[i].threadStats == &threadStats) {
+	    liveThreads[i] = liveThreads.back();
+	    liveThreads.pop_back();
+	    break;
+	}
+    }
+}
+
+// Write "str" as a JSON string literal
+static void
+DumpString(FILE* out, const std::string& str)
+{
+    fputc('"', out);
+    for (char c : str) {
+	if (c == '"' || c == '\\')
+	    fputc('\\', out);
+	if ((unsigned char) c >= ' ')
+	    fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+// Write the accounting of a thread as a JSON object
+static void
+DumpThread(FILE* out, const std::string& name, const ThreadStats& t,
+	bool live)
+{
+    fprintf(out, "\n    {\"name\": ");
+    DumpString(out, name);
+    fprintf(out, ", \"live\": %s, \"userTicks\": %d, \"systemTicks\": %d, "
+	"\"pageFaults\": %d, \"syscalls\": %d, "
+	"\"voluntarySwitches\": %d, \"involuntarySwitches\": %d, "
+	"\"readyTicks\": %d}", live ? "true" : "false", t.userTicks,
+	t.systemTicks, t.pageFaults, t.syscalls, t.voluntarySwitches,
+	t.involuntarySwitches, t.readyTicks);
+}
+
+//----------------------------------------------------------------------
+// Statistics::Dump
+// 	Write the counters, the histograms and the per-thread accounting
+//	as JSON, so that runs can be compared by a script.  Does nothing
+//	unless a file name was given with -stats.
+//
+//	The threads still alive come last, marked "live"; that includes
+//	the current thread, and the ready and blocked ones.
+//----------------------------------------------------------------------
+
+void
+Statistics::Dump()
+{
+    if (dumpFileName == NULL)
+	return;
+    FILE* out = fopen(dumpFileName, "w");
+    if (out == NULL) {
+	fprintf(stderr, "Cannot write statistics to %s\n", dumpFileName);
+	return;
+    }
+
+    fprintf(out, "{\n  \"ticks\": {\"total\": %d, \"idle\": %d, "
+	"\"system\": %d, \"user\": %d},\n", totalTicks, idleTicks,
+	systemTicks, userTicks);
+    fprintf(out, "  \"disk\": {\"reads\": %d, \"writes\": %d, "
+	"\"trackBufferHits\": %d, \"trackBufferTicksSaved\": %d},\n",
+	numDiskReads, numDiskWrites, numTrackBufferHits,
+	trackBufferTicksSaved);
+    fprintf(out, "  \"console\": {\"reads\": %d, \"writes\": %d},\n",
+	numConsoleCharsRead, numConsoleCharsWritten);
+    fprintf(out, "  \"pageFaults\": %d,\n", numPageFaults);
+    fprintf(out, "  \"network\": {\"received\": %d, \"sent\": %d, "
+	"\"lost\": %d, \"retransmits\": %d},\n", numPacketsRecvd,
+	numPacketsSent, numPacketsLost, numRetransmits);
+    fprintf(out, "  \"readyWait\": ");
+    readyWait.DumpJSON(out);
+    fprintf(out, ",\n  \"syscallLatency\": ");
+    syscallLatency.DumpJSON(out);
+    fprintf(out, ",\n  \"threads\": [");
+    for (size_t i = 0; i < threads.size(); i++) {
+	if (i > 0)
+	    fputc(',', out);
+	DumpThread(out, threads[i].name, threads[i].threadStats, false);
+    }
+    for (size_t i = 0; i < liveThreads.size(); i++) {
+	if (i > 0 || !threads.empty())
+	    fputc(',', out);
+	DumpThread(out, liveThreads[i].name != NULL ? liveThreads[i].name : "",
+	    *liveThreads[i].threadStats, true);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+}
+
+//----------------------------------------------------------------------
+// LogHistogram::Add
+// 	Record one sample.  Negative values count as zero.
+//----------------------------------------------------------------------
+
+void
+LogHistogram::Add(int value)
+{
+    int bucket = 0;
+
+    if (value < 0)
+	value = 0;
+    for (unsigned v = value; v != 0 && bucket < NUM_BUCKETS - 1; v >>= 1)
+	bucket++;
+    buckets[bucket]++;
+    count++;
+    sum += value;
+    if (value > max)
+	max = value;
+}
+
+//----------------------------------------------------------------------
+// LogHistogram::Percentile
+// 	Return the upper bound of the bucket where the given fraction of
+//	the samples (0.5 for the median) has been reached.  Buckets are a
+//	power of two wide, so this is exact to within a factor of two.
+//----------------------------------------------------------------------
+
+int
+LogHistogram::Percentile(double fraction) const
+{
+    long long wanted = (long long) (fraction * count + 0.5);
+    long long seen = 0;
+
+    if (wanted < 1)
+	wanted = 1;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+	seen += buckets[i];
+	if (seen >= wanted) {
+	    int bound = i == 0 ? 0 : (1 << i) - 1;
+	    return bound < max ? bound : max;
+	}
+    }
+    return max;
+}
+
+//----------------------------------------------------------------------
+// LogHistogram::Print
+// 	Print a one line summary of the histogram.
+//----------------------------------------------------------------------
+
+void
+LogHistogram::Print(const char* title) const
+{
+    printf("%s: samples %d, mean %lld, p50 <= %d, p90 <= %d, p99 <= %d, "
+	"max %d ticks\n", title, count, count > 0 ? sum / count : 0,
+	Percentile(0.5), Percentile(0.9), Percentile(0.99), max);
+}
+
+//----------------------------------------------------------------------
+// LogHistogram::DumpJSON
+// 	Write the histogram as a JSON object.  "buckets" holds the counts
+//	of the buckets up to the last non empty one.
+//----------------------------------------------------------------------
+
+void
+LogHistogram::DumpJSON(FILE* out) const
+{
+    int last = NUM_BUCKETS - 1;
+
+    while (last > 0 && buckets[last] == 0)
+	last--;
+    fprintf(out, "{\"count\": %d, \"sum\": %lld, \"max\": %d, "
+	"\"p50\": %d, \"p99\": %d, \"buckets\": [", count, sum, max,
+	Percentile(0.5), Percentile(0.99));
+    for (int i = 0; i <= last; i++)
+	fprintf(out, "%s%d", i == 0 ? "" : ", ", buckets[i]);
+    fprintf(out, "]}");
 }
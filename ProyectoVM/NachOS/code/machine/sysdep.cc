@@ -28,6 +28,7 @@
 extern "C" {
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -182,6 +183,56 @@ Lseek(int fd, int offset, int whence)
     ASSERT(retVal >= 0);
 }
 
+//----------------------------------------------------------------------
+// ReadAt/WriteAt
+// 	Read or write characters at "offset" in an open file, without
+//	moving the file position.  One system call, instead of an Lseek
+//	and a Read/WriteFile.  Abort on error.
+//----------------------------------------------------------------------
+
+void
+ReadAt(int fd, char *buffer, int nBytes, int offset)
+{
+    int retVal = pread(fd, buffer, nBytes, offset);
+    ASSERT(retVal == nBytes);
+}
+
+void
+WriteAt(int fd, const char *buffer, int nBytes, int offset)
+{
+    int retVal = pwrite(fd, buffer, nBytes, offset);
+    ASSERT(retVal == nBytes);
+}
+
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "length" bytes of an open file into memory, shared,
+//	so that stores into the memory change the file.  Return NULL if
+//	the file can't be mapped (the caller can fall back on ReadAt and
+//	WriteAt).
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int length)
+{
+    char *ptr = (char *) mmap(NULL, length, PROT_READ | PROT_WRITE,
+			      MAP_SHARED, fd, 0);
+
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Write back, and unmap, memory mapped by MapFile.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *ptr, int length)
+{
+    msync(ptr, length, MS_SYNC);
+    munmap(ptr, length);
+}
+
 //----------------------------------------------------------------------
 // Tell
 // 	Report the current location within an open file.
@@ -330,7 +381,11 @@ ReadFromSocket(int sockID, char *buffer, int packetSize)
 //----------------------------------------------------------------------
 // SendToSocket
 // 	Transmit a fixed size packet to another Nachos' IPC port.
-//	Abort on error.
+//	If there is no Nachos on the other end (it hasn't started, or
+//	has already halted), or if its queue of incoming packets is full,
+//	the packet is lost, as on a real network.  (Waiting for room
+//	instead could deadlock two Nachos sending to each other.)
+//	Abort on any other error.
 //----------------------------------------------------------------------
 void
 SendToSocket(int sockID, const char *buffer, int packetSize, const char *toName)
@@ -340,13 +395,16 @@ SendToSocket(int sockID, const char *buffer, int packetSize, const char *toName)
 
     InitSocketName(&uName, toName);
 #ifdef HOST_LINUX
-    retVal = sendto(sockID, buffer, packetSize, 0,
+    retVal = sendto(sockID, buffer, packetSize, MSG_DONTWAIT,
 			  (const struct sockaddr *) &uName, sizeof(uName));
 #else
-    retVal = sendto(sockID, buffer, packetSize, 0,
+    retVal = sendto(sockID, buffer, packetSize, MSG_DONTWAIT,
 			  (char *) &uName, sizeof(uName));
 #endif
 
+    if (retVal < 0 && (errno == ENOENT || errno == ECONNREFUSED
+		       || errno == EAGAIN || errno == EWOULDBLOCK))
+	return;
     ASSERT(retVal == packetSize);
 }
 
@@ -466,3 +524,93 @@ DeallocBoundedArray(const char *ptr, int size)
 #endif
     delete [] (ptr - pgSize);
 }
+
+//----------------------------------------------------------------------
+// AllocGuardedStack
+// 	Return a stack of at least "size" bytes, page aligned, with the page
+//	just below it mapped with no access rights.  Unlike AllocBoundedArray
+//	this also works on Linux, since the memory comes from mmap.
+//
+//	"size" -- amount of useful space needed (in bytes)
+//----------------------------------------------------------------------
+
+static int
+GuardedLength(int size)
+{
+    int pgSize = getpagesize();
+    return divRoundUp(size, pgSize) * pgSize + pgSize;
+}
+
+char *
+AllocGuardedStack(int size)
+{
+    int pgSize = getpagesize();
+    char *ptr = (char *) mmap(NULL, GuardedLength(size),
+			      PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    ASSERT(ptr != MAP_FAILED);
+    mprotect(ptr, pgSize, PROT_NONE);	// stacks grow down
+    return ptr + pgSize;
+}
+
+//----------------------------------------------------------------------
+// DeallocGuardedStack
+// 	Give back a stack allocated by AllocGuardedStack, guard included.
+//----------------------------------------------------------------------
+
+void
+DeallocGuardedStack(char *ptr, int size)
+{
+    munmap(ptr - getpagesize(), GuardedLength(size));
+}
+
+//----------------------------------------------------------------------
+// InGuardPage
+// 	Return true if "address" falls in the guard page of "stack".
+//----------------------------------------------------------------------
+
+bool
+InGuardPage(const char *stack, const char *address)
+{
+    return stack != NULL && address >= stack - getpagesize()
+	&& address < stack;
+}
+
+//----------------------------------------------------------------------
+// CallOnSegmentationFault
+// 	Arrange that "func" will be called with the faulting address when
+//	Nachos takes a segmentation fault.  The handler runs on its own
+//	stack (the thread stack may be the one that overflowed), and the
+//	default action is restored, so returning from it dumps core.
+//----------------------------------------------------------------------
+
+static void (*segmentationFaultHandler)(const char *address);
+
+static void
+SegmentationFault(int sig, siginfo_t *info, void *context)
+{
+    (*segmentationFaultHandler)((const char *) info->si_addr);
+}
+
+void
+CallOnSegmentationFault(void (*func)(const char *address))
+{
+    static char *signalStack = NULL;
+    stack_t altStack;
+    struct sigaction action;
+
+    if (signalStack == NULL) {
+	signalStack = new char[SIGSTKSZ];
+	altStack.ss_sp = signalStack;
+	altStack.ss_size = SIGSTKSZ;
+	altStack.ss_flags = 0;
+	sigaltstack(&altStack, NULL);
+    }
+    segmentationFaultHandler = func;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = SegmentationFault;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, NULL);
+}
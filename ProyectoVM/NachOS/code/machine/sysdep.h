@@ -25,10 +25,16 @@ extern void Read(int fd, char *buffer, int nBytes);
 extern int ReadPartial(int fd, char *buffer, int nBytes);
 extern void WriteFile(int fd, const char *buffer, int nBytes);
 extern void Lseek(int fd, int offset, int whence);
+extern void ReadAt(int fd, char *buffer, int nBytes, int offset);
+extern void WriteAt(int fd, const char *buffer, int nBytes, int offset);
 extern int Tell(int fd);
 extern void Close(int fd);
 extern bool Unlink(const char *name);
 
+// Map an open file into memory, shared, and unmap it; for the disk
+extern char *MapFile(int fd, int length);
+extern void UnmapFile(char *ptr, int length);
+
 // Interprocess communication operations, for simulating the network
 extern int OpenSocket();
 extern void CloseSocket(int sockID);
@@ -55,6 +61,15 @@ extern int Random();
 extern char *AllocBoundedArray(int size);
 extern void DeallocBoundedArray(const char *p, int size);
 
+// Allocate, de-allocate a downward growing stack whose lowest page is
+// unmapped, so running off its end faults right away.  "func" is called
+// with the faulting address on a segmentation fault, on a separate
+// signal stack, so that it can tell whether a guard page was hit.
+extern char *AllocGuardedStack(int size);
+extern void DeallocGuardedStack(char *p, int size);
+extern bool InGuardPage(const char *stack, const char *address);
+extern void CallOnSegmentationFault(void (*func)(const char *address));
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
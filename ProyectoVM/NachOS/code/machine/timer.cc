@@ -5,7 +5,8 @@
 //      This means it can be used for implementing time-slicing.
 //
 //      We emulate a hardware timer by scheduling an interrupt to occur
-//      every time stats->totalTicks has increased by TimerTicks.
+//      every time stats->totalTicks has increased by TimerTicks (or by
+//      the time slice given to the constructor).
 //
 //      In order to introduce some randomness into time-slicing, if "doRandom"
 //      is set, then the interrupt is comes after a random number of ticks.
@@ -39,11 +40,15 @@ static void TimerHandler(void* arg)
 //      "callArg" is the parameter to be passed to the interrupt handler.
 //      "doRandom" -- if true, arrange for the interrupts to occur
 //		at random, instead of fixed, intervals.
+//      "timeSlice" -- ticks between interrupts (on average, if random).
 //----------------------------------------------------------------------
 
-Timer::Timer(VoidFunctionPtr timerHandler, void* callArg, bool doRandom)
+Timer::Timer(VoidFunctionPtr timerHandler, void* callArg, bool doRandom,
+	     int timeSlice)
 {
+    ASSERT(timeSlice > 0);
     randomize = doRandom;
+    period = timeSlice;
     handler = timerHandler;
     arg = callArg; 
 
@@ -79,7 +84,7 @@ int
 Timer::TimeOfNextInterrupt() 
 {
     if (randomize)
-	return 1 + (Random() % (TimerTicks * 2));
+	return 1 + (Random() % (period * 2));
     else
-	return TimerTicks; 
+	return period; 
 }
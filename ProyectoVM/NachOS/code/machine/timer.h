@@ -21,12 +21,14 @@
 #define TIMER_H
 
 #include "copyright.h"
+#include "stats.h"
 #include "utility.h"
 
 // The following class defines a hardware timer. 
 class Timer {
   public:
-    Timer(VoidFunctionPtr timerHandler, void* callArg, bool doRandom);
+    Timer(VoidFunctionPtr timerHandler, void* callArg, bool doRandom,
+	  int timeSlice = TimerTicks);
 				// Initialize the timer, to call the interrupt
 				// handler "timerHandler" every time slice.
     ~Timer() {}
@@ -41,6 +43,7 @@ class Timer {
 
   private:
     bool randomize;		// set if we need to use a random timeout delay
+    int period;			// (average) ticks between interrupts
     VoidFunctionPtr handler;	// timer interrupt handler 
     void* arg;			// argument to pass to interrupt handler
 
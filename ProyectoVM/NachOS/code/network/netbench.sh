@@ -0,0 +1,78 @@
+#!/bin/sh
+# netbench.sh
+#	Benchmark the post office over an emulated network: start several
+#	copies of Nachos on this host, with machine ID's 0 to <machines> - 1,
+#	each one sending <count> messages to every other one over reliable
+#	channels (nachos -mt), and add up what they print.
+#
+#	Usage: ./netbench.sh [-n <machines>] [-c <count>] [-e <link file>]
+#			[-w <window>] [-l <reliability>] [-t <seconds>]
+#
+#	e.g.	./netbench.sh -n 4 -c 100 -e wan.links
+#
+#	Run it in the network directory, once nachos is built.  What each
+#	machine printed is left in netbench.<id>.log.  The link file is
+#	described in ../machine/netemu.h; without one, the links are
+#	perfect, but for the -l reliability.
+
+machines=3
+count=100
+links=
+window=
+reliability=1
+seconds=300
+
+while getopts n:c:e:w:l:t: opt; do
+    case $opt in
+	n) machines=$OPTARG ;;
+	c) count=$OPTARG ;;
+	e) links="-ne $OPTARG" ;;
+	w) window="-nw $OPTARG" ;;
+	l) reliability=$OPTARG ;;
+	t) seconds=$OPTARG ;;
+	*) sed -n '8,9s/^#//p' "$0" >&2; exit 2 ;;
+    esac
+done
+
+cd "$(dirname "$0")" || exit 1
+rm -f SOCKET_*
+
+id=0
+while [ $id -lt "$machines" ]; do
+    timeout "$seconds" ./nachos -m $id -l "$reliability" $window $links \
+	-mt "$machines" "$count" > netbench.$id.log 2>&1 &
+    id=$((id + 1))
+done
+wait
+rm -f SOCKET_*
+
+id=0
+status=0
+while [ $id -lt "$machines" ]; do
+    if ! grep -q '^Received' netbench.$id.log; then
+	echo "machine $id: no result, see netbench.$id.log"
+	status=1
+    fi
+    id=$((id + 1))
+done
+
+# "Received <n> messages from <m> machines, <w> wrong, in <t> ticks"
+# "Goodput: ...; <n> messages sent in <p> packets (<u>% useful)"
+awk '
+/^Received/ { id = FILENAME; sub(/^netbench\./, "", id); sub(/\.log$/, "", id)
+	      got += $2; wrong += $7; ticks[id] = $10
+	      if (id + 0 > last) last = id + 0
+	      if ($10 > slowest) slowest = $10 }
+/^Goodput/  { for (i = 1; i <= NF; i++) {
+		  if ($i == "sent") sent += $(i - 2)
+		  if ($i == "packets") packets += $(i - 1) } }
+END {
+	for (id = 0; id <= last; id++)
+	    if (id in ticks)
+		printf("machine %d: all in after %d ticks\n", id, ticks[id])
+	if (packets > 0)
+	    printf("total: %d messages received, %d wrong; slowest %d ticks; "\
+		   "%d messages sent in %d packets (%d%% useful)\n",
+		   got, wrong, slowest, sent, packets, sent * 100 / packets)
+}' netbench.*.log
+exit $status
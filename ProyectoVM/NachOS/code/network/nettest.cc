@@ -1,6 +1,10 @@
 // nettest.cc 
 //	Test out message delivery between two "Nachos" machines,
-//	using the Post Office to coordinate delivery.
+//	using the Post Office to coordinate delivery: one message each
+//	way with MailTest, a stream of messages each way over a
+//	reliable channel with ReliableTest, messages bigger than a
+//	packet with BulkTest, and streams between every two of several
+//	machines with MeshTest (cf. netbench.sh).
 //
 //	Two caveats:
 //	  1. Two copies of Nachos must be running, with machine ID's 0 and 1:
@@ -70,3 +74,260 @@ MailTest(int farAddr)
     // Then we're done!
     interrupt->Halt();
 }
+
+// Test out the reliable channels, by doing the following:
+//	1. fork a thread to receive "count" messages from the machine with
+//	   ID "farAddr", in our mailbox #0, checking that each one arrives
+//	   once, intact, and in order
+//	2. meanwhile, send "count" messages to its mailbox #0
+//	3. wait until ours are all acknowledged, and print how fast the
+//	   other machine's got here
+//
+// Run with a lossy network, e.g.
+//	./nachos -m 0 -l 0.5 -ro 1 200 &
+//	./nachos -m 1 -l 0.5 -ro 0 200 &
+
+static int farMachine;			// the other machine
+static int messages;			// how many each one sends
+static int misdelivered;		// messages not as expected
+static int lastArrival;			// when the last message arrived
+static Semaphore *allReceived;		// V'ed when they are all in
+
+// The "i"th message machine "from" sends
+static void
+FillMessage(char *data, int i, int from)
+{
+    for (unsigned j = 0; j < MaxSegmentSize; j++)
+	data[j] = (char) (i * 7 + j + from);
+    snprintf(data, MaxSegmentSize, "Message %d from %d", i, from);
+}
+
+static void
+ReliableReceiver(void *arg)
+{
+    PacketHeader inPktHdr;
+    MailHeader inMailHdr;
+    char buffer[MaxMailSize];
+    char expected[MaxSegmentSize];
+
+    for (int i = 0; i < messages; i++) {
+	postOffice->Receive(0, &inPktHdr, &inMailHdr, buffer);
+	FillMessage(expected, i, farMachine);
+	if (inPktHdr.from != farMachine || inMailHdr.length != MaxSegmentSize
+	    || memcmp(buffer, expected, MaxSegmentSize) != 0) {
+	    printf("Message %d: got \"%s\" instead\n", i, buffer);
+	    misdelivered++;
+	}
+    }
+    lastArrival = stats->totalTicks;
+    allReceived->V();
+}
+
+void
+ReliableTest(int farAddr, int count)
+{
+    PacketHeader outPktHdr;
+    MailHeader outMailHdr;
+    char data[MaxSegmentSize];
+    int start = stats->totalTicks;
+
+    farMachine = farAddr;
+    messages = count;
+    allReceived = new Semaphore("all received", 0);
+    Thread *t = new Thread("reliable receiver");
+    t->Fork(ReliableReceiver, NULL);
+
+    outPktHdr.to = farAddr;
+    outMailHdr.to = 0;
+    outMailHdr.from = 0;
+    outMailHdr.length = MaxSegmentSize;
+    for (int i = 0; i < count; i++) {
+	FillMessage(data, i, postOffice->Address());
+	if (!postOffice->SendReliable(outPktHdr, outMailHdr, data)) {
+	    printf("Machine %d stopped answering\n", farAddr);
+	    break;
+	}
+    }
+
+    allReceived->P();
+    postOffice->Drain();
+
+    // goodput: what got here, per tick, and per packet we had to send
+    int ticks = lastArrival - start;
+    int transmissions = count + stats->numRetransmits;
+    printf("Received %d messages from %d, %d wrong, in %d ticks\n",
+	   count, farAddr, misdelivered, ticks);
+    printf("Goodput: %.2f bytes per 1000 ticks; %d messages sent in %d "
+	   "packets (%d%% useful)\n",
+	   (double) count * MaxSegmentSize * 1000 / (ticks > 0 ? ticks : 1),
+	   count, transmissions, count * 100 / transmissions);
+    fflush(stdout);
+    delete allReceived;
+    interrupt->Halt();
+}
+
+// Test out messages bigger than a packet, by doing the following:
+//	1. send a message of "size" bytes to the machine with ID "farAddr",
+//	   at mail box #1, with Send, and another one at mail box #0 over
+//	   a reliable channel
+//	2. wait for the other machine's reliable message, and check it
+//	3. check the other one too, if it made it (one lost fragment, and
+//	   it didn't)
+//
+// Run with a lossy network, e.g.
+//	./nachos -m 0 -l 0.9 -bo 1 10000 &
+//	./nachos -m 1 -l 0.9 -bo 0 10000 &
+
+// The message machine "from" sends
+static void
+FillBulk(char *data, int size, int from)
+{
+    for (int i = 0; i < size; i++)
+	data[i] = (char) (i / 3 + i % 251 + from);
+}
+
+// Check the message in "buffer" against what "from" sent
+static bool
+CheckBulk(const char *buffer, MailHeader *mailHdr, int size, int from)
+{
+    char *expected = new char[size];
+    FillBulk(expected, size, from);
+    bool good = (int) mailHdr->length == size
+		&& memcmp(buffer, expected, size) == 0;
+    delete [] expected;
+    return good;
+}
+
+void
+BulkTest(int farAddr, int size)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char *data = new char[MaxMessageSize];
+    char *buffer = new char[MaxMessageSize];
+    int start = stats->totalTicks;
+
+    ASSERT(size >= 0 && size <= (int) MaxMessageSize);
+    FillBulk(data, size, postOffice->Address());
+    outPktHdr.to = farAddr;
+    outMailHdr.from = 0;
+    outMailHdr.length = size;
+    outMailHdr.to = 1;
+    postOffice->Send(outPktHdr, outMailHdr, data);
+    outMailHdr.to = 0;
+    if (!postOffice->SendReliable(outPktHdr, outMailHdr, data))
+	printf("Machine %d stopped answering\n", farAddr);
+
+    postOffice->Receive(0, &inPktHdr, &inMailHdr, buffer);
+    printf("Reliable message of %d bytes from %d: %s, in %d ticks\n",
+	   inMailHdr.length, inPktHdr.from,
+	   CheckBulk(buffer, &inMailHdr, size, farAddr) ? "intact" : "WRONG",
+	   stats->totalTicks - start);
+    if (postOffice->HasMail(1)) {
+	postOffice->Receive(1, &inPktHdr, &inMailHdr, buffer);
+	printf("Plain message of %d bytes from %d: %s\n", inMailHdr.length,
+	       inPktHdr.from, CheckBulk(buffer, &inMailHdr, size, farAddr)
+	       ? "intact" : "WRONG");
+    } else
+	printf("Plain message from %d: lost\n", farAddr);
+    fflush(stdout);
+
+    postOffice->Drain();
+    delete [] data;
+    delete [] buffer;
+    interrupt->Halt();
+}
+
+// Test out the reliable channels between several machines, by doing the
+// following on each one:
+//	1. fork a thread to receive "count" messages from each of the other
+//	   machines, in our mailbox #0, checking that the ones from each
+//	   machine arrive once, intact, and in order
+//	2. meanwhile, send "count" messages to mailbox #0 of every other
+//	   machine, taking turns
+//	3. wait until ours are all acknowledged, and print how fast the
+//	   others' got here
+//
+// The machines have ID's 0 to "nodes" - 1; netbench.sh starts them all.
+
+static int meshNodes;			// machines taking part
+static int *nextFrom;			// next message expected from each
+
+static void
+MeshReceiver(void *arg)
+{
+    PacketHeader inPktHdr;
+    MailHeader inMailHdr;
+    char buffer[MaxMailSize];
+    char expected[MaxSegmentSize];
+
+    for (int i = 0; i < (meshNodes - 1) * messages; i++) {
+	postOffice->Receive(0, &inPktHdr, &inMailHdr, buffer);
+	int from = inPktHdr.from;
+	if (from < 0 || from >= meshNodes || nextFrom[from] >= messages) {
+	    printf("Unexpected message from %d\n", from);
+	    misdelivered++;
+	    continue;
+	}
+	FillMessage(expected, nextFrom[from]++, from);
+	if (inMailHdr.length != MaxSegmentSize
+	    || memcmp(buffer, expected, MaxSegmentSize) != 0) {
+	    printf("Message %d from %d: got \"%s\" instead\n",
+		   nextFrom[from] - 1, from, buffer);
+	    misdelivered++;
+	}
+    }
+    lastArrival = stats->totalTicks;
+    allReceived->V();
+}
+
+void
+MeshTest(int nodes, int count)
+{
+    PacketHeader outPktHdr;
+    MailHeader outMailHdr;
+    char data[MaxSegmentSize];
+    int self = postOffice->Address();
+    int start = stats->totalTicks;
+
+    ASSERT(nodes > 1 && self < nodes);
+    meshNodes = nodes;
+    messages = count;
+    nextFrom = new int[nodes];
+    for (int i = 0; i < nodes; i++)
+	nextFrom[i] = 0;
+    allReceived = new Semaphore("all received", 0);
+    Thread *t = new Thread("mesh receiver");
+    t->Fork(MeshReceiver, NULL);
+
+    outMailHdr.to = 0;
+    outMailHdr.from = 0;
+    outMailHdr.length = MaxSegmentSize;
+    for (int i = 0; i < count; i++) {
+	FillMessage(data, i, self);
+	for (int far = 0; far < nodes; far++) {
+	    if (far == self)
+		continue;
+	    outPktHdr.to = far;
+	    if (!postOffice->SendReliable(outPktHdr, outMailHdr, data))
+		printf("Machine %d stopped answering\n", far);
+	}
+    }
+
+    allReceived->P();
+    postOffice->Drain();
+
+    int ticks = lastArrival - start;
+    int sent = count * (nodes - 1);
+    int transmissions = sent + stats->numRetransmits;
+    printf("Received %d messages from %d machines, %d wrong, in %d ticks\n",
+	   sent, nodes - 1, misdelivered, ticks);
+    printf("Goodput: %.2f bytes per 1000 ticks; %d messages sent in %d "
+	   "packets (%d%% useful)\n",
+	   (double) sent * MaxSegmentSize * 1000 / (ticks > 0 ? ticks : 1),
+	   sent, transmissions, sent * 100 / transmissions);
+    fflush(stdout);
+    delete [] nextFrom;
+    delete allReceived;
+    interrupt->Halt();
+}
@@ -12,31 +12,33 @@
 // 	The implementation synchronizes incoming messages with threads
 //	waiting for those messages.
 //
+//	The reliable channels (cf. post.h) are run by the postal worker,
+//	which takes note of the acknowledgements and answers the messages
+//	that arrive, and by a second thread, the "retransmitter", that wakes
+//	up when the oldest unacknowledged message has waited too long.
+//	The retransmission timeout of each channel follows the round trip
+//	times measured on it (Jacobson's algorithm; a message sent more than
+//	once gives no measure, since we can't tell which copy was answered),
+//	and doubles when it expires, up to a few times the measured one
+//	while messages still get through.  A message is also sent again,
+//	without waiting for the timeout, once DupThresh messages sent after
+//	it have been acknowledged.
+//
+//	Messages bigger than a packet are split by Send and SendReliable,
+//	and put back together by the postal worker in a reassembly buffer,
+//	which the Mail in the mailbox then points to.  The buffer is free
+//	again once Receive has copied the message out.  If there is no free
+//	buffer, a fragment sent with Send is dropped, and the fragments of
+//	a reliable channel wait in its window (which closes it) until a
+//	buffer is free.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
 #include "post.h"
-
-//----------------------------------------------------------------------
-// Mail::Mail
-//      Initialize a single mail message, by concatenating the headers to
-//	the data.
-//
-//	"pktH" -- source, destination machine ID's
-//	"mailH" -- source, destination mailbox ID's
-//	"data" -- payload data
-//----------------------------------------------------------------------
-
-Mail::Mail(PacketHeader pktH, MailHeader mailH, const char *msgData)
-{
-    ASSERT(mailH.length <= MaxMailSize);
-
-    pktHdr = pktH;
-    mailHdr = mailH;
-    bcopy(msgData, data, mailHdr.length);
-}
+#include "system.h"
 
 //----------------------------------------------------------------------
 // MailBox::MailBox
@@ -49,20 +51,23 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, const char *msgData)
 
 MailBox::MailBox()
 { 
-    messages = new SynchList<Mail*>; 
+    first = last = NULL;
+    waiting = 0;
+    lock = new Lock("mailbox lock");
+    arrived = new Condition("mail arrived");
 }
 
 //----------------------------------------------------------------------
 // MailBox::~MailBox
 //      De-allocate a single mail box within the post office.
 //
-//	Just delete the mailbox, and throw away all the queued messages 
-//	in the mailbox.
+//	The queued messages are thrown away with the post office's pool.
 //----------------------------------------------------------------------
 
 MailBox::~MailBox()
 { 
-    delete messages; 
+    delete lock;
+    delete arrived;
 }
 
 //----------------------------------------------------------------------
@@ -86,71 +91,104 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 // 	Add a message to the mailbox.  If anyone is waiting for message
 //	arrival, wake them up!
 //
-//	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
+//	The message stays in the buffer the network put it in.
 //
-//	"pktHdr" -- source, destination machine ID's
-//	"mailHdr" -- source, destination mailbox ID's
-//	"data" -- payload message data
+//	"mail" -- the message, with its headers
 //----------------------------------------------------------------------
 
 void 
-MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, const char *data)
+MailBox::Put(Mail *mail)
 { 
-    Mail *mail = new Mail(pktHdr, mailHdr, data); 
-
-    messages->Append(mail);		// put on the end of the list of 
+    lock->Acquire();
+    mail->next = NULL;
+    if (last == NULL)
+	first = mail;
+    else
+	last->next = mail;
+    last = mail;			// put on the end of the list of 
 					// arrived messages, and wake up 
 					// any waiters
+    waiting++;
+    arrived->Signal(lock);
+    lock->Release();
 }
 
 //----------------------------------------------------------------------
 // MailBox::Get
-// 	Get a message from a mailbox, parsing it into the packet header,
-//	mailbox header, and data. 
-//
-//	The calling thread waits if there are no messages in the mailbox.
-//
-//	"pktHdr" -- address to put: source, destination machine ID's
-//	"mailHdr" -- address to put: source, destination mailbox ID's
-//	"data" -- address to put: payload message data
+// 	Get the oldest message out of a mailbox.  The calling thread waits
+//	if there are no messages in the mailbox.
 //----------------------------------------------------------------------
 
-void 
-MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
+Mail *
+MailBox::Get() 
 { 
     DEBUG('n', "Waiting for mail in mailbox\n");
-    Mail *mail = messages->Remove();	// remove message from list;
-					// will wait if list is empty
+    lock->Acquire();
+    while (first == NULL)
+	arrived->Wait(lock);
+    Mail *mail = first;			// remove message from list
+    first = mail->next;
+    if (first == NULL)
+	last = NULL;
+    waiting--;
+    lock->Release();
+    return mail;
+}
 
-    *pktHdr = mail->pktHdr;
-    *mailHdr = mail->mailHdr;
-    if (DebugIsEnabled('n')) {
-	printf("Got mail from mailbox: ");
-	PrintHeader(*pktHdr, *mailHdr);
+//----------------------------------------------------------------------
+// Channel::Channel
+// 	Initialize one end of a reliable channel, with nothing sent or
+//	received yet.
+//
+//	"farAddr", "farBox" -- the mailbox at the other end
+//	"localBox" -- our mailbox
+//----------------------------------------------------------------------
+
+Channel::Channel(NetworkAddress farAddr, MailBoxAddress farBox,
+		 MailBoxAddress localBox)
+{
+    peer = farAddr;
+    peerBox = farBox;
+    box = localBox;
+
+    sendBase = nextSeq = 0;
+    peerWindow = MaxWindow;
+    sends = 0;
+    broken = false;
+    heardAt = ackedAt = resentAt = stats->totalTicks;
+    recvBase = 0;
+    assembly = NULL;
+    sender = NULL;
+    windowClosed = false;
+    for (int i = 0; i < MaxWindow; i++) {
+	sent[i].inUse = sent[i].acked = false;
+	received[i] = NULL;
     }
-    bcopy(mail->data, data, mail->mailHdr.length);
-					// copy the message data into
-					// the caller's buffer
-    delete mail;			// we've copied out the stuff we
-					// need, we can now discard the message
+
+    srtt = -1;				// nothing measured yet
+    rttvar = 0;
+    measuredTimeout = timeout = InitialTimeout;
 }
 
 //----------------------------------------------------------------------
-// PostalHelper, ReadAvail, WriteDone
+// PostalHelper, RetransmitHelper, ReadAvail, WriteDone, TimerHandler
 // 	Dummy functions because C++ can't indirectly invoke member functions
-//	The first is forked as part of the "postal worker thread; the
-//	later two are called by the network interrupt handler.
+//	The first two are forked as the "postal worker" and "retransmitter"
+//	threads; the later three are called by interrupt handlers.
 //
 //	"arg" -- pointer to the Post Office managing the Network
 //----------------------------------------------------------------------
 
 static void PostalHelper(void* arg)
 { PostOffice* po = (PostOffice *) arg; po->PostalDelivery(); }
+static void RetransmitHelper(void* arg)
+{ PostOffice* po = (PostOffice *) arg; po->Retransmitter(); }
 static void ReadAvail(void* arg)
 { PostOffice* po = (PostOffice *) arg; po->IncomingPacket(); }
 static void WriteDone(void* arg)
 { PostOffice* po = (PostOffice *) arg; po->PacketSent(); }
+static void TimerHandler(void* arg)
+{ PostOffice* po = (PostOffice *) arg; po->TimerExpired(); }
 
 //----------------------------------------------------------------------
 // PostOffice::PostOffice
@@ -177,6 +215,24 @@ PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
     messageAvailable = new Semaphore("message available", 0);
     messageSent = new Semaphore("message sent", 0);
     sendLock = new Lock("message send lock");
+    pool = new Mail[MailBuffers];
+    freeMail = NULL;
+    numFree = MailBuffers;
+    for (int i = 0; i < MailBuffers; i++) {
+	pool[i].next = freeMail;
+	freeMail = &pool[i];
+    }
+    poolLock = new Lock("mail pool lock");
+    channelLock = new Lock("channel lock");
+    windowOpen = new Condition("window open");
+    timerExpired = new Semaphore("retransmission timer", 0);
+    timerAt = -1;
+    window = DefaultWindow;
+    lastHeard = 0;
+    reassembly = new ReassemblyBuffer[ReassemblyBuffers];
+    for (int i = 0; i < ReassemblyBuffers; i++)
+	reassembly[i].inUse = false;
+    nextMessageId = 0;
 
 // Second, initialize the mailboxes
     netAddr = addr; 
@@ -188,10 +244,13 @@ PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
 
 
 // Finally, create a thread whose sole job is to wait for incoming messages,
-//   and put them in the right mailbox. 
+//   and put them in the right mailbox, and another to retransmit the
+//   messages of the reliable channels.
     Thread *t = new Thread("postal worker");
 
     t->Fork(PostalHelper, this);
+    t = new Thread("retransmitter");
+    t->Fork(RetransmitHelper, this);
 }
 
 //----------------------------------------------------------------------
@@ -206,6 +265,65 @@ PostOffice::~PostOffice()
     delete messageAvailable;
     delete messageSent;
     delete sendLock;
+    delete [] pool;
+    delete poolLock;
+    for (std::map<int, Channel *>::iterator it = channels.begin();
+	 it != channels.end(); it++)
+	delete it->second;
+    delete channelLock;
+    delete windowOpen;
+    delete timerExpired;
+    delete [] reassembly;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SetWindow
+// 	Set how many messages can be in flight on each reliable channel.
+//
+//	"size" -- at most MaxWindow
+//----------------------------------------------------------------------
+
+void
+PostOffice::SetWindow(int size)
+{
+    ASSERT(size > 0 && size <= MaxWindow);
+    window = size;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::AllocMail
+// 	Take a buffer for an incoming packet out of the pool; return NULL
+//	if they are all in use.
+//----------------------------------------------------------------------
+
+Mail *
+PostOffice::AllocMail()
+{
+    poolLock->Acquire();
+    Mail *mail = freeMail;
+    if (mail != NULL) {
+	freeMail = mail->next;
+	numFree--;
+	mail->whole = NULL;
+    }
+    poolLock->Release();
+    return mail;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::FreeMail
+// 	Give the buffer of a message that has been read, or that we don't
+//	keep, back to the pool.
+//----------------------------------------------------------------------
+
+void
+PostOffice::FreeMail(Mail *mail)
+{
+    poolLock->Acquire();
+    mail->next = freeMail;
+    freeMail = mail;
+    numFree++;
+    poolLock->Release();
 }
 
 //----------------------------------------------------------------------
@@ -214,32 +332,62 @@ PostOffice::~PostOffice()
 //
 //      Incoming messages have had the PacketHeader stripped off,
 //	but the MailHeader is still tacked on the front of the data.
+//	The network puts each one straight into a buffer from the pool,
+//	which then goes into the mailbox as it is.
 //----------------------------------------------------------------------
 
 void
 PostOffice::PostalDelivery()
 {
-    PacketHeader pktHdr;
-    MailHeader mailHdr;
     char *buffer = new char[MaxPacketSize];
+					// for the packets we have no room for
 
     for (;;) {
         // first, wait for a message
         messageAvailable->P();	
-        pktHdr = network->Receive(buffer);
+	Mail *mail = AllocMail();
+	if (mail == NULL) {
+	    network->Receive(buffer);
+	    DEBUG('n', "No buffer for an incoming packet, dropping it\n");
+	    continue;
+	}
+        mail->pktHdr = network->Receive(mail->packet);
 
-        mailHdr = *(MailHeader *)buffer;
+        mail->mailHdr = *(MailHeader *) mail->packet;
+	mail->data = mail->packet + sizeof(MailHeader);
+	mail->size = mail->pktHdr.length - sizeof(MailHeader);
         if (DebugIsEnabled('n')) {
 	    printf("Putting mail into mailbox: ");
-	    PrintHeader(pktHdr, mailHdr);
+	    PrintHeader(mail->pktHdr, mail->mailHdr);
         }
 
 	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
+	ASSERT(0 <= mail->mailHdr.to && mail->mailHdr.to < numBoxes);
+	ASSERT(mail->mailHdr.length <= MaxMessageSize);
+
+	// messages of a reliable channel go through the channel first
+	if (mail->mailHdr.kind != PlainMail) {
+	    SegmentHeader segHdr = *(SegmentHeader *) mail->data;
+
+	    mail->data += sizeof(SegmentHeader);
+	    mail->size -= sizeof(SegmentHeader);
+	    ChannelArrival(mail, segHdr);
+	    continue;
+	}
+
+	// and fragments have to wait for the rest of the message
+	if (mail->mailHdr.length > MaxMailSize) {
+	    FragmentHeader fragHdr = *(FragmentHeader *) mail->data;
+
+	    mail->data += sizeof(FragmentHeader);
+	    mail->size -= sizeof(FragmentHeader);
+	    FragmentArrival(mail, fragHdr);
+	    continue;
+	}
 
 	// put into mailbox
-        boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+	ASSERT(mail->size == (int) mail->mailHdr.length);
+        boxes[mail->mailHdr.to].Put(mail);
     }
 }
 
@@ -251,6 +399,10 @@ PostOffice::PostalDelivery()
 //	Note that the MailHeader + data looks just like normal payload
 //	data to the Network.
 //
+//	A message that doesn't fit in a packet is sent in fragments, each
+//	with a FragmentHeader after the MailHeader; if any of them is
+//	lost, the whole message is.
+//
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
 //	"data" -- payload message data
@@ -259,23 +411,64 @@ PostOffice::PostalDelivery()
 void
 PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, const char* data)
 {
-    char* buffer = new char[MaxPacketSize];	// space to hold concatenated
-						// mailHdr + data
-
     if (DebugIsEnabled('n')) {
 	printf("Post send: ");
 	PrintHeader(pktHdr, mailHdr);
     }
-    ASSERT(mailHdr.length <= MaxMailSize);
+    ASSERT(mailHdr.length <= MaxMessageSize);
     ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-    
-    // fill in pktHdr, for the Network layer
-    pktHdr.from = netAddr;
-    pktHdr.length = mailHdr.length + sizeof(MailHeader);
 
-    // concatenate MailHeader and data
+    mailHdr.kind = PlainMail;
+    if (mailHdr.length <= MaxMailSize) {
+	Transmit(pktHdr, mailHdr, NULL, 0, data, mailHdr.length);
+	return;
+    }
+
+    FragmentHeader fragHdr;
+    fragHdr.id = nextMessageId++;
+    fragHdr.index = 0;
+    for (unsigned offset = 0; offset < mailHdr.length;
+	 offset += MaxFragmentSize, fragHdr.index++) {
+	int size = mailHdr.length - offset;
+	if (size > (int) MaxFragmentSize)
+	    size = MaxFragmentSize;
+	Transmit(pktHdr, mailHdr, &fragHdr, sizeof(FragmentHeader),
+		 data + offset, size);
+    }
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Transmit
+// 	Concatenate the headers and the data, and send the result to the
+//	network; wait until the network can take the next packet.
+//
+//	"pktHdr" -- destination machine ID
+//	"mailHdr" -- source, destination mailbox ID's
+//	"hdr", "hdrSize" -- the SegmentHeader or FragmentHeader, if any
+//	"data", "size" -- payload message data in this packet
+//----------------------------------------------------------------------
+
+void
+PostOffice::Transmit(PacketHeader pktHdr, MailHeader mailHdr,
+		     const void *hdr, int hdrSize, const char *data, int size)
+{
+    char* buffer = new char[MaxPacketSize];	// space to hold concatenated
+						// headers + data
+    int offset = sizeof(MailHeader);
+
+    ASSERT(offset + hdrSize + size <= MaxPacketSize);
     bcopy(&mailHdr, buffer, sizeof(MailHeader));
-    bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
+    if (hdrSize > 0) {
+	bcopy(hdr, buffer + offset, hdrSize);
+	offset += hdrSize;
+    }
+    if (size > 0)
+	bcopy(data, buffer + offset, size);
+
+    // fill in pktHdr, for the Network layer
+    pktHdr.from = netAddr;
+    pktHdr.length = offset + size;
+    ASSERT(pktHdr.length <= MaxPacketSize);
 
     sendLock->Acquire();   		// only one message can be sent
 					// to the network at any one time
@@ -289,7 +482,7 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, const char* data)
 }
 
 //----------------------------------------------------------------------
-// PostOffice::Send
+// PostOffice::Receive
 // 	Retrieve a message from a specific box if one is available, 
 //	otherwise wait for a message to arrive in the box.
 //
@@ -298,6 +491,8 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, const char* data)
 //
 //
 //	"box" -- mailbox ID in which to look for message
+//	"data" -- room for the message: MaxMailSize bytes, or up to
+//		MaxMessageSize if it may have been sent in fragments
 //	"pktHdr" -- address to put: source, destination machine ID's
 //	"mailHdr" -- address to put: source, destination mailbox ID's
 //	"data" -- address to put: payload message data
@@ -309,8 +504,157 @@ PostOffice::Receive(int box, PacketHeader *pktHdr,
 {
     ASSERT((box >= 0) && (box < numBoxes));
 
-    boxes[box].Get(pktHdr, mailHdr, data);
-    ASSERT(mailHdr->length <= MaxMailSize);
+    Mail *mail = boxes[box].Get();
+
+    *pktHdr = mail->pktHdr;
+    *mailHdr = mail->mailHdr;
+    if (DebugIsEnabled('n')) {
+	printf("Got mail from mailbox: ");
+	PrintHeader(*pktHdr, *mailHdr);
+    }
+    ASSERT(mailHdr->length <= MaxMessageSize);
+    if (mail->whole != NULL) {
+	bcopy(mail->whole->data, data, mailHdr->length);
+	mail->whole->inUse = false;	// the buffer is free again
+    } else
+	bcopy(mail->data, data, mailHdr->length);
+					// copy the message data into
+					// the caller's buffer
+    FreeMail(mail);			// we've copied out the stuff we
+					// need, we can now discard the message
+
+    // reading the message made room for more: in the mailbox, so that
+    // a channel we had told to stop can go on, and maybe in the
+    // reassembly buffers, which a channel could be waiting for
+    if (mailHdr->kind == ChannelData || mailHdr->length > MaxMailSize) {
+	std::vector<Channel *> reopen;
+
+	channelLock->Acquire();
+	for (std::map<int, Channel *>::iterator it = channels.begin();
+	     it != channels.end(); it++) {
+	    Channel *ch = it->second;
+	    DeliverInOrder(ch);
+	    if (ch->windowClosed && FreeSlots(ch) > 0)
+		reopen.push_back(ch);
+	}
+	channelLock->Release();
+	for (unsigned i = 0; i < reopen.size(); i++)
+	    SendAck(reopen[i]);
+    }
+}
+
+//----------------------------------------------------------------------
+// PostOffice::HasMail
+// 	Return true if there is a message in "box", so that Receive
+//	wouldn't wait.
+//----------------------------------------------------------------------
+
+bool
+PostOffice::HasMail(int box)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+    return boxes[box].NumWaiting() > 0;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::GetBuffer
+// 	Return a free reassembly buffer, or NULL if there is none.  Buffers
+//	of messages sent with Send that have been waiting for fragments
+//	longer than ReassemblyTimeout are freed first.  The caller holds
+//	channelLock.
+//
+//	"expires" -- for a message sent with Send
+//----------------------------------------------------------------------
+
+ReassemblyBuffer *
+PostOffice::GetBuffer(bool expires)
+{
+    ReassemblyBuffer *free = NULL;
+    int now = stats->totalTicks;
+
+    for (int i = 0; i < ReassemblyBuffers; i++) {
+	ReassemblyBuffer *buf = &reassembly[i];
+	if (buf->inUse && !buf->complete && buf->expires
+	    && now - buf->started > ReassemblyTimeout) {
+	    DEBUG('n', "Dropping message %d from %d: fragments missing\n",
+		  buf->id, buf->from);
+	    buf->inUse = false;
+	}
+	if (!buf->inUse && free == NULL)
+	    free = buf;
+    }
+    if (free == NULL)
+	return NULL;
+
+    free->inUse = true;
+    free->complete = false;
+    free->expires = expires;
+    free->received = 0;
+    free->started = now;
+    if (expires)
+	for (unsigned i = 0; i < MaxFragments; i++)
+	    free->arrived[i] = false;
+    return free;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::FragmentArrival
+// 	A fragment of a message sent with Send has arrived.  Copy it into
+//	the reassembly buffer of its message, starting one if it is the
+//	first to arrive; once the message is complete, put it into its
+//	mailbox, in the Mail of its last fragment.  If no buffer is free,
+//	the fragment, and so the message, is lost.
+//
+//	"mail" -- the fragment, with its headers
+//	"fragHdr" -- which fragment it is
+//----------------------------------------------------------------------
+
+void
+PostOffice::FragmentArrival(Mail *mail, FragmentHeader fragHdr)
+{
+    PacketHeader pktHdr = mail->pktHdr;
+    MailHeader mailHdr = mail->mailHdr;
+    ReassemblyBuffer *buf = NULL;
+    unsigned offset = fragHdr.index * MaxFragmentSize;
+
+    ASSERT(offset + mail->size <= mailHdr.length);
+    channelLock->Acquire();
+    for (int i = 0; i < ReassemblyBuffers && buf == NULL; i++) {
+	ReassemblyBuffer *b = &reassembly[i];
+	if (b->inUse && !b->complete && b->expires && b->id == fragHdr.id
+	    && b->from == pktHdr.from && b->fromBox == mailHdr.from
+	    && b->toBox == mailHdr.to)
+	    buf = b;
+    }
+    if (buf == NULL) {
+	buf = GetBuffer(true);
+	if (buf == NULL) {
+	    DEBUG('n', "No buffer for message %d from %d\n", fragHdr.id,
+		  pktHdr.from);
+	    channelLock->Release();
+	    FreeMail(mail);
+	    return;
+	}
+	buf->from = pktHdr.from;
+	buf->fromBox = mailHdr.from;
+	buf->toBox = mailHdr.to;
+	buf->id = fragHdr.id;
+    }
+
+    if (!buf->arrived[fragHdr.index]) {
+	buf->arrived[fragHdr.index] = true;
+	bcopy(mail->data, buf->data + offset, mail->size);
+	buf->received += mail->size;
+    }
+    if (buf->received == mailHdr.length) {
+	buf->complete = true;
+	mail->whole = buf;
+	boxes[mailHdr.to].Put(mail);
+	mail = NULL;
+    }
+    channelLock->Release();
+    if (mail != NULL)
+	FreeMail(mail);
 }
 
 //----------------------------------------------------------------------
@@ -342,3 +686,579 @@ PostOffice::PacketSent()
     messageSent->V();
 }
 
+
+//----------------------------------------------------------------------
+// PostOffice::TimerExpired
+// 	Interrupt handler, called when the retransmission timer goes off.
+//	Wake up the retransmitter.
+//----------------------------------------------------------------------
+
+void
+PostOffice::TimerExpired()
+{
+    timerAt = -1;
+    timerExpired->V();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::ArmTimer
+// 	Make sure the retransmission timer goes off within "fromNow" ticks.
+//	Timer interrupts can't be cancelled: an extra one just wakes up the
+//	retransmitter for nothing.
+//----------------------------------------------------------------------
+
+void
+PostOffice::ArmTimer(int fromNow)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int when = stats->totalTicks + fromNow;
+
+    if (timerAt == -1 || when < timerAt) {
+	timerAt = when;
+	interrupt->Schedule(TimerHandler, this, fromNow, TimerInt);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::FindChannel
+// 	Return the reliable channel between mailbox "localBox" here and
+//	mailbox "farBox" of machine "farAddr"; set it up the first time.
+//	The caller holds channelLock.
+//----------------------------------------------------------------------
+
+Channel *
+PostOffice::FindChannel(NetworkAddress farAddr, MailBoxAddress farBox,
+			MailBoxAddress localBox)
+{
+    int key = (farAddr * numBoxes + farBox) * numBoxes + localBox;
+    std::map<int, Channel *>::iterator found = channels.find(key);
+
+    if (found != channels.end())
+	return found->second;
+    Channel *ch = new Channel(farAddr, farBox, localBox);
+    channels[key] = ch;
+    return ch;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::FreeSlots
+// 	Return how many more messages of "ch" we can take: the window,
+//	less the messages kept until a gap is filled, and the ones waiting
+//	in the mailbox to be read.  The caller holds channelLock.
+//----------------------------------------------------------------------
+
+int
+PostOffice::FreeSlots(Channel *ch)
+{
+    int slots = window - boxes[ch->box].NumWaiting();
+
+    for (int i = 0; i < MaxWindow; i++)
+	if (ch->received[i] != NULL)
+	    slots--;
+    return (slots > 0) ? slots : 0;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::FillAck
+// 	Fill in the fields of "segHdr" that tell the other end of "ch"
+//	which of its messages we have, and how many more we can take.
+//	The caller holds channelLock.
+//----------------------------------------------------------------------
+
+void
+PostOffice::FillAck(Channel *ch, SegmentHeader *segHdr)
+{
+    segHdr->ack = ch->recvBase;
+    segHdr->sack = 0;
+    for (int i = 1; i < MaxWindow; i++) {
+	SeqNum seq = ch->recvBase + i;
+	if (ch->received[seq % MaxWindow] != NULL)
+	    segHdr->sack |= 1 << (i - 1);
+    }
+    segHdr->window = FreeSlots(ch);
+    ch->windowClosed = (segHdr->window == 0);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SendReliable
+// 	Send a message on the reliable channel between mailbox
+//	"mailHdr.from" here and mailbox "mailHdr.to" of machine "pktHdr.to".
+//	Wait while there are as many messages in flight as the window
+//	allows, or as the other end said it can take; even if it said it
+//	can take none, one message at a time goes, so that we hear when
+//	it can take more.
+//
+//	A message bigger than a packet goes in as many messages of the
+//	channel as it takes, one after the other, as full as they can be.
+//
+//	Return once the message is sent the first time; the post office
+//	keeps it until it is acknowledged.  Return false if we gave up on
+//	the channel.
+//
+//	"pktHdr" -- destination machine ID
+//	"mailHdr" -- source, destination mailbox ID's
+//	"data" -- payload message data, at most MaxMessageSize bytes
+//----------------------------------------------------------------------
+
+bool
+PostOffice::SendReliable(PacketHeader pktHdr, MailHeader mailHdr,
+			 const char *data)
+{
+    ASSERT(mailHdr.length <= MaxMessageSize);
+    ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
+    ASSERT(0 <= mailHdr.from && mailHdr.from < numBoxes);
+
+    channelLock->Acquire();
+    Channel *ch = FindChannel(pktHdr.to, mailHdr.to, mailHdr.from);
+
+    // the fragments of two messages mustn't be mixed
+    while (ch->sender != NULL)
+	windowOpen->Wait(channelLock);
+    ch->sender = currentThread;
+
+    unsigned offset = 0;
+    do {
+	int size = mailHdr.length - offset;
+	if (size > (int) MaxSegmentSize)
+	    size = MaxSegmentSize;
+	for (;;) {
+	    int limit = (ch->peerWindow < window) ? ch->peerWindow : window;
+	    if (limit < 1)
+		limit = 1;
+	    if (ch->broken
+		|| (SeqNum) (ch->nextSeq - ch->sendBase) < limit)
+		break;
+	    windowOpen->Wait(channelLock);
+	}
+	if (ch->broken)
+	    break;
+
+	SeqNum seq = ch->nextSeq++;
+	WindowSlot *seg = &ch->sent[seq % MaxWindow];
+	seg->inUse = true;
+	seg->acked = false;
+	seg->transmissions = 0;
+	seg->mailHdr = mailHdr;
+	seg->mailHdr.kind = ChannelData;
+	seg->size = size;
+	bcopy(data + offset, seg->data, size);
+	channelLock->Release();
+
+	SendSegment(ch, seq);
+	offset += size;
+	channelLock->Acquire();
+    } while (offset < mailHdr.length);
+
+    bool sent = !ch->broken;
+    ch->sender = NULL;
+    windowOpen->Broadcast(channelLock);
+    channelLock->Release();
+    return sent;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SendSegment
+// 	Send message "seq" of "ch", with the latest news about the
+//	messages that came the other way.  Return false if there is
+//	nothing to send: the message has been acknowledged meanwhile.
+//----------------------------------------------------------------------
+
+bool
+PostOffice::SendSegment(Channel *ch, SeqNum seq)
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    SegmentHeader segHdr;
+    char data[MaxSegmentSize];
+
+    channelLock->Acquire();
+    WindowSlot *seg = &ch->sent[seq % MaxWindow];
+    if ((SeqNum) (seq - ch->sendBase) >= (SeqNum) (ch->nextSeq - ch->sendBase)
+	|| seg->acked) {
+	channelLock->Release();
+	return false;
+    }
+    seg->transmissions++;
+    seg->sentAt = stats->totalTicks;
+    seg->sendOrder = ++ch->sends;
+    if (seg->transmissions > 1) {
+	stats->numRetransmits++;
+	DEBUG('n', "Sending message %d to (%d, %d) again, timeout %d\n",
+	      seq, ch->peer, ch->peerBox, ch->timeout);
+    }
+
+    pktHdr.to = ch->peer;
+    mailHdr = seg->mailHdr;
+    segHdr.seq = seq;
+    FillAck(ch, &segHdr);
+    int size = seg->size;
+    bcopy(seg->data, data, size);
+    ArmTimer(ch->timeout);
+    channelLock->Release();
+
+    Transmit(pktHdr, mailHdr, &segHdr, sizeof(SegmentHeader), data, size);
+    return true;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SendAck
+// 	Send the other end of "ch" a packet that only tells which of its
+//	messages we have.
+//----------------------------------------------------------------------
+
+void
+PostOffice::SendAck(Channel *ch)
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    SegmentHeader segHdr;
+
+    channelLock->Acquire();
+    pktHdr.to = ch->peer;
+    mailHdr.to = ch->peerBox;
+    mailHdr.from = ch->box;
+    mailHdr.length = 0;
+    mailHdr.kind = ChannelAck;
+    segHdr.seq = ch->nextSeq;
+    FillAck(ch, &segHdr);
+    channelLock->Release();
+
+    Transmit(pktHdr, mailHdr, &segHdr, sizeof(SegmentHeader), NULL, 0);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::ChannelArrival
+// 	A packet of a reliable channel has arrived.  Take note of what it
+//	acknowledges, keep the message it carries, if it is new (and, if it
+//	is out of order, if the pool isn't running out), and put
+//	the messages that are now in order into the mailbox.  Then answer:
+//	every message is acknowledged, even a duplicate, since it means
+//	that our last acknowledgement was lost.
+//
+//	"mail" -- the packet, with its headers; kept in the window if it
+//		is a new message, given back to the pool otherwise
+//	"segHdr" -- its header for the channel
+//----------------------------------------------------------------------
+
+void
+PostOffice::ChannelArrival(Mail *mail, SegmentHeader segHdr)
+{
+    MailHeader mailHdr = mail->mailHdr;
+    std::vector<SeqNum> lost;
+    bool answered = false;
+
+    channelLock->Acquire();
+    lastHeard = stats->totalTicks;
+    Channel *ch = FindChannel(mail->pktHdr.from, mailHdr.from, mailHdr.to);
+    ProcessAck(ch, segHdr, &lost);
+
+    if (mailHdr.kind == ChannelData) {
+	Mail **slot = &ch->received[segHdr.seq % MaxWindow];
+	ASSERT(mail->size <= (int) MaxSegmentSize);
+	if ((SeqNum) (segHdr.seq - ch->recvBase) < MaxWindow && *slot == NULL
+	    && (segHdr.seq == ch->recvBase || numFree >= MailReserve)) {
+	    *slot = mail;
+	    mail = NULL;
+	}
+	DeliverInOrder(ch);
+    }
+    channelLock->Release();
+    if (mail != NULL)			// an acknowledgement, or a duplicate
+	FreeMail(mail);
+
+    // messages we send again carry the acknowledgement
+    for (unsigned i = 0; i < lost.size(); i++)
+	if (SendSegment(ch, lost[i]))
+	    answered = true;
+    if (mailHdr.kind == ChannelData && !answered)
+	SendAck(ch);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::DeliverInOrder
+// 	Put the messages of "ch" that have arrived, and all those before
+//	them, into the mailbox.  A message that came in fragments goes in
+//	once its last fragment is there, in the Mail of that fragment; if
+//	there is no reassembly buffer for it, it waits in the window.  The
+//	caller holds channelLock.
+//----------------------------------------------------------------------
+
+void
+PostOffice::DeliverInOrder(Channel *ch)
+{
+    for (;;) {
+	Mail *mail = ch->received[ch->recvBase % MaxWindow];
+	if (mail == NULL)
+	    break;
+
+	if (mail->mailHdr.length <= MaxSegmentSize)
+	    boxes[ch->box].Put(mail);
+	else {
+	    if (ch->assembly == NULL
+		&& (ch->assembly = GetBuffer(false)) == NULL)
+		break;
+	    ReassemblyBuffer *buf = ch->assembly;
+	    ASSERT(buf->received + mail->size <= mail->mailHdr.length);
+	    bcopy(mail->data, buf->data + buf->received, mail->size);
+	    buf->received += mail->size;
+	    if (buf->received == mail->mailHdr.length) {
+		buf->complete = true;
+		mail->whole = buf;
+		boxes[ch->box].Put(mail);
+		ch->assembly = NULL;
+	    } else
+		FreeMail(mail);
+	}
+	ch->received[ch->recvBase % MaxWindow] = NULL;
+	ch->recvBase++;
+    }
+}
+
+//----------------------------------------------------------------------
+// PostOffice::ProcessAck
+// 	The other end of "ch" tells us which of our messages it has.
+//	Forget those, measuring how long they took to be acknowledged, and
+//	list in "lost" those that DupThresh messages sent after them have
+//	overtaken.  The caller holds channelLock.
+//----------------------------------------------------------------------
+
+void
+PostOffice::ProcessAck(Channel *ch, SegmentHeader segHdr,
+		       std::vector<SeqNum> *lost)
+{
+    int now = stats->totalTicks;
+    SeqNum seq;
+    bool progress = false;
+
+    ch->heardAt = now;			// the other end is there
+
+    // an old acknowledgement, overtaken by a newer one
+    if ((SeqNum) (segHdr.ack - ch->sendBase) >
+	(SeqNum) (ch->nextSeq - ch->sendBase))
+	return;
+
+    // every message before "ack" has arrived
+    for (; ch->sendBase != segHdr.ack; ch->sendBase++) {
+	WindowSlot *seg = &ch->sent[ch->sendBase % MaxWindow];
+	if (!seg->acked && seg->transmissions == 1)
+	    UpdateTimeout(ch, now - seg->sentAt);
+	seg->inUse = seg->acked = false;
+	progress = true;
+    }
+
+    // and so have the ones in the bitmap
+    for (seq = ch->sendBase; seq != ch->nextSeq; seq++) {
+	WindowSlot *seg = &ch->sent[seq % MaxWindow];
+	SeqNum bit = seq - segHdr.ack - 1;
+	if (bit < MaxWindow - 1 && (segHdr.sack & (1 << bit)) && !seg->acked) {
+	    if (seg->transmissions == 1)
+		UpdateTimeout(ch, now - seg->sentAt);
+	    seg->acked = true;
+	    progress = true;
+	}
+    }
+
+    // Messages get through again, so the ones missing were lost at
+    // random: bring the backed-off timeout back near the measured
+    // one.  Karn's rule keeps retransmitted messages from being
+    // measured, and at high loss rates nearly all of them are, so
+    // waiting for a new measurement would keep it backed off for long.
+    if (progress) {
+	ch->ackedAt = now;
+	if (ch->srtt >= 0 && ch->timeout > MaxBackoff * ch->measuredTimeout)
+	    ch->timeout = MaxBackoff * ch->measuredTimeout;
+	if (ch->srtt >= 0 && ch->timeout > MaxTimeout)
+	    ch->timeout = MaxTimeout;
+    }
+
+    // a message is lost if enough of those sent after it got there
+    for (seq = ch->sendBase; seq != ch->nextSeq; seq++) {
+	WindowSlot *seg = &ch->sent[seq % MaxWindow];
+	int overtaken = 0;
+	if (seg->acked)
+	    continue;
+	for (SeqNum later = ch->sendBase; later != ch->nextSeq; later++) {
+	    WindowSlot *other = &ch->sent[later % MaxWindow];
+	    if (other->acked && other->sendOrder > seg->sendOrder)
+		overtaken++;
+	}
+	if (overtaken >= DupThresh)
+	    lost->push_back(seq);
+    }
+
+    ch->peerWindow = segHdr.window;
+    windowOpen->Broadcast(channelLock);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::UpdateTimeout
+// 	A message of "ch" was acknowledged "rtt" ticks after it was sent:
+//	recompute the retransmission timeout, as the smoothed round trip
+//	time plus four times its variation (RFC 6298), within MinTimeout
+//	and MaxTimeout.
+//----------------------------------------------------------------------
+
+void
+PostOffice::UpdateTimeout(Channel *ch, int rtt)
+{
+    if (ch->srtt < 0) {
+	ch->srtt = rtt;
+	ch->rttvar = rtt / 2;
+    } else {
+	int delta = rtt - ch->srtt;
+	ch->rttvar += ((delta < 0 ? -delta : delta) - ch->rttvar) / 4;
+	ch->srtt += delta / 8;
+    }
+    ch->timeout = ch->srtt + ((4 * ch->rttvar > NetworkTime) ?
+			      4 * ch->rttvar : NetworkTime);
+    if (ch->timeout < MinTimeout)
+	ch->timeout = MinTimeout;
+    if (ch->timeout > MaxTimeout)
+	ch->timeout = MaxTimeout;
+    ch->measuredTimeout = ch->timeout;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Retransmitter
+// 	Each time the timer goes off, send again the oldest message of
+//	each channel that has waited longer than the channel's timeout,
+//	and double the timeout.  Only the oldest: if the ones after it
+//	were lost too, the acknowledgements of this one will tell.
+//
+//	While messages still get through (one was acknowledged within
+//	MaxBackedOff), packets are being lost at random rather than
+//	piling up somewhere, so the timeout backs off only up to
+//	MaxBackoff times the measured one, and MaxTimeout.  Otherwise
+//	it backs off up to MaxBackedOff, and runs again from there for
+//	the whole channel, not just that message (RFC 6298), so that
+//	the messages of the window aren't all sent again in turn.
+//
+//	A channel whose other end hasn't answered for GiveUpTime is
+//	given up: its messages are dropped, and SendReliable fails from
+//	then on.
+//----------------------------------------------------------------------
+
+void
+PostOffice::Retransmitter()
+{
+    std::vector<std::pair<Channel *, SeqNum> > due;
+
+    for (;;) {
+	timerExpired->P();
+
+	channelLock->Acquire();
+	int now = stats->totalTicks;
+	int next = -1;			// ticks until the next message is due
+	for (std::map<int, Channel *>::iterator it = channels.begin();
+	     it != channels.end(); it++) {
+	    Channel *ch = it->second;
+	    bool flowing = ch->srtt >= 0 && now - ch->ackedAt <= MaxBackedOff;
+	    int resentAt = flowing ? 0 : ch->resentAt;
+	    SeqNum seq;
+	    for (seq = ch->sendBase; seq != ch->nextSeq; seq++) {
+		WindowSlot *seg = &ch->sent[seq % MaxWindow];
+		if (!seg->acked && seg->sentAt + ch->timeout <= now
+		    && resentAt + ch->timeout <= now)
+		    break;
+	    }
+	    if (seq != ch->nextSeq) {
+		if (now - ch->heardAt > GiveUpTime) {
+		    DEBUG('n', "Giving up on (%d, %d)\n", ch->peer, ch->peerBox);
+		    ch->broken = true;
+		    for (; ch->sendBase != ch->nextSeq; ch->sendBase++)
+			ch->sent[ch->sendBase % MaxWindow].inUse = false;
+		    windowOpen->Broadcast(channelLock);
+		    continue;
+		}
+		due.push_back(std::make_pair(ch, seq));
+		ch->resentAt = now;
+		if (!flowing)
+		    resentAt = now;
+		ch->timeout *= 2;
+		if (flowing && ch->timeout > MaxBackoff * ch->measuredTimeout)
+		    ch->timeout = MaxBackoff * ch->measuredTimeout;
+		if (flowing && ch->timeout > MaxTimeout)
+		    ch->timeout = MaxTimeout;
+		if (ch->timeout > MaxBackedOff)
+		    ch->timeout = MaxBackedOff;
+	    }
+	    for (SeqNum other = ch->sendBase; other != ch->nextSeq; other++) {
+		WindowSlot *seg = &ch->sent[other % MaxWindow];
+		int from = (seg->sentAt > resentAt) ? seg->sentAt : resentAt;
+		int wait = from + ch->timeout - now;
+		if (seg->acked || other == seq)
+		    continue;
+		if (wait < 1)
+		    wait = 1;
+		if (next == -1 || wait < next)
+		    next = wait;
+	    }
+	}
+	if (next != -1)
+	    ArmTimer(next);
+	channelLock->Release();
+
+	for (unsigned i = 0; i < due.size(); i++)
+	    SendSegment(due[i].first, due[i].second);
+	due.clear();
+    }
+}
+
+//----------------------------------------------------------------------
+// Pause
+// 	Put the current thread to sleep for "ticks".
+//----------------------------------------------------------------------
+
+static void
+PauseDone(void* arg)
+{
+    ((Semaphore *) arg)->V();
+}
+
+static void
+Pause(int ticks)
+{
+    Semaphore *done = new Semaphore("pause", 0);
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    interrupt->Schedule(PauseDone, done, ticks, TimerInt);
+    (void) interrupt->SetLevel(oldLevel);
+    done->P();
+    delete done;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Drain
+// 	Wait until every message sent on a reliable channel has been
+//	acknowledged (or given up on).  Then stay around until the other
+//	ends have been quiet for LingerTime: our last acknowledgements may
+//	have been lost, and they would keep sending the same messages to
+//	a machine that is gone.
+//----------------------------------------------------------------------
+
+void
+PostOffice::Drain()
+{
+    std::map<int, Channel *>::iterator it;
+
+    channelLock->Acquire();
+    for (;;) {
+	for (it = channels.begin(); it != channels.end(); it++)
+	    if (it->second->sendBase != it->second->nextSeq)
+		break;
+	if (it == channels.end())
+	    break;
+	windowOpen->Wait(channelLock);
+    }
+
+    for (;;) {
+	int silent = stats->totalTicks - lastHeard;
+	if (silent >= LingerTime)
+	    break;
+	channelLock->Release();
+	Pause(LingerTime - silent);
+	channelLock->Acquire();
+    }
+    channelLock->Release();
+}
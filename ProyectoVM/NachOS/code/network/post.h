@@ -1,8 +1,13 @@
 // post.h 
-//	Data structures for providing the abstraction of unreliable,
-//	ordered, fixed-size message delivery to mailboxes on other 
-//	(directly connected) machines.  Messages can be dropped by
-//	the network, but they are never corrupted.
+//	Data structures for delivering messages to mailboxes on other
+//	(directly connected) machines.  The network drops packets, but
+//	never corrupts them.  Reliable channels send lost messages again,
+//	following a bitmap of the ones that arrived (SACK) and timeouts
+//	measured as in RFC 6298, and hand them over exactly once, in order.
+//	Messages bigger than a packet go in fragments, and are put back
+//	together at the other end.  Plain Send is still there, with no
+//	channel: a message sent with it arrives at most once, maybe out
+//	of order, or not at all.
 //
 // 	The US Post Office delivers mail to the addressed mailbox. 
 // 	By analogy, our post office delivers packets to a specific buffer 
@@ -19,6 +24,35 @@
 //	to which you can send an acknowledgement, if your protocol requires 
 //	this.
 //
+//	On top of that, the post office offers reliable channels: mail
+//	sent with SendReliable is delivered exactly once, in order, as long
+//	as the network delivers some of the packets.  A channel joins a
+//	mailbox here with a mailbox on another machine, and works as a
+//	selective repeat protocol: up to a window of messages are in flight;
+//	each one is numbered, kept until it is acknowledged, and sent again
+//	if the acknowledgement doesn't come back in time; the receiver
+//	keeps the messages that arrive out of order until the gaps are
+//	filled.  Every packet carries the receiver's cumulative
+//	acknowledgement, a bitmap of the messages it has beyond that, and
+//	how many more messages it can take, so that a receiver that doesn't
+//	keep up slows the sender down.  Messages received on a channel end
+//	up in the mailbox like any other mail, and are read with Receive.
+//
+//	Messages can be up to MaxMessageSize bytes long.  One that doesn't
+//	fit in a packet is sent in fragments, and put back together at
+//	the other end in one of a few reassembly buffers, before it goes
+//	into the mailbox.  If a fragment of a message sent with Send is
+//	lost, the message is dropped once ReassemblyTimeout has passed
+//	since its first fragment arrived; messages on a reliable channel
+//	lose no fragments.
+//
+//	Incoming packets go straight from the network into one of a fixed
+//	pool of Mail buffers, and stay there -- in a channel's window, then
+//	in a mailbox -- until Receive copies the message out into the
+//	caller's buffer and gives the buffer back to the pool.  Nothing is
+//	allocated, nor copied in between.  When the pool is empty, incoming
+//	packets are dropped, as by a network card with no room left.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -28,13 +62,21 @@
 #ifndef POST_H
 #define POST_H
 
+#include <map>
+#include <vector>
+
 #include "network.h"
-#include "synchlist.h"
+#include "synch.h"
 
 // Mailbox address -- uniquely identifies a mailbox on a given machine.
 // A mailbox is just a place for temporary storage for messages.
 typedef int MailBoxAddress;
 
+// What a message is, for the post office
+enum MailKind { PlainMail,		// unreliable: Send
+		ChannelData,		// message on a reliable channel
+		ChannelAck };		// acknowledgement, with no data
+
 // The following class defines part of the message header.  
 // This is prepended to the message by the PostOffice, before the message 
 // is sent to the Network.
@@ -44,7 +86,9 @@ class MailHeader {
     MailBoxAddress to;		// Destination mail box
     MailBoxAddress from;	// Mail box to reply to
     unsigned length;		// Bytes of message data (excluding the 
-				// mail header)
+				// mail header); of the whole message,
+				// for a message sent in fragments
+    MailKind kind;		// Set by the post office
 };
 
 // Maximum "payload" -- real data -- that can included in a single message
@@ -52,22 +96,168 @@ class MailHeader {
 
 #define MaxMailSize 	(MaxPacketSize - sizeof(MailHeader))
 
+// Largest message, sent in fragments if it is bigger than a packet
+#define MaxMessageSize 	(64 * 1024)
+
+// Incoming packets the post office can hold at once
+#define MailBuffers 	64
+#define MailReserve 	(MailBuffers / 4)
+				// buffers a channel doesn't keep a message
+				// that arrived out of order in, so that
+				// there is room for the one it waits for
 
-// The following class defines the format of an incoming/outgoing 
-// "Mail" message.  The message format is layered: 
+class ReassemblyBuffer;
+
+// The following class defines the format of an incoming "Mail" message.
+// The message format is layered: 
 //	network header (PacketHeader) 
 //	post office header (MailHeader) 
 //	data
+//
+// A Mail is one of the post office's pool of buffers, holding a packet
+// just as it came off the network.
 
 class Mail {
   public:
-     Mail(PacketHeader pktH, MailHeader mailH, const char *msgData);
-				// Initialize a mail message by
-				// concatenating the headers to the data
+    PacketHeader pktHdr;	// Header appended by Network
+    MailHeader mailHdr;		// Header appended by PostOffice
+    char packet[MaxPacketSize];	// The packet, starting with the MailHeader
+    char *data;			// Payload -- message data, in "packet"
+    int size;			// Bytes of payload in this packet
+    ReassemblyBuffer *whole;	// Or where the payload is, if it was
+				// sent in fragments
+    Mail *next;			// Next in the mailbox, or in the pool
+};
+
+// The following class defines the header after the MailHeader of a
+// fragment of a message sent with Send.  A message on a reliable
+// channel doesn't need one: its fragments arrive in order, each of
+// them but the last one as full as a packet can be.
+
+class FragmentHeader {
+  public:
+    unsigned short id;		// Message, among the ones the sender sent
+    unsigned short index;	// Fragment number, from 0
+};
+
+#define MaxFragmentSize 	(MaxMailSize - sizeof(FragmentHeader))
+#define MaxFragments 	(MaxMessageSize / MaxFragmentSize + 1)
+
+#define ReassemblyBuffers 	4	// messages put back together at once
+#define ReassemblyTimeout 	MaxBackedOff
+				// a message sent with Send that is still
+				// missing fragments by then is dropped
+
+// A message being put back together from its fragments, or put back
+// together and waiting in a mailbox to be read.
+
+class ReassemblyBuffer {
+  public:
+    bool inUse;			// holds a message
+    bool complete;		// the message is in a mailbox
+    bool expires;		// sent with Send: might never be complete
+    NetworkAddress from;	// Whose message, for Send: its sender,
+    MailBoxAddress fromBox;	// the mailboxes, and its id
+    MailBoxAddress toBox;
+    unsigned short id;
+    unsigned received;		// Bytes of the message we have
+    int started;		// When its first fragment arrived
+    bool arrived[MaxFragments];	// Which fragments, for Send
+    char data[MaxMessageSize];
+};
+
+// Messages on a reliable channel are numbered modulo 2^16; the window
+// is always much smaller than that.
+typedef unsigned short SeqNum;
+
+// The following class defines the header the post office puts after
+// the MailHeader of the messages of a reliable channel.  The last three
+// fields tell the other end about the messages that came the other way.
+
+class SegmentHeader {
+  public:
+    SeqNum seq;			// Number of this message (ChannelData)
+    SeqNum ack;			// Next message expected from the other end
+    unsigned short sack;	// Bit i: message ack + 1 + i arrived too
+    unsigned short window;	// How many more messages we can take
+};
+
+// Largest message on a reliable channel
+#define MaxSegmentSize 	(MaxMailSize - sizeof(SegmentHeader))
+
+// Parameters of the reliable channels; times are in ticks
+#define DefaultWindow 	8	// messages in flight on a channel
+#define MaxWindow 	16	// largest window; bits in SegmentHeader::sack
+#define DupThresh 	3	// a message is taken as lost when this many
+				// sent after it have been acknowledged
+#define InitialTimeout 	(20 * NetworkTime)
+				// retransmission timeout before the first
+				// round trip is measured
+#define MinTimeout 	(20 * NetworkTime)
+#define MaxTimeout 	(500 * NetworkTime)
+#define MaxBackoff 	8	// while messages get through, the timeout
+				// backs off to at most this many times the
+				// one measured, and MaxTimeout
+#define MaxBackedOff 	(5000 * NetworkTime)
+				// and to this while they don't
+#define GiveUpTime 	(1000000 * NetworkTime)
+				// give up on a channel when the other end
+				// hasn't answered for so long (it may not
+				// have started yet)
+#define LingerTime 	(4 * MaxBackedOff)
+				// quiet time before Drain returns
+
 
-     PacketHeader pktHdr;	// Header appended by Network
-     MailHeader mailHdr;	// Header appended by PostOffice
-     char data[MaxMailSize];	// Payload -- message data
+// A message sent on a reliable channel, and kept until it is
+// acknowledged.
+
+class WindowSlot {
+  public:
+    bool inUse;			// not acknowledged yet
+    bool acked;			// acknowledged out of order
+    int size;			// Bytes of the message in this packet
+    int transmissions;		// times sent
+    int sentAt;			// when it was last sent
+    int sendOrder;		// how many packets the channel had sent
+				// when this one was last sent
+    MailHeader mailHdr;
+    char data[MaxSegmentSize];
+};
+
+// The following class defines one end of a reliable channel.  Messages
+// are kept, in both directions, in a ring of MaxWindow slots indexed by
+// their number: the ones we sent, and the Mail of the ones that arrived
+// before those ahead of them.
+
+class Channel {
+  public:
+    Channel(NetworkAddress farAddr, MailBoxAddress farBox,
+	    MailBoxAddress localBox);
+
+    NetworkAddress peer;	// the other end
+    MailBoxAddress peerBox;
+    MailBoxAddress box;		// our end
+
+    SeqNum sendBase;		// oldest message not acknowledged
+    SeqNum nextSeq;		// number of the next message sent
+    int peerWindow;		// messages the other end can take
+    int sends;			// packets sent so far
+    WindowSlot sent[MaxWindow];
+    int heardAt;		// when the other end last answered
+    int ackedAt;		// and last acknowledged a new message
+    int resentAt;		// when the timeout last expired
+    bool broken;		// gave up: the other end doesn't answer
+
+    SeqNum recvBase;		// next message to deliver
+    Mail *received[MaxWindow];	// NULL if it hasn't arrived
+    ReassemblyBuffer *assembly;	// message being put back together
+    Thread *sender;		// thread sending a message in fragments
+    bool windowClosed;		// we told the other end to stop
+
+    int srtt;			// smoothed round trip time
+    int rttvar;			// and its variation
+    int measuredTimeout;	// retransmission timeout from those
+    int timeout;		// the same, backed off if it expired
 };
 
 // The following class defines a single mailbox, or temporary storage
@@ -80,14 +270,20 @@ class MailBox {
     MailBox();			// Allocate and initialize mail box
     ~MailBox();			// De-allocate mail box
 
-    void Put(PacketHeader pktHdr, MailHeader mailHdr, const char *data);
-   				// Atomically put a message into the mailbox
-    void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data); 
-   				// Atomically get a message out of the 
+    void Put(Mail *mail);	// Atomically put a message into the mailbox
+    Mail *Get();		// Atomically get a message out of the 
 				// mailbox (and wait if there is no message 
-				// to get!)
+				// to get!); the caller gives it back to
+				// the pool
+    int NumWaiting() { return waiting; }
+    				// Messages not read yet
+
   private:
-    SynchList<Mail*> *messages;	// A mailbox is just a list of arrived messages
+    Mail *first, *last;		// A mailbox is just a list of arrived
+				// messages, linked through Mail::next
+    int waiting;		// Number of messages in the list
+    Lock *lock;			// protects the list
+    Condition *arrived;		// signalled when a message is put in
 };
 
 // The following class defines a "Post Office", or a collection of 
@@ -111,6 +307,23 @@ class PostOffice {
     				// Send a message to a mailbox on a remote 
 				// machine.  The fromBox in the MailHeader is 
 				// the return box for ack's.
+
+    bool SendReliable(PacketHeader pktHdr, MailHeader mailHdr,
+		      const char *data);
+    				// Send a message on the reliable channel
+				// between the mailboxes in the headers;
+				// wait while the window is full.  Return
+				// false if the other end stopped answering.
+    void Drain();		// Wait until every message sent on a
+				// reliable channel is acknowledged, and
+				// the other ends have gone quiet
+    void SetWindow(int size);	// Messages in flight on a channel
+    void EmulateLinks(const char *linkFile)
+    	{ network->EmulateLinks(linkFile); }
+    				// Send through emulated links (netemu.h)
+    NetworkAddress Address() { return netAddr; }
+    				// This machine's network address
+    bool HasMail(int box);	// Would Receive return right away?
     
     void Receive(int box, PacketHeader *pktHdr, 
 		MailHeader *mailHdr, char *data);
@@ -119,6 +332,8 @@ class PostOffice {
 
     void PostalDelivery();	// Wait for incoming messages, 
 				// and then put them in the correct mailbox
+    void Retransmitter();	// Send again the messages that weren't
+				// acknowledged in time
 
     void PacketSent();		// Interrupt handler, called when outgoing 
 				// packet has been put on network; next 
@@ -127,8 +342,45 @@ class PostOffice {
    				// packet has arrived and can be pulled
 				// off of network (i.e., time to call 
 				// PostalDelivery)
+    void TimerExpired();	// Interrupt handler, called when the
+				// retransmission timer goes off
 
   private:
+    void Transmit(PacketHeader pktHdr, MailHeader mailHdr,
+		  const void *hdr, int hdrSize, const char *data, int size);
+    				// Put a packet on the network, with
+				// "hdr" after the MailHeader
+    Mail *AllocMail();		// A buffer from the pool, or NULL
+    void FreeMail(Mail *mail);	// Give "mail" back to the pool
+    void FragmentArrival(Mail *mail, FragmentHeader fragHdr);
+    				// A fragment of a message sent with Send
+				// has arrived
+    ReassemblyBuffer *GetBuffer(bool expires);
+    				// A free reassembly buffer, or NULL
+    Channel *FindChannel(NetworkAddress farAddr, MailBoxAddress farBox,
+			 MailBoxAddress localBox);
+    				// The channel between the two boxes,
+				// set up if there isn't one yet
+    void FillAck(Channel *ch, SegmentHeader *segHdr);
+    				// What we tell the other end about the
+				// messages it sent us
+    bool SendSegment(Channel *ch, SeqNum seq);
+    				// Send (again) message "seq" of "ch"
+    void SendAck(Channel *ch);	// Send an acknowledgement alone
+    void ChannelArrival(Mail *mail, SegmentHeader segHdr);
+    				// A packet of a channel has arrived
+    void DeliverInOrder(Channel *ch);
+    				// Put the messages of "ch" that are in
+				// order into the mailbox
+    void ProcessAck(Channel *ch, SegmentHeader segHdr,
+		    std::vector<SeqNum> *lost);
+    				// Take note of what the other end got
+    void UpdateTimeout(Channel *ch, int rtt);
+    				// A round trip took "rtt" ticks
+    int FreeSlots(Channel *ch);	// How many more messages we can take
+    void ArmTimer(int fromNow);	// Make sure the timer goes off
+				// within "fromNow" ticks
+
     Network *network;		// Physical network connection
     NetworkAddress netAddr;	// Network address of this machine
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
@@ -136,6 +388,26 @@ class PostOffice {
     Semaphore *messageAvailable;// V'ed when message has arrived from network
     Semaphore *messageSent;	// V'ed when next message can be sent to network
     Lock *sendLock;		// Only one outgoing message at a time
+    Mail *pool;			// Buffers for incoming packets
+    Mail *freeMail;		// The ones not in use, linked
+    int numFree;		// How many of them
+    Lock *poolLock;		// protects "freeMail"
+
+    std::map<int, Channel *> channels;
+    				// reliable channels, by their mailboxes
+    Lock *channelLock;		// protects the channels, and the
+				// reassembly buffers
+    Condition *windowOpen;	// a window has room, or emptied
+    Semaphore *timerExpired;	// V'ed when the timer goes off
+    int timerAt;		// when it goes off; -1 if it isn't set
+    int window;			// messages in flight on a channel
+    int lastHeard;		// when a channel packet last arrived
+
+    ReassemblyBuffer *reassembly;
+    				// messages being put back together
+    unsigned short nextMessageId;
+    				// id of the next message sent in
+				// fragments with Send
 };
 
 #endif
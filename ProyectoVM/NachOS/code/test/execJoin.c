@@ -0,0 +1,22 @@
+#include "syscall.h"
+
+/* Exec and Join a trivial child over and over, to measure process
+ * creation and teardown. Run with "nachos -x ../test/execJoin" and read the
+ * tick count printed at shutdown. */
+#define ITERATIONS 100
+
+int main() {
+  int i;
+  SpaceId child;
+  for (i = 0; i < ITERATIONS; i++) {
+    child = Exec("../test/exitZero");
+    if (child < 0) {
+      Write("execJoin: Exec failed\n", 22, ConsoleOutput);
+      Exit(1);
+    }
+    Join(child);
+  }
+  Write("execJoin: done\n", 15, ConsoleOutput);
+  Exit(0);
+  return 0;
+}
@@ -0,0 +1,6 @@
+#include "syscall.h"
+
+int main() {
+  Exit(0);
+  return 0;
+}
@@ -0,0 +1,65 @@
+/* matmultmap.c
+ *    Matrix multiplication, like matmult, with the matrices in files that
+ *    are mapped into memory: once they are written out, the multiplication
+ *    reads and writes the files with no system calls at all, and the pager
+ *    brings their pages in as needed.
+ *
+ *    Needs the VM kernel.
+ */
+
+#include "syscall.h"
+
+#define Dim 	20	/* the three matrices don't fit in physical memory */
+
+int row[Dim];
+
+/* Append "rows" rows of "value(i, j)" to "file" */
+void WriteRows(OpenFileId file, int rows, int byRow)
+{
+    int i, j;
+
+    for (i = 0; i < rows; i++) {
+	for (j = 0; j < Dim; j++)
+	    row[j] = byRow ? i : j;
+	Write((char *) row, sizeof(row), file);
+    }
+}
+
+int
+main()
+{
+    OpenFileId in, out;
+    int *A, *B, *C;
+    int i, j, k, result;
+
+    Create("matmult.in");		/* A, then B */
+    in = Open("matmult.in");
+    WriteRows(in, Dim, 1);
+    WriteRows(in, Dim, 0);
+    Create("matmult.out");		/* C, all zeros to begin with */
+    out = Open("matmult.out");
+    for (j = 0; j < Dim; j++)
+	row[j] = 0;
+    for (i = 0; i < Dim; i++)
+	Write((char *) row, sizeof(row), out);
+
+    A = (int *) Mmap(in, 2 * Dim * Dim * sizeof(int));
+    C = (int *) Mmap(out, Dim * Dim * sizeof(int));
+    if (A == (int *) -1 || C == (int *) -1) {
+	Write("matmultmap: Mmap failed\n", 24, ConsoleOutput);
+	Exit(-1);
+    }
+    B = A + Dim * Dim;
+
+    for (i = 0; i < Dim; i++)
+	for (j = 0; j < Dim; j++)
+	    for (k = 0; k < Dim; k++)
+		C[i * Dim + j] += A[i * Dim + k] * B[k * Dim + j];
+
+    result = C[Dim * Dim - 1];
+    Munmap((int) A);
+    Munmap((int) C);			/* C is now in matmult.out */
+    Close(in);
+    Close(out);
+    Exit(result);			/* (Dim-1) * (Dim-1) * Dim */
+}
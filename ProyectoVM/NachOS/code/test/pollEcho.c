@@ -0,0 +1,53 @@
+#include "syscall.h"
+
+/* Echo server on port 8080: a single thread serves several clients at
+ * once, with non-blocking sockets, waiting for all of them with Poll */
+#define PORT 8080
+#define MAX_CLIENTS 8
+
+int handles[MAX_CLIENTS + 1];
+int events[MAX_CLIENTS + 1];
+char buffer[128];
+
+int main() {
+  int count, i, n;
+
+  handles[0] = Socket(AF_INET_NachOS, SOCK_STREAM_NachOS);
+  Bind(handles[0], PORT);
+  Listen(handles[0], 5);
+  SetNonBlocking(handles[0], 1);
+  count = 1;
+  for (;;) {
+    for (i = 0; i < count; i++) {
+      events[i] = POLLIN_NachOS;
+    }
+    if (Poll(handles, events, count, -1) < 0) {
+      break;
+    }
+    if ((events[0] & POLLIN_NachOS) && count <= MAX_CLIENTS) {
+      n = Accept(handles[0]);
+      if (n >= 0) {
+        SetNonBlocking(n, 1);
+        handles[count] = n;
+        events[count] = 0;
+        count++;
+      }
+    }
+    for (i = 1; i < count; i++) {
+      if (events[i] == 0) {
+        continue;
+      }
+      n = Read(buffer, sizeof(buffer), handles[i]);
+      if (n > 0) {
+        Write(buffer, n, handles[i]);
+      } else if (n != WOULD_BLOCK_NachOS) {
+        Close(handles[i]);
+        count--;
+        handles[i] = handles[count];
+        events[i] = events[count];
+        i--;
+      }
+    }
+  }
+  Halt();
+}
@@ -0,0 +1,46 @@
+#include "syscall.h"
+
+/* Two threads share a counter behind a reader-writer lock, and meet at a
+ * barrier after every round */
+#define ROUNDS 5
+
+RWLock_t rw;
+Barrier_t barrier;
+int counter;
+
+void Worker() {
+  int i;
+  for (i = 0; i < ROUNDS; i++) {
+    RWLockAcquire(rw, RW_WRITE);
+    counter++;
+    RWLockRelease(rw);
+    BarrierWait(barrier);
+  }
+  Exit(0);
+}
+
+int main() {
+  int i, seen;
+  rw = RWLockCreate(1);
+  barrier = BarrierCreate(2);
+  if (rw < 0 || barrier < 0) {
+    Write("rwBarrierTest: create failed\n", 29, ConsoleOutput);
+    Exit(1);
+  }
+  Fork(Worker);
+  for (i = 0; i < ROUNDS; i++) {
+    BarrierWait(barrier);
+    RWLockAcquire(rw, RW_READ);
+    seen = counter;
+    RWLockRelease(rw);
+    /* the worker may already be one round ahead */
+    if (seen < i + 1 || seen > i + 2) {
+      Write("rwBarrierTest: round mismatch\n", 30, ConsoleOutput);
+      Exit(1);
+    }
+  }
+  RWLockDestroy(rw);
+  BarrierDestroy(barrier);
+  Write("rwBarrierTest: success\n", 23, ConsoleOutput);
+  Exit(0);
+}
@@ -234,6 +234,38 @@ CondBroadCast:
 	j	$31
 	.end CondBroadcast
 
+	.globl RWLockCreate
+	.ent	RWLockCreate
+RWLockCreate:
+	addiu $2,$0,SC_RWLockCreate
+	syscall
+	j	$31
+	.end RWLockCreate
+
+	.globl RWLockDestroy
+	.ent	RWLockDestroy
+RWLockDestroy:
+	addiu $2,$0,SC_RWLockDestroy
+	syscall
+	j	$31
+	.end RWLockDestroy
+
+	.globl RWLockAcquire
+	.ent	RWLockAcquire
+RWLockAcquire:
+	addiu $2,$0,SC_RWLockAcquire
+	syscall
+	j	$31
+	.end RWLockAcquire
+
+	.globl RWLockRelease
+	.ent	RWLockRelease
+RWLockRelease:
+	addiu $2,$0,SC_RWLockRelease
+	syscall
+	j	$31
+	.end RWLockRelease
+
 	.globl Socket
 	.ent	Socket
 Socket:
@@ -282,6 +314,62 @@ Shutdown:
 	j	$31
 	.end Shutdown
 
+	.globl BarrierCreate
+	.ent	BarrierCreate
+BarrierCreate:
+	addiu $2,$0,SC_BarrierCreate
+	syscall
+	j	$31
+	.end BarrierCreate
+
+	.globl BarrierDestroy
+	.ent	BarrierDestroy
+BarrierDestroy:
+	addiu $2,$0,SC_BarrierDestroy
+	syscall
+	j	$31
+	.end BarrierDestroy
+
+	.globl BarrierWait
+	.ent	BarrierWait
+BarrierWait:
+	addiu $2,$0,SC_BarrierWait
+	syscall
+	j	$31
+	.end BarrierWait
+
+	.globl Mmap
+	.ent	Mmap
+Mmap:
+	addiu $2,$0,SC_Mmap
+	syscall
+	j	$31
+	.end Mmap
+
+	.globl Munmap
+	.ent	Munmap
+Munmap:
+	addiu $2,$0,SC_Munmap
+	syscall
+	j	$31
+	.end Munmap
+
+	.globl SetNonBlocking
+	.ent	SetNonBlocking
+SetNonBlocking:
+	addiu $2,$0,SC_SetNonBlocking
+	syscall
+	j	$31
+	.end SetNonBlocking
+
+	.globl Poll
+	.ent	Poll
+Poll:
+	addiu $2,$0,SC_Poll
+	syscall
+	j	$31
+	.end Poll
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -45,6 +45,11 @@ class SocketException : public std::exception {
    * @return A C-style character string describing the exception
    */
   const char* what() const noexcept override;
+  /**
+   * @brief Returns the error code associated with the failure
+   * @return The error code associated with the failure
+   */
+  int errorCode() const noexcept;
 
  private:
   std::string mMessage;   ///< The error message associated with the exception
@@ -57,12 +62,6 @@ class SocketException : public std::exception {
    */
   const std::string& function() const noexcept;
 
-  /**
-   * @brief Returns the error code associated with the failure
-   * @return The error code associated with the failure
-   */
-  int errorCode() const noexcept;
-
   /**
    * @brief Returns a string describing the error
    * @return A string describing the error
@@ -0,0 +1,252 @@
+// intrusivelist.h
+//	Doubly linked lists whose links live inside the items themselves.
+//
+//	List (list.h) allocates a ListElement for every item put on a
+//	list, which is a heap allocation per context switch when the list
+//	is the ready list or a wait queue.  Here the item carries its own
+//	"ListLink", so putting it on or taking it off a list never
+//	allocates, and an item can be removed from the middle of its list
+//	in constant time.
+//
+//	The price is that an item can only be on one list at a time per
+//	ListLink it has.  A thread is on at most one queue at a time (the
+//	ready list, or the queue of whatever it is blocked on), so one
+//	link is enough for threads.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef INTRUSIVELIST_H
+#define INTRUSIVELIST_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The links embedded in an item.  "owner" is the list the item is on,
+// NULL if none; it lets Remove check that the item is really ours.
+
+template <class Item>
+class ListLink {
+  public:
+    ListLink() { prev = next = NULL; owner = NULL; }
+
+    Item *prev;			// previous item, NULL if first
+    Item *next;			// next item, NULL if last
+    const void *owner;		// list we are on, NULL if none
+};
+
+// The list itself.  "link" is the ListLink member of Item used by this
+// list, for instance IntrusiveList<Thread, &Thread::queueLink>.
+
+template <class Item, ListLink<Item> Item::*link>
+class IntrusiveList {
+  public:
+    IntrusiveList();		// initialize the list
+    ~IntrusiveList();		// unlink whatever is left on the list
+
+    void Prepend(Item *item);	// Put item at the beginning of the list
+    void Append(Item *item);	// Put item at the end of the list
+    Item *Remove();		// Take item off the front of the list
+    void Remove(Item *item);	// Take item off the list, wherever it is
+
+    void Apply(void (*func)(Item *));	// Apply "func" to all items
+
+    bool IsEmpty() { return first == NULL; }
+    bool Contains(Item *item) { return (item->*link).owner == this; }
+
+    // Routines to pick the item with the largest key, where the key is
+    // computed when the list is scanned (it may change while on the list)
+    Item *FindMax(int (*keyOf)(Item *));	// Return the first item with
+						// the largest key
+    Item *RemoveMax(int (*keyOf)(Item *));	// Remove it as well
+
+  private:
+    Item *first;		// Head of the list, NULL if list is empty
+    Item *last;			// Last item of list
+};
+
+//----------------------------------------------------------------------
+// IntrusiveList::IntrusiveList
+//	Initialize a list, empty to start with.
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+IntrusiveList<Item, link>::IntrusiveList()
+{
+    first = last = NULL;
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::~IntrusiveList
+//	Unlink the items still on the list, so that they can be put on
+//	another one.  As with List, the items themselves are not
+//	de-allocated.
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+IntrusiveList<Item, link>::~IntrusiveList()
+{
+    while (!IsEmpty())
+	Remove();
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::Append
+//      Append an "item" to the end of the list.  The item must not
+//	be on any list that uses the same link.
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+void
+IntrusiveList<Item, link>::Append(Item *item)
+{
+    ListLink<Item> &l = item->*link;
+
+    ASSERT(l.owner == NULL);
+    l.owner = this;
+    l.prev = last;
+    l.next = NULL;
+    if (last == NULL)
+	first = item;
+    else
+	(last->*link).next = item;
+    last = item;
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::Prepend
+//      Put an "item" on the front of the list.  The item must not
+//	be on any list that uses the same link.
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+void
+IntrusiveList<Item, link>::Prepend(Item *item)
+{
+    ListLink<Item> &l = item->*link;
+
+    ASSERT(l.owner == NULL);
+    l.owner = this;
+    l.prev = NULL;
+    l.next = first;
+    if (first == NULL)
+	last = item;
+    else
+	(first->*link).prev = item;
+    first = item;
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::Remove
+//      Remove the first item from the front of the list.
+//
+// Returns:
+//	Pointer to removed item, NULL if nothing on the list.
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+Item *
+IntrusiveList<Item, link>::Remove()
+{
+    Item *item = first;
+
+    if (item != NULL)
+	Remove(item);
+    return item;
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::Remove
+//      Unlink "item" from the list, in constant time.  The item must
+//	be on this list.
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+void
+IntrusiveList<Item, link>::Remove(Item *item)
+{
+    ListLink<Item> &l = item->*link;
+
+    ASSERT(l.owner == this);
+    if (l.prev == NULL)
+	first = l.next;
+    else
+	(l.prev->*link).next = l.next;
+    if (l.next == NULL)
+	last = l.prev;
+    else
+	(l.next->*link).prev = l.prev;
+    l.prev = l.next = NULL;
+    l.owner = NULL;
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::Apply
+//	Apply a function to each item on the list, front to back.
+//	"func" must not take the item off the list.
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+void
+IntrusiveList<Item, link>::Apply(void (*func)(Item *))
+{
+    for (Item *ptr = first; ptr != NULL; ptr = (ptr->*link).next)
+	func(ptr);
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::FindMax
+//      Find the item with the largest key, without removing it.
+//	Ties are broken in favor of the item closest to the front,
+//	so that items with the same key keep their FIFO order.
+//
+// Returns:
+//	The item found, NULL if nothing on the list.
+//
+//	"keyOf" computes the key of an item (for instance, the
+//		current priority of a thread).
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+Item *
+IntrusiveList<Item, link>::FindMax(int (*keyOf)(Item *))
+{
+    Item *best = first;
+
+    if (best == NULL)
+	return NULL;
+
+    int bestKey = keyOf(best);
+    for (Item *ptr = (first->*link).next; ptr != NULL;
+	 ptr = (ptr->*link).next) {
+	int key = keyOf(ptr);
+	if (key > bestKey) {
+	    best = ptr;
+	    bestKey = key;
+	}
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::RemoveMax
+//      Remove the item with the largest key from the list.  As in
+//	FindMax, ties go to the item closest to the front.
+//
+// Returns:
+//	Pointer to removed item, NULL if nothing on the list.
+//----------------------------------------------------------------------
+
+template <class Item, ListLink<Item> Item::*link>
+Item *
+IntrusiveList<Item, link>::RemoveMax(int (*keyOf)(Item *))
+{
+    Item *best = FindMax(keyOf);
+
+    if (best != NULL)
+	Remove(best);
+    return best;
+}
+
+#endif // INTRUSIVELIST_H
@@ -8,17 +8,25 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
+// Usage: nachos -d <debugflags> -rs <random seed #> -p <slice> -pt <slice>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
-//              -o <other machine id>
-//              -z
+//              -o <other machine id> -ro <other machine id> <count>
+//              -bo <other machine id> <bytes> -mt <machines> <count>
+//              -nw <window> -ne <link file>
+//              -z -pi -fb <count> -rw
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -p <slice> preempts threads every <slice> ticks (timer interrupt)
+//    -pt <slice> preempts threads every <slice> host instructions (ptrace)
 //    -z prints the copyright message
+//    -stats <file> writes statistics and per-thread accounting as JSON
+//    -pi runs the priority inversion test (cf. threadtest.cc)
+//    -fb <count> forks and joins <count> threads, and prints the rate
+//    -rw runs the reader-writer lock and barrier test (cf. threadtest.cc)
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
@@ -30,14 +38,35 @@
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
-//    -l lists the contents of the Nachos directory
+//    -l lists the contents of the Nachos root directory
+//    -ls <nachos dir> lists the contents of a Nachos directory
+//    -md <nachos dir> creates a Nachos directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
+//    -bc <sectors> sets the size of the buffer cache (0 disables it)
+//    -ds <fcfs|sstf|scan|cscan> sets the disk scheduling policy
+//    -tb <tracks> sets how many tracks the disk controller buffers
+//       (0 disables the track buffer)
+//    -nj turns off the metadata journal
+//    -dt compares the disk scheduling policies
+//    -dl <count> times lookups in a directory of <count> files
+//    -ct reads and writes files from several threads at once
+//    -cr <count> times creating and removing <count> files
+//    -df checks what a create failing on a full disk leaves behind
 //
 //  NETWORK
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
 //    -o runs a simple test of the Nachos network software
+//    -ro sends <count> messages each way over a reliable channel, and
+//       prints the goodput
+//    -nw sets how many messages a reliable channel has in flight
+//    -bo sends a message of <bytes> bytes each way, both plain and over
+//       a reliable channel, in fragments if it takes more than a packet
+//    -mt sends <count> messages to each of the other machines, 0 to
+//       <machines> - 1, over reliable channels (cf. network/netbench.sh)
+//    -ne sends the packets through the links described in <link file>
+//       (cf. machine/netemu.h)
 //
 //  NOTE -- flags are ignored until the relevant assignment.
 //  Some of the flags are interpreted here; some in system.cc.
@@ -57,12 +86,23 @@
 // External functions used by this file
 
 void ThreadTest();
+void PriorityInversionTest();
+void ForkJoinBenchmark(int count);
+void RWLockTest();
 void Copy(const char *unixFile, const char *nachosFile);
 void Print(const char *file);
 void PerformanceTest(void);
+void DiskSchedulerTest(void);
+void DirectoryTest(int count);
+void ConcurrencyTest(void);
+void CreateRemoveTest(int count);
+void DiskFullTest(void);
 void StartProcess(const char *file);
 void ConsoleTest(const char *in, const char *out);
 void MailTest(int networkID);
+void ReliableTest(int networkID, int count);
+void BulkTest(int networkID, int size);
+void MeshTest(int nodes, int count);
 
 //----------------------------------------------------------------------
 // main
@@ -95,6 +135,15 @@ main(int argc, char **argv)
 	argCount = 1;
         if (!strcmp(*argv, "-z"))               // print copyright
             printf ("%s",copyright);
+        if (!strcmp(*argv, "-pi"))              // priority inheritance test
+            PriorityInversionTest();
+        if (!strcmp(*argv, "-fb")) {            // fork/join benchmark
+            ASSERT(argc > 1);
+            ForkJoinBenchmark(atoi(*(argv + 1)));
+            argCount = 2;
+        }
+        if (!strcmp(*argv, "-rw"))              // reader-writer lock test
+            RWLockTest();
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-x")) {        	// run a user program
 	    ASSERT(argc > 1);
@@ -127,11 +176,35 @@ main(int argc, char **argv)
 	    fileSystem->Remove(*(argv + 1));
 	    argCount = 2;
 	} else if (!strcmp(*argv, "-l")) {	// list Nachos directory
-            fileSystem->List();
+            fileSystem->List("/");
+	} else if (!strcmp(*argv, "-ls")) {	// list a Nachos directory
+	    ASSERT(argc > 1);
+	    if (!fileSystem->List(*(argv + 1)))
+		printf("No directory %s\n", *(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-md")) {	// make a Nachos directory
+	    ASSERT(argc > 1);
+	    if (!fileSystem->CreateDirectory(*(argv + 1)))
+		printf("Can't create directory %s\n", *(argv + 1));
+	    argCount = 2;
 	} else if (!strcmp(*argv, "-D")) {	// print entire filesystem
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-dt")) {	// disk scheduling test
+            DiskSchedulerTest();
+	} else if (!strcmp(*argv, "-dl")) {	// directory lookup test
+	    ASSERT(argc > 1);
+            DirectoryTest(atoi(*(argv + 1)));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-ct")) {	// concurrent file access test
+            ConcurrencyTest();
+	} else if (!strcmp(*argv, "-cr")) {	// create/remove throughput
+	    ASSERT(argc > 1);
+            CreateRemoveTest(atoi(*(argv + 1)));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-df")) {	// disk full test
+            DiskFullTest();
 	}
 #endif // FILESYS
 #ifdef NETWORK
@@ -142,6 +215,21 @@ main(int argc, char **argv)
 						// start up another nachos
             MailTest(atoi(*(argv + 1)));
             argCount = 2;
+        } else if (!strcmp(*argv, "-ro")) {
+	    ASSERT(argc > 2);
+            Delay(2); 				// as for -o
+            ReliableTest(atoi(*(argv + 1)), atoi(*(argv + 2)));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-bo")) {
+	    ASSERT(argc > 2);
+            Delay(2); 				// as for -o
+            BulkTest(atoi(*(argv + 1)), atoi(*(argv + 2)));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-mt")) {
+	    ASSERT(argc > 2);
+            Delay(2); 				// as for -o
+            MeshTest(atoi(*(argv + 1)), atoi(*(argv + 2)));
+            argCount = 3;
         }
 #endif // NETWORK
     }
@@ -149,7 +149,7 @@ static void ContextSwitch (void)
   // make a context switch if interrupts are enabled
   if ( interrupt->getLevel() == IntOn ) {
     inContextSwitch = false;
-    currentThread->Yield();
+    currentThread->Yield(true);
   } else {
     interrupt->YieldOnReturn();
     inContextSwitch = false;
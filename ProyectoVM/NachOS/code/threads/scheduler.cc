@@ -11,8 +11,10 @@
 //	end up calling FindNextToRun(), and that would put us in an
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	Very simple implementation -- highest priority first, FIFO among
+//	threads of the same priority.  Priorities are looked at when a
+//	thread is picked, so donations (see Lock) take effect even for
+//	threads already on the ready list.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -28,7 +30,7 @@
 // 	Initialize the list of ready but not running threads to empty.
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler() { readyList = new List<Thread *>; }
+Scheduler::Scheduler() { readyList = new ThreadQueue; }
 
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
@@ -49,18 +51,32 @@ void Scheduler::ReadyToRun(Thread *thread) {
   DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
   thread->setStatus(READY);
+  thread->accounting.readySince = stats->totalTicks;
   readyList->Append(thread);
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
-// 	Return the next thread to be scheduled onto the CPU.
+// 	Return the next thread to be scheduled onto the CPU, the one
+//	with the highest effective priority.
 //	If there are no ready threads, return NULL.
 // Side effect:
 //	Thread is removed from the ready list.
 //----------------------------------------------------------------------
 
-Thread *Scheduler::FindNextToRun() { return readyList->Remove(); }
+Thread *Scheduler::FindNextToRun() {
+  return readyList->RemoveMax(ThreadPriority);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PeekNextToRun
+// 	Return the thread FindNextToRun would pick, without removing it
+//	from the ready list.
+//----------------------------------------------------------------------
+
+Thread *Scheduler::PeekNextToRun() {
+  return readyList->FindMax(ThreadPriority);
+}
 
 //----------------------------------------------------------------------
 // Scheduler::Run
@@ -85,8 +101,10 @@ void Scheduler::Run(Thread *nextThread) {
         ->SaveState();  // save the current state of the thread's address space
   }
 #endif
-  oldThread->CheckOverflow();  // check if the old thread had an undetected
-                               // stack overflow
+  // account for the time the next thread waited in the ready queue
+  int waited = stats->totalTicks - nextThread->accounting.readySince;
+  nextThread->accounting.readyTicks += waited;
+  stats->readyWait.Add(waited);
   currentThread = nextThread;  // switch to the next thread
   // change the status of the next thread to 'RUNNING'
   currentThread->setStatus(RUNNING);
@@ -23,6 +23,9 @@
 
 #include "synch.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "copyright.h"
 #include "system.h"
 
@@ -38,7 +41,7 @@ Semaphore::Semaphore(const char* debugName, int initialValue) {
   this->name = new char[strlen(debugName) + 1];
   strcpy(name, debugName);
   this->value = initialValue;
-  this->queue = new List<Thread*>;
+  this->queue = new ThreadQueue;
 }
 
 //----------------------------------------------------------------------
@@ -78,17 +81,25 @@ void Semaphore::P() {
 //	As with P(), this operation must be atomic, so we need to disable
 //	interrupts.  Scheduler::ReadyToRun() assumes that threads
 //	are disabled when it is called.
+//
+//	The waiter with the highest priority is the one woken up.
 //----------------------------------------------------------------------
 
 void Semaphore::V() {
   Thread* thread;
   IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-  thread = queue->Remove();
+  thread = queue->RemoveMax(ThreadPriority);  // highest priority first
   if (thread != NULL)  // make thread ready, consuming the V immediately
     scheduler->ReadyToRun(thread);
   value++;
   interrupt->SetLevel(oldLevel);
+  // let a more important thread run right away, unless we were called
+  // with interrupts off (e.g. from an interrupt handler)
+  if (thread != NULL && oldLevel == IntOn &&
+      thread->getPriority() > currentThread->getPriority()) {
+    currentThread->Yield(true);
+  }
 }
 
 #ifdef USER_PROGRAM
@@ -110,6 +121,14 @@ void Semaphore::Destroy() {
 
 #endif
 
+// Every lock alive, for PrintContention. Never deleted, since the locks
+// owned by global objects are only destroyed at exit.
+typedef IntrusiveList<Lock, &Lock::registryLink> LockList;
+static LockList* AllLocks() {
+  static LockList* locks = new LockList;
+  return locks;
+}
+
 // Dummy functions -- so we can compile our later assignments
 // Note -- without a correct implementation of Condition::Wait(),
 // the test case in the network assignment won't work!
@@ -117,38 +136,144 @@ void Semaphore::Destroy() {
 Lock::Lock(const char* debugName) {
   this->name = new char[strlen(debugName) + 1];
   strcpy(name, debugName);
-  // Create a semaphore with an initial value of 1
-  semaphore = new Semaphore(debugName, 1);
+  // Queue of threads waiting for the lock to become free
+  waitQueue = new ThreadQueue;
   holderThread = NULL;  // No thread owns the lock initially
+  AllLocks()->Append(this);
 }
 // Destructor: Clean up the lock
 Lock::~Lock() {
-  delete semaphore;  // Delete the semaphore associated with the lock
+  AllLocks()->Remove(this);
+  delete waitQueue;  // Delete the queue of waiting threads
+}
+
+// Take the lock if it is free, without disabling interrupts. The exchange
+// is atomic, so this is safe even under the -pt preemptive scheduler.
+bool Lock::TryAcquire() {
+  int expected = FREE;
+  if (!__atomic_compare_exchange_n(&state, &expected, HELD, false,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    return false;
+  }
+  TakeOwnership();
+  return true;
+}
+
+// Record that the current thread holds the lock
+void Lock::TakeOwnership() {
+  holderThread = currentThread;
+  currentThread->AddHeldLock(this);
+}
+
+// Yield a few times, hoping the holder releases the lock meanwhile. This is
+// only worth it if the holder is ready to run: if it is blocked (on the disk,
+// for instance) we would just burn the CPU. Nor if the holder is less
+// important than we are: Yield never gives it the CPU then, and only sleeping
+// lends it our priority. The number of yields adapts to how often spinning
+// paid off on this lock.
+bool Lock::Spin() {
+  for (int i = 0; i < spinLimit; i++) {
+    Thread* holder = holderThread;
+    if (holder == NULL || holder->getStatus() != READY) {
+      break;
+    }
+    if (holder->getPriority() < currentThread->getPriority()) {
+      return false;  // not the lock's fault, leave spinLimit alone
+    }
+    currentThread->Yield();
+    if (TryAcquire()) {
+      if (spinLimit < MAX_SPIN) spinLimit++;
+      return true;
+    }
+  }
+  if (spinLimit > 0) spinLimit--;
+  return false;
 }
 
 // Acquire the lock
 void Lock::Acquire() {
-  // Disable interrupts to make operation atomic
-  IntStatus oldLevel = interrupt->SetLevel(IntOff);
-  // Wait for the semaphore to be available and decrement its value
-  semaphore->P();
-  // Set the current thread as the owner of the lock
-  holderThread = currentThread;
-  interrupt->SetLevel(oldLevel);  // Re-enable interrupts
+  acquires++;
+  if (TryAcquire()) {
+    return;  // fast path, the lock was free
+  }
+  contendedAcquires++;
+  int start = stats->totalTicks;
+  if (!Spin()) {
+    // Disable interrupts to make operation atomic
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    // While someone else owns the lock, lend it our priority and wait. Once
+    // marked CONTENDED, the holder goes through the slow Release below.
+    while (__atomic_exchange_n(&state, CONTENDED, __ATOMIC_ACQUIRE) != FREE) {
+      currentThread->setWaitingLock(this);
+      DonatePriority(currentThread);
+      waitQueue->Append(currentThread);
+      currentThread->Sleep();
+    }
+    currentThread->setWaitingLock(NULL);
+    TakeOwnership();
+    interrupt->SetLevel(oldLevel);  // Re-enable interrupts
+  }
+  waitTicks += stats->totalTicks - start;
 }
 
 // Release the lock
 void Lock::Release() {
-  // Disable interrupts to make operation atomic
-  IntStatus oldLevel = interrupt->SetLevel(IntOff);
   // Check that the current thread owns the lock
   ASSERT(isHeldByCurrentThread());
-  // Clear the owner of the lock
   holderThread = NULL;
-  // Increment the semaphore value and wake up a waiting thread
-  semaphore->V();
-  // if necessary
+  currentThread->RemoveHeldLock(this);
+  if (__atomic_exchange_n(&state, FREE, __ATOMIC_RELEASE) == HELD) {
+    return;  // fast path, nobody waited so nobody donated
+  }
+  // Disable interrupts to make operation atomic
+  IntStatus oldLevel = interrupt->SetLevel(IntOff);
+  // Give back what the waiters donated
+  currentThread->RecomputePriority();
+  // Wake up the most important waiting thread, if any
+  Thread* thread = waitQueue->RemoveMax(ThreadPriority);
+  if (thread != NULL) {
+    scheduler->ReadyToRun(thread);
+  }
   interrupt->SetLevel(oldLevel);  // Re-enable interrupts
+  // If we were only running on borrowed priority, let the waiter go now
+  if (thread != NULL && oldLevel == IntOn &&
+      thread->getPriority() > currentThread->getPriority()) {
+    currentThread->Yield(true);
+  }
+}
+
+// Print the locks with the most waiting time, then the most contended
+// acquires, among the locks still alive
+static std::vector<Lock*> contentionSample;
+static void SampleLock(Lock* lock) { contentionSample.push_back(lock); }
+
+void Lock::PrintContention() {
+  contentionSample.clear();
+  AllLocks()->Apply(SampleLock);
+  std::sort(contentionSample.begin(), contentionSample.end(),
+            [](const Lock* a, const Lock* b) {
+              if (a->waitTicks != b->waitTicks) {
+                return a->waitTicks > b->waitTicks;
+              }
+              if (a->contendedAcquires != b->contendedAcquires) {
+                return a->contendedAcquires > b->contendedAcquires;
+              }
+              return a->acquires > b->acquires;
+            });
+  if (contentionSample.empty() || contentionSample[0]->acquires == 0) {
+    return;
+  }
+  printf("Hottest locks:\n");
+  printf("%-24s %10s %10s %12s\n", "lock", "acquires", "contended",
+         "wait ticks");
+  for (size_t i = 0; i < contentionSample.size() && i < TOP_LOCKS; i++) {
+    Lock* lock = contentionSample[i];
+    if (lock->acquires == 0) {
+      break;
+    }
+    printf("%-24s %10ld %10ld %12ld\n", lock->name, lock->acquires,
+           lock->contendedAcquires, lock->waitTicks);
+  }
 }
 
 // Check if the lock is held by the current thread
@@ -157,11 +282,32 @@ bool Lock::isHeldByCurrentThread() {
   return currentThread == holderThread;
 }
 
+// Donate the priority of "donor" to the holder of this lock. If the holder
+// is blocked on another lock, the donation follows it to that lock's holder,
+// and so on. Interrupts must be disabled.
+void Lock::DonatePriority(Thread* donor) {
+  Lock* lock = this;
+  for (int depth = 0; depth < MAX_DONATION_DEPTH; depth++) {
+    Thread* holder = lock->holderThread;
+    if (holder == NULL || holder->getPriority() >= donor->getPriority()) {
+      break;  // nothing to donate further down the chain
+    }
+    holder->RaisePriority(donor->getPriority());
+    lock = holder->getWaitingLock();
+    if (lock == NULL) {
+      break;  // the holder is not blocked, end of the chain
+    }
+  }
+}
+
+// Return the waiting thread with the highest priority, NULL if none
+Thread* Lock::HighestWaiter() { return waitQueue->FindMax(ThreadPriority); }
+
 // Constructor: Initialize the condition variable with a given debug name
 Condition::Condition(const char* debugName) {
   this->name = new char[strlen(debugName) + 1];
   strcpy(name, debugName);              // Store the debug name
-  this->waitQueue = new List<Thread*>;  // Initialize the wait queue for threads
+  this->waitQueue = new ThreadQueue;  // Initialize the wait queue for threads
 }
 
 // Destructor: Clean up the condition variable
@@ -191,8 +337,8 @@ void Condition::Signal(Lock* conditionLock) {
   // Check that the current
   ASSERT(conditionLock->isHeldByCurrentThread());
   // thread owns the lock
-  // Remove a thread from the wait queue
-  Thread* thread = this->waitQueue->Remove();
+  // Remove the highest priority thread from the wait queue
+  Thread* thread = this->waitQueue->RemoveMax(ThreadPriority);
   if (thread != NULL) {             // If a thread was waiting
     scheduler->ReadyToRun(thread);  // Make the thread ready to run
   }
@@ -208,8 +354,8 @@ void Condition::Broadcast(Lock* conditionLock) {
   ASSERT(conditionLock->isHeldByCurrentThread());
   // Wake up all threads in the wait queue
   Thread* thread;
-  // while there are threads in the wait queue
-  while ((thread = this->waitQueue->Remove()) != NULL) {
+  // while there are threads in the wait queue, most important first
+  while ((thread = this->waitQueue->RemoveMax(ThreadPriority)) != NULL) {
     // Make the thread ready to run
     scheduler->ReadyToRun(thread);
   }
@@ -243,7 +389,8 @@ Barrier::Barrier(const char* debugName, int initCount) {
   strcpy(name, debugName);  // Set the barrier's name for debugging purposes.
   this->threshold = initCount;  // Set the threshold count required for threads
                                 // to pass the barrier.
-  initCount = 0;  // Initialize the current count of waiting threads to 0.
+  this->count = 0;  // Initialize the current count of waiting threads to 0.
+  this->generation = 0;
   // Initialize the condition variable for synchronization.
   this->condition = new Condition(debugName);
   this->lock = new Lock(debugName);  // Initialize the lock for synchronization.
@@ -260,15 +407,154 @@ Barrier::~Barrier() {
 // reached the barrier.
 void Barrier::Wait() {
   this->lock->Acquire();  // Acquire the lock to ensure atomicity.
+  int myGeneration = this->generation;
   this->count++;          // Increment the current count of waiting threads.
   if (this->count < this->threshold) {  // If the threshold has not been
                                         // reached, block the current thread.
-    // Wait on the condition variable, releasing the lock.
-    this->condition->Wait(lock);
+    // Wait on the condition variable, releasing the lock, until our round
+    // is complete. Threads of the next round do not wake us up.
+    while (this->generation == myGeneration) {
+      this->condition->Wait(lock);
+    }
   } else {  // If the threshold has been reached, unblock all waiting threads.
     this->count = 0;  // Reset the count of waiting threads to 0.
+    this->generation++;                // Start the next round.
     this->condition->Broadcast(lock);  // Broadcast the condition variable,
                                        // waking up all waiting threads.
   }
   this->lock->Release();  // Release the lock.
 }
+
+// isInUse: True if some threads reached the barrier and wait for the rest of
+// their round.
+bool Barrier::isInUse() {
+  this->lock->Acquire();
+  bool inUse = this->count > 0;
+  this->lock->Release();
+  return inUse;
+}
+
+// Constructor: Initialize the reader-writer lock, free to start with.
+RWLock::RWLock(const char* debugName, RWLockPolicy rwPolicy) {
+  this->name = new char[strlen(debugName) + 1];
+  strcpy(name, debugName);
+  this->policy = rwPolicy;
+  this->lock = new Lock(debugName);
+  this->readersOk = new Condition(debugName);
+  this->writersOk = new Condition(debugName);
+}
+
+// Destructor: Deallocates the lock and its condition variables.
+RWLock::~RWLock() {
+  ASSERT(readers == 0 && writer == NULL);
+  delete this->readersOk;
+  delete this->writersOk;
+  delete this->lock;
+  delete[] this->name;
+}
+
+// Share the lock with other readers, once no writer holds it or waits for
+// it (unless this reader was let in by the fair policy).
+void RWLock::AcquireRead() {
+  this->lock->Acquire();
+  this->waitingReaders++;
+  while (this->writer != NULL ||
+         (this->waitingWriters > 0 && this->readerBatch == 0)) {
+    this->readersOk->Wait(this->lock);
+  }
+  this->waitingReaders--;
+  if (this->readerBatch > 0) {
+    this->readerBatch--;
+  }
+  this->readers++;
+  this->readerThreads.push_back(currentThread);
+  this->lock->Release();
+}
+
+// Leave the lock, letting a writer in if we were the last reader.
+void RWLock::ReleaseRead() {
+  this->lock->Acquire();
+  ASSERT(this->readers > 0);
+  this->readers--;
+  auto reader = std::find(this->readerThreads.begin(),
+                          this->readerThreads.end(), currentThread);
+  if (reader != this->readerThreads.end()) {
+    this->readerThreads.erase(reader);
+  }
+  if (this->readers == 0 && this->readerBatch == 0 &&
+      this->waitingWriters > 0) {
+    this->writersOk->Signal(this->lock);
+  }
+  this->lock->Release();
+}
+
+// Take the lock for ourselves, once nobody holds it.
+void RWLock::AcquireWrite() {
+  this->lock->Acquire();
+  ASSERT(this->writer != currentThread);  // not recursive
+  this->waitingWriters++;
+  while (this->writer != NULL || this->readers > 0 || this->readerBatch > 0) {
+    this->writersOk->Wait(this->lock);
+  }
+  this->waitingWriters--;
+  this->writer = currentThread;
+  this->lock->Release();
+}
+
+// Leave the lock, and pick who goes next according to the policy.
+void RWLock::ReleaseWrite() {
+  this->lock->Acquire();
+  ASSERT(this->writer == currentThread);
+  this->writer = NULL;
+  if (this->policy == RW_FAIR && this->waitingReaders > 0) {
+    this->readerBatch = this->waitingReaders;
+    this->readersOk->Broadcast(this->lock);
+  } else if (this->waitingWriters > 0) {
+    this->writersOk->Signal(this->lock);
+  } else {
+    this->readersOk->Broadcast(this->lock);
+  }
+  this->lock->Release();
+}
+
+// Release the lock as a writer if we hold it as one, as a reader otherwise.
+void RWLock::Release() {
+  if (isWriteHeldByCurrentThread()) {
+    ReleaseWrite();
+  } else {
+    ReleaseRead();
+  }
+}
+
+// Release the lock if we hold it, in whichever mode; unlike Release, a thread
+// that doesn't hold it gets false instead of breaking the lock.
+bool RWLock::TryRelease() {
+  if (isWriteHeldByCurrentThread()) {
+    ReleaseWrite();
+  } else if (isReadHeldByCurrentThread()) {
+    ReleaseRead();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool RWLock::isWriteHeldByCurrentThread() { return writer == currentThread; }
+
+bool RWLock::isReadHeldByCurrentThread() {
+  this->lock->Acquire();
+  bool held = std::find(this->readerThreads.begin(), this->readerThreads.end(),
+                        currentThread) != this->readerThreads.end();
+  this->lock->Release();
+  return held;
+}
+
+// True if a thread holds the lock or waits for it, so it can't go away yet.
+bool RWLock::isInUse() {
+  this->lock->Acquire();
+  bool inUse = this->readers > 0 || this->writer != NULL ||
+               this->waitingReaders > 0 || this->waitingWriters > 0 ||
+               this->readerBatch > 0;
+  this->lock->Release();
+  return inUse;
+}
@@ -17,8 +17,9 @@
 #ifndef SYNCH_H
 #define SYNCH_H
 
+#include <vector>
+
 #include "copyright.h"
-#include "list.h"
 #include "thread.h"
 
 // The following class defines a "semaphore" whose value is a non-negative
@@ -48,9 +49,9 @@ class Semaphore {
   void V();  // they are both *atomic*
 
  private:
-  char* name;            // useful for debugging
-  int value;             // semaphore value, always >= 0
-  List<Thread*>* queue;  // threads waiting in P() for the value to be > 0
+  char* name;          // useful for debugging
+  int value;           // semaphore value, always >= 0
+  ThreadQueue* queue;  // threads waiting in P() for the value to be > 0
 };
 
 // The following class defines a "lock".  A lock can be BUSY or FREE.
@@ -64,6 +65,17 @@ class Semaphore {
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).
+//
+// Locks implement priority inheritance: a thread waiting in Acquire
+// donates its priority to the holder, and through the lock the holder
+// is itself waiting on, down the whole chain.  Release gives the
+// donations back and wakes the highest priority waiter.
+//
+// An uncontended Acquire or Release is a single atomic exchange on
+// "state", without disabling interrupts (which would also advance the
+// simulated clock).  A contended Acquire first yields a few times, in
+// case the holder is only waiting for the CPU, then blocks.  Every lock
+// counts its acquires and waits; see PrintContention.
 
 class Lock {
  public:
@@ -79,10 +91,41 @@ class Lock {
                                  // checking in Release, and in
                                  // Condition variable ops below.
 
+  void DonatePriority(Thread* donor);  // pass donor's priority to the
+                                       // holder, transitively
+  Thread* HighestWaiter();             // waiter with the top priority
+
+  static void PrintContention();  // print the most contended locks
+
+  ListLink<Lock> registryLink;  // links of the list of every lock
+
  private:
-  char* name;            // for debugging
-  Semaphore* semaphore;  // Semaphore to implement lock
-  Thread* holderThread;  // Thread that acquired the lock
+  // Bound on the length of a donation chain, guards against cycles
+  // (which are deadlocks anyway).
+  static const int MAX_DONATION_DEPTH = 8;
+  // Bound on the yields done by a contended Acquire before blocking
+  static const int MAX_SPIN = 4;
+  // Number of locks shown by PrintContention
+  static const int TOP_LOCKS = 8;
+
+  // Values of "state"
+  static const int FREE = 0;
+  static const int HELD = 1;       // held, nobody blocked on it
+  static const int CONTENDED = 2;  // held, threads may be blocked on it
+
+  bool TryAcquire();     // take the lock if it is FREE
+  void TakeOwnership();  // bookkeeping once the lock is ours
+  bool Spin();           // yield to the holder for a while
+
+  char* name;              // for debugging
+  ThreadQueue* waitQueue;  // threads waiting in Acquire()
+  Thread* holderThread;    // Thread that acquired the lock
+  int state{FREE};         // FREE, HELD or CONTENDED
+  int spinLimit{1};        // yields worth trying, adapted on every spin
+
+  long acquires{0};           // calls to Acquire
+  long contendedAcquires{0};  // ... that found the lock held
+  long waitTicks{0};          // simulated time spent in those
 };
 
 // The following class defines a "condition variable".  A condition
@@ -134,7 +177,7 @@ class Condition {
 
  private:
   char* name;
-  List<Thread*>* waitQueue;  // queue of threads waiting on the condition
+  ThreadQueue* waitQueue;  // queue of threads waiting on the condition
 };
 
 // The following class define a Mutex, a binary semaphore initialized in 1
@@ -154,20 +197,66 @@ class Mutex {
 
 // The following class define a Barrier, each barrier will suspend "count"
 // threads Once the required threads arrive at barrier point, they can continue
+// The barrier can be reused: once a round of threads has passed, the next
+// "count" threads make up a new generation.
 class Barrier {
  public:
   Barrier(const char* debugName, int initCount = 1);
   ~Barrier();
   void Wait();
+  bool isInUse();  // true if threads are waiting at the barrier
 
  private:
   char* name;     // Barrier's name for debugging purposes.
   int threshold;  // Threshold count required for threads to pass the barrier.
   int count;      // Current count of waiting threads.
+  int generation;        // Rounds completed, tells apart spurious wakeups.
   Condition* condition;  // Condition variable for synchronization.
   Lock* lock;            // Lock for synchronization.
+};
 
-  // plus some other stuff you'll need to define
+// Who gets a reader-writer lock next when a writer leaves it
+enum RWLockPolicy {
+  RW_PREFER_WRITERS,  // waiting writers first, readers may starve
+  RW_FAIR             // readers that were waiting, then the next writer
+};
+
+// The following class defines a reader-writer lock: any number of readers
+// may hold it at the same time, or a single writer.
+//
+// New readers never get in while a writer is waiting, so a stream of
+// readers cannot starve the writers.  With RW_FAIR, a writer leaving the
+// lock lets in the readers that queued up behind it before the next writer
+// gets its turn, so writers cannot starve the readers either.
+class RWLock {
+ public:
+  RWLock(const char* debugName, RWLockPolicy policy = RW_PREFER_WRITERS);
+  ~RWLock();
+  char* getName() { return name; }
+
+  void AcquireRead();   // wait until there is no writer, then share
+  void ReleaseRead();   //
+  void AcquireWrite();  // wait until nobody holds the lock, then take it
+  void ReleaseWrite();  //
+  void Release();       // ReleaseWrite or ReleaseRead, whichever applies
+  bool TryRelease();    // Release, false if we don't hold the lock
+
+  bool isWriteHeldByCurrentThread();  // true if we are the writer
+  bool isReadHeldByCurrentThread();   // true if we are one of the readers
+  bool isInUse();                     // true if held or waited for
+
+ private:
+  char* name;
+  RWLockPolicy policy;
+  Lock* lock;               // protects the fields below
+  Condition* readersOk;     // readers wait here
+  Condition* writersOk;     // writers wait here
+  int readers{0};           // readers holding the lock
+  int waitingReaders{0};    // readers blocked in AcquireRead
+  int waitingWriters{0};    // writers blocked in AcquireWrite
+  int readerBatch{0};       // RW_FAIR: readers let in past waiting writers
+  Thread* writer{nullptr};  // writer holding the lock, if any
+  std::vector<Thread*> readerThreads;  // readers holding it, once per hold
 };
 
 #endif  // SYNCH_H
@@ -6,10 +6,37 @@ ThreadTable::ThreadTable() {
 }
 
 ThreadTable::~ThreadTable() {
+  for (Semaphore* semaphore : joinSemaphorePool) {
+    delete semaphore;
+  }
   delete threadMap;
   delete lock;
 }
 
+// Must be called with the table lock held
+Semaphore* ThreadTable::NewJoinSemaphore() {
+  if (joinSemaphorePool.empty()) {
+    return new Semaphore("sem", 0);
+  }
+  Semaphore* semaphore = joinSemaphorePool.back();
+  joinSemaphorePool.pop_back();
+  return semaphore;
+}
+
+// Must be called with the table lock held. A semaphore that was signaled
+// but never waited on still has value 1, so it is not reusable.
+void ThreadTable::RecycleJoinSemaphore(Semaphore* semaphore) {
+  if (semaphore == nullptr) {
+    return;
+  }
+  if (semaphore->getValue() == 0 &&
+      joinSemaphorePool.size() < static_cast<size_t>(MAX_THREADS)) {
+    joinSemaphorePool.push_back(semaphore);
+  } else {
+    delete semaphore;
+  }
+}
+
 int16_t ThreadTable::AddThread(Thread* thread, std::string ExecutableName) {
   lock->Acquire();
   int16_t threadId = threadMap->Find();
@@ -25,7 +52,7 @@ int16_t ThreadTable::AddThread(Thread* thread, std::string ExecutableName) {
     return threadId;
   } else if (kind == USR_EXEC) {
     ThreadData* data =
-        new ThreadData(thread, ExecutableName, 0, new Semaphore("sem", 0));
+        new ThreadData(thread, ExecutableName, 0, NewJoinSemaphore());
     table[threadId] = data;
     lock->Release();
     return threadId;
@@ -50,7 +77,10 @@ int16_t ThreadTable::AddThread(Thread* thread) {
 void ThreadTable::RemoveThread(int16_t threadId) {
   lock->Acquire();
   if (table.find(threadId) != table.end()) {
-    delete table[threadId];
+    ThreadData* data = table[threadId];
+    RecycleJoinSemaphore(data->semToJoinIn);
+    data->semToJoinIn = nullptr;
+    delete data;
     table.erase(threadId);
     threadMap->Clear(threadId);
   }
@@ -88,7 +118,7 @@ bool ThreadTable::IsJoinable(
   // check if the thread is in the table
   if (threadMap->Test(threadId)) {
     // check if the thread is joinable, only usr_exec threads are joinable
-    if (table[threadId]->threadPtr->getKind() == USR_EXEC) {
+    if (table[threadId]->kind == USR_EXEC) {
       lock->Release();
       return true;
     }
@@ -100,6 +130,8 @@ void ThreadTable::setExitStatus(int16_t threadId, int32_t exitStatus) {
   lock->Acquire();
   if (table.find(threadId) != table.end()) {
     table[threadId]->exitStatus = exitStatus;
+    table[threadId]->exited = true;
+    table[threadId]->threadPtr = nullptr;
   }
   lock->Release();
 }
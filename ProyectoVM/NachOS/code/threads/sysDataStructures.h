@@ -2,6 +2,8 @@
 #define SYS_DATA_STRUCTURES_H
 
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "bitmap.h"
 #include "string"
@@ -12,7 +14,13 @@ struct ThreadData {
   std::string ExecutableName{""};
   int32_t exitStatus{0};
   Semaphore* semToJoinIn{nullptr};
+  // the thread itself, nullptr once it has exited: its control block may
+  // already belong to another thread then (see Thread::operator new)
   Thread* threadPtr{nullptr};
+  // kept here so that it is still known after the thread has exited
+  ThreadKind kind{MAIN};
+  // whether exitStatus is final
+  bool exited{false};
 
   ThreadData() {}
   // for exec threads know their executable name, exit status, and semaphore
@@ -21,13 +29,14 @@ struct ThreadData {
       : ExecutableName(ExecName),
         exitStatus(exitStat),
         semToJoinIn(semToJoin),
-        threadPtr(thread) {}
+        threadPtr(thread),
+        kind(thread->getKind()) {}
   // forked threads do not know their executable name, have exit status, and
   // no semaphore
-  ThreadData(Thread* thread) : threadPtr(thread) {}
+  ThreadData(Thread* thread) : threadPtr(thread), kind(thread->getKind()) {}
   // for main thread has executable name but no exit status, and no semaphore
   ThreadData(Thread* thread, std::string ExecName)
-      : ExecutableName(ExecName), threadPtr(thread) {}
+      : ExecutableName(ExecName), threadPtr(thread), kind(thread->getKind()) {}
   ~ThreadData() { delete semToJoinIn; }
 };
 
@@ -42,6 +51,7 @@ class ThreadTable {
   void SetThreadData(int16_t threadId, ThreadData* data);
   bool IsThread(int16_t threadId);
   bool IsJoinable(int16_t threadId);
+  // saves the exit status and forgets the thread, which is about to finish
   void setExitStatus(int16_t threadId, int32_t exitStatus);
   Semaphore* getSemToJoinIn(int16_t threadId);
 
@@ -50,6 +60,13 @@ class ThreadTable {
   BitMap* threadMap;
   std::map<int, ThreadData*> table;
   Lock* lock;
+  /**
+   * @brief Join semaphores of removed threads, reused by the next Exec
+   * instead of allocating a new one. Only semaphores back at 0 are kept.
+   */
+  std::vector<Semaphore*> joinSemaphorePool;
+  Semaphore* NewJoinSemaphore();
+  void RecycleJoinSemaphore(Semaphore* semaphore);
 };
 
 class SysSemaphoreTable {
@@ -68,4 +85,64 @@ class SysSemaphoreTable {
   Lock* lock;
 };
 
+/**
+ * @brief Table of synchronization objects created by user programs (reader-
+ * writer locks, barriers), indexed by the id handed out to the program.
+ * Works like SysSemaphoreTable, without reserved entries.
+ * @details An object is only removed while nobody holds it or waits on it
+ * (its isInUse()). The table shares the objects with the threads using them,
+ * so a thread that looked one up just before it was removed still finds it
+ * in one piece.
+ */
+template <class Object>
+class SysObjectTable {
+ public:
+  explicit SysObjectTable(const char* debugName) {
+    objectMap = new BitMap(MAX_OBJECTS);
+    lock = new Lock(debugName);
+  }
+  ~SysObjectTable() {
+    delete objectMap;
+    delete lock;
+  }
+  /// Add an object, return its id or -1 if the table is full
+  int16_t Add(Object* object) {
+    lock->Acquire();
+    int16_t id = objectMap->Find();
+    if (id != -1) {
+      table[id] = std::shared_ptr<Object>(object);
+    }
+    lock->Release();
+    return id;
+  }
+  /// Remove an object, false if there is no such id or it is in use. It is
+  /// deleted once the threads that looked it up are done with it.
+  bool Remove(int16_t id) {
+    lock->Acquire();
+    auto entry = table.find(id);
+    bool removed = entry != table.end() && !entry->second->isInUse();
+    if (removed) {
+      table.erase(entry);
+      objectMap->Clear(id);
+    }
+    lock->Release();
+    return removed;
+  }
+  /// The object with that id, nullptr if none
+  std::shared_ptr<Object> Get(int16_t id) {
+    lock->Acquire();
+    auto entry = table.find(id);
+    std::shared_ptr<Object> object =
+        entry != table.end() ? entry->second : nullptr;
+    lock->Release();
+    return object;
+  }
+
+ private:
+  static const int16_t MAX_OBJECTS = 40;
+  BitMap* objectMap;
+  std::map<int, std::shared_ptr<Object>> table;
+  Lock* lock;
+};
+
 #endif  // SYS_DATA_STRUCTURES_H
\ No newline at end of file
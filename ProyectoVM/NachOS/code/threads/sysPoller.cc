@@ -0,0 +1,135 @@
+#include "sysPoller.h"
+
+#include "system.h"
+
+/*SYS POLLER*/
+SysPoller::SysPoller() {}
+
+SysPoller::~SysPoller() {
+  // only left if Nachos halts with threads parked
+  for (auto& watch : watched) {
+    delete watch.second;
+  }
+}
+
+int SysPoller::Wait(std::vector<struct pollfd>* fds, int timeout) {
+  int deadline = (timeout < 0) ? -1 : stats->totalTicks + timeout;
+  for (;;) {
+    // poll() also answers for regular files, which epoll refuses; they are
+    // always ready, so they never get parked
+    int ready = poll(fds->data(), fds->size(), 0);
+    for (struct pollfd& pfd : *fds) {
+      if (ready >= 0 && cancelled.count(pfd.fd) > 0) {
+        ready += (pfd.revents == 0) ? 1 : 0;
+        pfd.revents |= POLLNVAL;
+      }
+    }
+    if (ready != 0 || (deadline != -1 && stats->totalTicks >= deadline)) {
+      return ready;
+    }
+    Semaphore wakeUp("poller wait", 0);
+    Waiter waiter = {fds, &wakeUp, nullptr};
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Park(&waiter, (deadline == -1) ? -1 : deadline - stats->totalTicks);
+    interrupt->SetLevel(oldLevel);
+    DEBUG('y', "Thread %s parked on %d descriptors\n", currentThread->getName(),
+          fds->size());
+    wakeUp.P();
+    oldLevel = interrupt->SetLevel(IntOff);
+    Unpark(&waiter);
+    interrupt->SetLevel(oldLevel);
+  }
+}
+
+void SysPoller::WaitFor(int fd, int16_t events) {
+  std::vector<struct pollfd> fds(1);
+  fds[0].fd = fd;
+  fds[0].events = events;
+  this->Wait(&fds, -1);
+}
+
+void SysPoller::Cancel(int fd) {
+  IntStatus oldLevel = interrupt->SetLevel(IntOff);
+  cancelled.insert(fd);
+  for (auto it = waiters.begin(); it != waiters.end();) {
+    Waiter* waiter = *it++;
+    for (struct pollfd& pfd : *waiter->fds) {
+      if (pfd.fd == fd) {
+        Wake(waiter);
+        break;
+      }
+    }
+  }
+  interrupt->SetLevel(oldLevel);
+}
+
+void SysPoller::Forget(int fd) { cancelled.erase(fd); }
+
+void SysPoller::ReadyHandler(void* arg) {
+  Watch* watch = static_cast<Watch*>(arg);
+  SysPoller* poller = watch->poller;
+  // every thread waiting for it tries again; those that still can't go on
+  // park again, and watch it again
+  for (auto it = poller->waiters.begin(); it != poller->waiters.end();) {
+    Waiter* waiter = *it++;
+    for (struct pollfd& pfd : *waiter->fds) {
+      if (pfd.fd == watch->fd) {
+        poller->Wake(waiter);
+        break;
+      }
+    }
+  }
+}
+
+void SysPoller::TimeoutHandler(void* arg) {
+  Timeout* timeout = static_cast<Timeout*>(arg);
+  if (timeout->waiter != nullptr) {
+    timeout->poller->Wake(timeout->waiter);
+  }
+  delete timeout;
+}
+
+void SysPoller::Park(Waiter* waiter, int timeout) {
+  for (struct pollfd& pfd : *waiter->fds) {
+    Watch* watch = watched[pfd.fd];
+    if (watch == nullptr) {
+      watch = new Watch{this, pfd.fd, 0, 0};
+      watched[pfd.fd] = watch;
+    }
+    watch->events |= pfd.events;
+    watch->users++;
+    interrupt->WatchFd(pfd.fd, watch->events, ReadyHandler, watch,
+                       HostPollInt);
+  }
+  if (timeout >= 0) {
+    waiter->timeout = new Timeout{this, waiter};
+    interrupt->Schedule(TimeoutHandler, waiter->timeout,
+                        (timeout > 0) ? timeout : 1, HostPollInt);
+  }
+  waiters.push_back(waiter);
+}
+
+void SysPoller::Unpark(Waiter* waiter) {
+  for (struct pollfd& pfd : *waiter->fds) {
+    auto found = watched.find(pfd.fd);
+    if (found != watched.end() && --found->second->users == 0) {
+      interrupt->UnwatchFd(pfd.fd);
+      delete found->second;
+      watched.erase(found);
+    }
+  }
+  if (waiter->timeout != nullptr) {
+    waiter->timeout->waiter = nullptr;  // its interrupt frees it
+  }
+  waiters.remove(waiter);
+}
+
+void SysPoller::Wake(Waiter* waiter) {
+  for (auto it = waiters.begin(); it != waiters.end(); ++it) {
+    if (*it == waiter) {
+      waiters.erase(it);
+      waiter->wakeUp->V();
+      return;
+    }
+  }
+}
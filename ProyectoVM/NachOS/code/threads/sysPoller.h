@@ -0,0 +1,147 @@
+#ifndef SYS_POLLER_H
+#define SYS_POLLER_H
+/**
+ * @file sysPoller.h
+ * @brief Lets kernel threads wait for host descriptors (the sockets of user
+ * programs, mostly) without stopping the rest of Nachos.
+ * @details Nachos runs on a single host thread, so a thread blocked in a
+ * host read() or accept() blocks every other thread with it. Instead, the
+ * kernel keeps host sockets non-blocking, and a thread that finds one not
+ * ready parks here. The interrupt simulation watches the descriptors of the
+ * parked threads (see Interrupt::WatchFd), and interrupts once one is
+ * ready; then the threads waiting for it wake up and try again. A timeout
+ * is a plain interrupt, scheduled for when the time is up.
+ */
+#include <poll.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "synch.h"
+
+class SysPoller {
+ public:
+  /**
+   * @brief Default constructor.
+   */
+  SysPoller();
+
+  /**
+   * @brief Destructor.
+   */
+  ~SysPoller();
+
+  /**
+   * @brief Waits until one of a set of host descriptors is ready, letting
+   * the other threads run meanwhile.
+   * @param fds - The descriptors, with the events to wait for on each
+   * (POLLIN, POLLOUT); their revents are set to what each one is ready for.
+   * @param timeout - Ticks to wait at most; -1 waits for ever, 0 only checks.
+   * @return How many descriptors are ready, 0 if the time is up, -1 on error.
+   * A descriptor cancelled meanwhile (see Cancel) counts as ready, with
+   * POLLNVAL.
+   */
+  int Wait(std::vector<struct pollfd>* fds, int timeout);
+
+  /**
+   * @brief Waits, for as long as it takes, until a host descriptor is ready.
+   * @param fd - The descriptor.
+   * @param events - What to wait for (POLLIN, POLLOUT).
+   */
+  void WaitFor(int fd, int16_t events);
+
+  /**
+   * @brief Stops every wait for a host descriptor whose handle was closed:
+   * the threads parked on it wake up, and from now on it is reported as
+   * POLLNVAL instead of being waited for. The descriptor itself stays open
+   * until nobody uses it anymore.
+   * @param fd - The descriptor.
+   */
+  void Cancel(int fd);
+
+  /**
+   * @brief Forgets that a descriptor was cancelled, once it is about to be
+   * closed on the host; its number may be reused afterwards.
+   * @param fd - The descriptor.
+   */
+  void Forget(int fd);
+
+ private:
+  struct Timeout;
+
+  /**
+   * @brief A thread parked in Wait.
+   */
+  struct Waiter {
+    std::vector<struct pollfd>* fds;  ///< what it waits for
+    Semaphore* wakeUp;                ///< where it sleeps
+    Timeout* timeout;                 ///< its time limit, or nullptr
+  };
+
+  /**
+   * @brief A descriptor being watched, for one or more waiters.
+   */
+  struct Watch {
+    SysPoller* poller;  ///< this poller
+    int fd;             ///< the descriptor
+    int16_t events;     ///< union of what the waiters want
+    int users;          ///< how many waiters
+  };
+
+  /**
+   * @brief The time limit of a waiter. It stays until its interrupt comes,
+   * even if the waiter is gone by then.
+   */
+  struct Timeout {
+    SysPoller* poller;  ///< this poller
+    Waiter* waiter;     ///< the waiter, nullptr once it is gone
+  };
+
+  /**
+   * @brief Interrupt handler for a descriptor that is ready.
+   * @param watch - The Watch of the descriptor.
+   */
+  static void ReadyHandler(void* watch);
+
+  /**
+   * @brief Interrupt handler for a time limit that is up.
+   * @param timeout - The Timeout.
+   */
+  static void TimeoutHandler(void* timeout);
+
+  /**
+   * @brief Adds "waiter" to the parked threads, and has the interrupt
+   * simulation watch its descriptors. Interrupts must be off.
+   * @param timeout - Ticks to wait at most; -1 waits for ever.
+   */
+  void Park(Waiter* waiter, int timeout);
+
+  /**
+   * @brief Stops watching the descriptors of "waiter" once it is awake.
+   * Interrupts must be off.
+   */
+  void Unpark(Waiter* waiter);
+
+  /**
+   * @brief Wakes "waiter" up, if it is still parked.
+   */
+  void Wake(Waiter* waiter);
+
+  /**
+   * @brief The threads parked, in the order they came.
+   */
+  std::list<Waiter*> waiters;
+
+  /**
+   * @brief The descriptors being watched.
+   */
+  std::map<int, Watch*> watched;
+
+  /**
+   * @brief The descriptors cancelled, and not closed on the host yet.
+   */
+  std::set<int> cancelled;
+};
+#endif
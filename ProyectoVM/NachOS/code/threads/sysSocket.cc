@@ -280,6 +280,28 @@ void sysSocket::sockWrite(const std::string &message) {
   }
 }
 
+int sysSocket::sockWrite(const void *buffer, int bufferSize) {
+  int nBytesWritten = write(this->idSocket, buffer, bufferSize);
+  if (-1 == nBytesWritten) {
+    throw SocketException("Error writing to socket", "Socket::Write", errno);
+  }
+  return nBytesWritten;
+}
+
+void sysSocket::SetNonBlocking(bool nonBlocking) {
+  // the other file status flags are kept as they are
+  int flags = fcntl(this->idSocket, F_GETFL);
+  if (-1 == flags) {
+    throw SocketException("Error getting socket flags",
+                          "Socket::SetNonBlocking", errno);
+  }
+  flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  if (-1 == fcntl(this->idSocket, F_SETFL, flags)) {
+    throw SocketException("Error setting socket flags",
+                          "Socket::SetNonBlocking", errno);
+  }
+}
+
 void sysSocket::Listen(int backlog) {
   int status = -1;
   // mark the socket as passive using system call listen
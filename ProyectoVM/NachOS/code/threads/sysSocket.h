@@ -134,6 +134,24 @@ class sysSocket {
    * @throws SocketException If the write operation fails.
    */
   void sockWrite(const std::string& message) noexcept(false);
+  /**
+   * @brief Writes up to "bufferSize" bytes of "buffer" to the socket, with a
+   * single write system call.
+   * @param const void* buffer the data to write
+   * @param int bufferSize how many bytes to write
+   * @return int number of bytes written, less than bufferSize if the socket
+   *  is non-blocking and there isn't room for all of them
+   * @throws SocketException If the write operation fails.
+   */
+  int sockWrite(const void* buffer, int bufferSize) noexcept(false);
+  /**
+   * @brief Makes the socket non-blocking, or blocking again. Operations on a
+   * non-blocking socket that would have to wait fail with EAGAIN instead
+   * (EINPROGRESS for connect).
+   * @param bool nonBlocking true for non-blocking
+   * @throws SocketException if the mode can't be changed
+   */
+  void SetNonBlocking(bool nonBlocking) noexcept(false);
 
   void Listen(int backlog) noexcept(false);
   /**
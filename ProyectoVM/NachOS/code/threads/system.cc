@@ -9,6 +9,7 @@
 
 #include "copyright.h"
 #include "preemptive.h"
+#include "synch.h"
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -23,7 +24,12 @@ Timer *timer;                 // the hardware timer device,
 
 // 2007, Jose Miguel Santos Espino
 PreemptiveScheduler *preemptiveScheduler = NULL;
-const long long DEFAULT_TIME_SLICE = 50000;
+const long long DEFAULT_TIME_SLICE = 50000;  // host instructions, for -pt
+// Time slice for -p, in simulated ticks. Re-enabling interrupts costs
+// SystemTick, so a shorter slice would fire again inside the Yield it
+// caused, and recurse until the stack overflows.
+const int DEFAULT_TIMER_SLICE = TimerTicks;
+const int MIN_TIMER_SLICE = 2 * SystemTick;
 
 #ifdef FILESYS_NEEDED
 FileSystem *fileSystem;
@@ -31,14 +37,22 @@ FileSystem *fileSystem;
 
 #ifdef FILESYS
 SynchDisk *synchDisk;
+BufferCache *bufferCache;
+Journal *journal;
+OpenFileTable *openFileTable;
 #endif
 
 #ifdef USER_PROGRAM                // requires either FILESYS or FILESYS_STUB
 std::unique_ptr<Machine> machine;  // user program memory and registers
 std::unique_ptr<ThreadTable> threadTable;
 std::unique_ptr<SysSemaphoreTable> sysSemaphoreTable;
+std::unique_ptr<SysObjectTable<RWLock>> sysRWLockTable;
+std::unique_ptr<SysObjectTable<Barrier>> sysBarrierTable;
 std::unique_ptr<BitMap> memBitMap;
-std::unique_ptr<SysSocketTable> sysSocketTable;
+std::unique_ptr<SysPoller> sysPoller;
+#ifdef SYSCALL_TRACE
+std::unique_ptr<SyscallTracer> syscallTracer;
+#endif
 #endif
 #ifdef VM
 std::unique_ptr<MemoryManagementUnit> SdMemController;
@@ -85,11 +99,15 @@ static void TimerInterruptHandler(void *dummy) {
 void Initialize(int argc, char **argv) {
   int argCount;
   const char *debugArgs = "";
+  const char *statsFileName = NULL;
   bool randomYield = false;
 
   // 2007, Jose Miguel Santos Espino
   bool preemptiveScheduling = false;
   long long timeSlice;
+  // time slicing driven by the simulated timer, cheap enough for benchmarks
+  bool timerSlicing = false;
+  int timerSlice = DEFAULT_TIMER_SLICE;
 
 #ifdef USER_PROGRAM
   bool debugUserProg = false;  // single step user program
@@ -97,9 +115,18 @@ void Initialize(int argc, char **argv) {
 #ifdef FILESYS_NEEDED
   bool format = false;  // format disk
 #endif
+#ifdef FILESYS
+  int cacheSectors = DefaultCacheSectors;  // buffer cache size
+  DiskPolicy diskPolicy = DISK_FCFS;       // disk request scheduling
+  bool journaling = true;                  // log metadata updates
+  int trackBuffers = -1;                   // tracks the disk buffers,
+                                           // -1 for the disk's default
+#endif
 #ifdef NETWORK
   double rely = 1;  // network reliability
   int netname = 0;  // UNIX socket name
+  int window = DefaultWindow;  // messages in flight on a reliable channel
+  const char *linkFile = NULL;  // emulated links, cf. netemu.h
 #endif
 
   for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
@@ -111,6 +138,10 @@ void Initialize(int argc, char **argv) {
         debugArgs = *(argv + 1);
         argCount = 2;
       }
+    } else if (!strcmp(*argv, "-stats")) {
+      ASSERT(argc > 1);
+      statsFileName = *(argv + 1);  // dump statistics as JSON at exit
+      argCount = 2;
     } else if (!strcmp(*argv, "-rs")) {
       ASSERT(argc > 1);
       RandomInit(atoi(*(argv + 1)));  // initialize pseudo-random
@@ -118,8 +149,20 @@ void Initialize(int argc, char **argv) {
       randomYield = true;
       argCount = 2;
     }
-    // 2007, Jose Miguel Santos Espino
+    // preempt the running thread every "slice" ticks of simulated time.
+    // The timer interrupt is only taken when interrupts are re-enabled
+    // (or a user instruction executes), which are the safe points.
     else if (!strcmp(*argv, "-p")) {
+      timerSlicing = true;
+      if (argc > 1 && atoi(*(argv + 1)) > 0) {
+        timerSlice = atoi(*(argv + 1));
+        argCount = 2;
+      }
+      if (timerSlice < MIN_TIMER_SLICE) timerSlice = MIN_TIMER_SLICE;
+    }
+    // 2007, Jose Miguel Santos Espino
+    // single step the host process with ptrace, very slow
+    else if (!strcmp(*argv, "-pt")) {
       preemptiveScheduling = true;
       if (argc == 1) {
         timeSlice = DEFAULT_TIME_SLICE;
@@ -134,6 +177,37 @@ void Initialize(int argc, char **argv) {
 #ifdef FILESYS_NEEDED
     if (!strcmp(*argv, "-f")) format = true;
 #endif
+#ifdef FILESYS
+    if (!strcmp(*argv, "-bc")) {
+      ASSERT(argc > 1);
+      cacheSectors = atoi(*(argv + 1));
+      ASSERT(cacheSectors >= 0);
+      argCount = 2;
+    } else if (!strcmp(*argv, "-tb")) {
+      ASSERT(argc > 1);
+      trackBuffers = atoi(*(argv + 1));
+      ASSERT(trackBuffers >= 0 && trackBuffers <= NumTracks);
+      argCount = 2;
+    } else if (!strcmp(*argv, "-nj")) {
+      journaling = false;
+    } else if (!strcmp(*argv, "-ds")) {
+      ASSERT(argc > 1);
+      const char* name = *(argv + 1);
+      if (!strcmp(name, "fcfs")) {
+        diskPolicy = DISK_FCFS;
+      } else if (!strcmp(name, "sstf")) {
+        diskPolicy = DISK_SSTF;
+      } else if (!strcmp(name, "scan")) {
+        diskPolicy = DISK_SCAN;
+      } else if (!strcmp(name, "cscan")) {
+        diskPolicy = DISK_CSCAN;
+      } else {
+        fprintf(stderr, "Unknown disk policy %s\n", name);
+        ASSERT(false);
+      }
+      argCount = 2;
+    }
+#endif
 #ifdef NETWORK
     if (!strcmp(*argv, "-l")) {
       ASSERT(argc > 1);
@@ -143,16 +217,25 @@ void Initialize(int argc, char **argv) {
       ASSERT(argc > 1);
       netname = atoi(*(argv + 1));
       argCount = 2;
+    } else if (!strcmp(*argv, "-nw")) {
+      ASSERT(argc > 1);
+      window = atoi(*(argv + 1));
+      argCount = 2;
+    } else if (!strcmp(*argv, "-ne")) {
+      ASSERT(argc > 1);
+      linkFile = *(argv + 1);
+      argCount = 2;
     }
 #endif
   }
 
   DebugInit(debugArgs);         // initialize DEBUG messages
   stats = new Statistics();     // collect statistics
+  stats->dumpFileName = statsFileName;
   interrupt = new Interrupt;    // start up interrupt handling
   scheduler = new Scheduler();  // initialize the ready queue
-  if (randomYield)              // start the timer (if needed)
-    timer = new Timer(TimerInterruptHandler, 0, randomYield);
+  if (randomYield || timerSlicing)  // start the timer (if needed)
+    timer = new Timer(TimerInterruptHandler, 0, randomYield, timerSlice);
 
   threadToBeDestroyed = NULL;
 
@@ -177,11 +260,23 @@ void Initialize(int argc, char **argv) {
   memBitMap = std::make_unique<BitMap>(NumPhysPages);
   threadTable = std::make_unique<ThreadTable>();
   sysSemaphoreTable = std::make_unique<SysSemaphoreTable>();
-  sysSocketTable = std::make_unique<SysSocketTable>();
+  sysRWLockTable =
+      std::make_unique<SysObjectTable<RWLock>>("RWLock Table Lock");
+  sysBarrierTable =
+      std::make_unique<SysObjectTable<Barrier>>("Barrier Table Lock");
+  sysPoller = std::make_unique<SysPoller>();
+#ifdef SYSCALL_TRACE
+  syscallTracer = std::make_unique<SyscallTracer>();
+#endif
 #endif
 
 #ifdef FILESYS
   synchDisk = new SynchDisk("DISK");
+  synchDisk->SetPolicy(diskPolicy);
+  if (trackBuffers >= 0) synchDisk->SetTrackBuffers(trackBuffers);
+  bufferCache = new BufferCache(synchDisk, cacheSectors);
+  journal = new Journal(synchDisk, journaling);
+  openFileTable = new OpenFileTable();
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -193,6 +288,8 @@ void Initialize(int argc, char **argv) {
 #endif
 #ifdef NETWORK
   postOffice = new PostOffice(netname, rely, 10);
+  postOffice->SetWindow(window);
+  if (linkFile != NULL) postOffice->EmulateLinks(linkFile);
 #endif
 }
 
@@ -210,7 +307,12 @@ void Cleanup() {
   delete postOffice;
 #endif
 
+  Lock::PrintContention();
+
 #ifdef USER_PROGRAM
+#ifdef SYSCALL_TRACE
+  syscallTracer->Report();
+#endif
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -218,6 +320,9 @@ void Cleanup() {
 #endif
 
 #ifdef FILESYS
+  delete openFileTable;
+  delete bufferCache;  // writes back the dirty sectors
+  delete journal;
   delete synchDisk;
 #endif
 
@@ -34,12 +34,18 @@ extern Timer *timer;                 // the hardware alarm clock
 
 #include "machine.h"
 #include "sysDataStructures.h"
-#include "sysSocketLib.h"
+#include "sysPoller.h"
 extern std::unique_ptr<Machine> machine;  // user program memory and registers
 extern std::unique_ptr<ThreadTable> threadTable;
 extern std::unique_ptr<SysSemaphoreTable> sysSemaphoreTable;
+extern std::unique_ptr<SysObjectTable<RWLock>> sysRWLockTable;
+extern std::unique_ptr<SysObjectTable<Barrier>> sysBarrierTable;
 extern std::unique_ptr<BitMap> memBitMap;
-extern std::unique_ptr<SysSocketTable> sysSocketTable;
+extern std::unique_ptr<SysPoller> sysPoller;  // threads waiting for sockets
+#ifdef SYSCALL_TRACE
+#include "syscalltrace.h"
+extern std::unique_ptr<SyscallTracer> syscallTracer;
+#endif
 #endif
 #ifdef VM
 #include "VmDataStructures.h"
@@ -51,8 +57,14 @@ extern FileSystem *fileSystem;
 #endif
 
 #ifdef FILESYS
+#include "bufcache.h"
+#include "filetable.h"
+#include "journal.h"
 #include "synchdisk.h"
 extern SynchDisk *synchDisk;
+extern BufferCache *bufferCache;
+extern Journal *journal;
+extern OpenFileTable *openFileTable;
 #endif
 
 #ifdef NETWORK
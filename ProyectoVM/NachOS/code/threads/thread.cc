@@ -16,14 +16,96 @@
 
 #include "thread.h"
 
+#include <vector>
+
 #include "copyright.h"
 #include "switch.h"
 #include "synch.h"
 #include "system.h"
 
-// this is put at the top of the execution stack,
-// for detecting stack overflows
-const unsigned STACK_FENCEPOST = 0xdeadbeef;
+// Thread control blocks and stacks are recycled, so that Fork/Exec heavy
+// workloads do not go to the heap (and mmap, for stacks) for every thread.
+// At most POOL_LIMIT of each are kept around.
+static const size_t POOL_LIMIT = 32;
+static std::vector<void *> threadPool;
+static std::vector<HostMemoryAddress *> stackPool;
+
+static const int StackBytes = StackSize * sizeof(HostMemoryAddress);
+
+//----------------------------------------------------------------------
+// StackOverflow
+//	Called on a segmentation fault.  If it hit the guard page of the
+//	current thread's stack, say so before dumping core.
+//----------------------------------------------------------------------
+
+static void StackOverflow(const char *address) {
+  if (currentThread != NULL && currentThread->InStackGuard(address)) {
+    fprintf(stderr, "Stack overflow in thread \"%s\"\n",
+            currentThread->getName());
+  }
+}
+
+//----------------------------------------------------------------------
+// NewStack, RecycleStack
+//	Get a guarded stack, from the pool if possible, and give it back.
+//----------------------------------------------------------------------
+
+static HostMemoryAddress *NewStack() {
+  if (!stackPool.empty()) {
+    HostMemoryAddress *stack = stackPool.back();
+    stackPool.pop_back();
+    return stack;
+  }
+  static bool handlerInstalled = false;
+  if (!handlerInstalled) {
+    CallOnSegmentationFault(StackOverflow);
+    handlerInstalled = true;
+  }
+  return (HostMemoryAddress *)AllocGuardedStack(StackBytes);
+}
+
+static void RecycleStack(HostMemoryAddress *stack) {
+  if (stackPool.size() < POOL_LIMIT) {
+    stackPool.push_back(stack);
+  } else {
+    DeallocGuardedStack((char *)stack, StackBytes);
+  }
+}
+
+//----------------------------------------------------------------------
+// Thread::operator new, Thread::operator delete
+//	Take a thread control block from the pool, or give one back.
+//	Only called with interrupts off or from kernel code that cannot
+//	be preempted halfway (the timer only yields at OneTick).
+//	Only blocks the size of a Thread are pooled; a class derived
+//	from Thread gets its blocks from the heap.
+//----------------------------------------------------------------------
+
+void *Thread::operator new(size_t size) {
+  if (size == sizeof(Thread) && !threadPool.empty()) {
+    void *block = threadPool.back();
+    threadPool.pop_back();
+    return block;
+  }
+  return ::operator new(size);
+}
+
+void Thread::operator delete(void *block, size_t size) {
+  if (size == sizeof(Thread) && threadPool.size() < POOL_LIMIT) {
+    threadPool.push_back(block);
+  } else {
+    ::operator delete(block);
+  }
+}
+
+//----------------------------------------------------------------------
+// Thread::InStackGuard
+//	Return true if "address" is in the guard page below our stack.
+//----------------------------------------------------------------------
+
+bool Thread::InStackGuard(const char *address) {
+  return InGuardPage((const char *)stack, address);
+}
 
 //----------------------------------------------------------------------
 // Thread::Thread
@@ -42,6 +124,7 @@ Thread::Thread(const char *threadName) {
 #ifdef USER_PROGRAM
   space = nullptr;
 #endif
+  stats->TrackThread(name, &accounting);
 }
 
 //----------------------------------------------------------------------
@@ -59,8 +142,9 @@ Thread::Thread(const char *threadName) {
 Thread::~Thread() {
   DEBUG('t', "Deleting thread \"%s\"\n", name);
   ASSERT(this != currentThread);
-  if (stack != NULL)
-    DeallocBoundedArray((char *)stack, StackSize * sizeof(HostMemoryAddress));
+  ASSERT(!queueLink.owner);  // still on the ready list or a wait queue
+  stats->RecordThread(name, accounting);
+  if (stack != NULL) RecycleStack(stack);
   DEBUG('t', "Deleting thread \"%s\" done\n", name);
 }
 
@@ -102,27 +186,6 @@ void Thread::Fork(VoidFunctionPtr func, void *arg) {
   interrupt->SetLevel(oldLevel);
 }
 
-//----------------------------------------------------------------------
-// Thread::CheckOverflow
-// 	Check a thread's stack to see if it has overrun the space
-//	that has been allocated for it.  If we had a smarter compiler,
-//	we wouldn't need to worry about this, but we don't.
-//
-// 	NOTE: Nachos will not catch all stack overflow conditions.
-//	In other words, your program may still crash because of an overflow.
-//
-// 	If you get bizarre results (such as seg faults where there is no code)
-// 	then you *may* need to increase the stack size.  You can avoid stack
-// 	overflows by not putting large data structures on the stack.
-// 	Don't do this: void foo() { int bigArray[10000]; ... }
-//----------------------------------------------------------------------
-
-void Thread::CheckOverflow() {
-  if (stack != NULL) {
-    ASSERT(*stack == STACK_FENCEPOST);
-  }
-}
-
 //----------------------------------------------------------------------
 // Thread::Finish
 // 	Called by ThreadRoot when a thread is done executing the
@@ -156,9 +219,14 @@ void Thread::Finish() {
 //	If so, put the thread on the end of the ready list, so that
 //	it will eventually be re-scheduled.
 //
-//	NOTE: returns immediately if no other thread on the ready queue.
-//	Otherwise returns when the thread eventually works its way
-//	to the front of the ready list and gets re-scheduled.
+//	"preempted" is set when the thread did not ask to give up the CPU
+//	(time slice expired, a more important thread woke up), for the
+//	accounting of involuntary context switches.
+//
+//	NOTE: returns immediately if no other thread on the ready queue,
+//	or if all the ready threads have a lower priority.  Otherwise
+//	returns when the thread eventually works its way to the front
+//	of the ready list and gets re-scheduled.
 //
 //	NOTE: we disable interrupts, so that looking at the thread
 //	on the front of the ready list, and switching to it, can be done
@@ -168,7 +236,7 @@ void Thread::Finish() {
 // 	Similar to Thread::Sleep(), but a little different.
 //----------------------------------------------------------------------
 
-void Thread::Yield() {
+void Thread::Yield(bool preempted) {
   Thread *nextThread;
   IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
@@ -176,8 +244,15 @@ void Thread::Yield() {
 
   DEBUG('t', "Yielding thread \"%s\"\n", getName());
 
-  nextThread = scheduler->FindNextToRun();
-  if (nextThread != NULL) {
+  // Only give the CPU to threads at least as important as we are.
+  nextThread = scheduler->PeekNextToRun();
+  if (nextThread != NULL && nextThread->getPriority() >= priority) {
+    nextThread = scheduler->FindNextToRun();
+    if (preempted) {
+      accounting.involuntarySwitches++;
+    } else {
+      accounting.voluntarySwitches++;
+    }
     scheduler->ReadyToRun(this);
     scheduler->Run(nextThread);
   }
@@ -212,6 +287,7 @@ void Thread::Sleep() {
   DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
   status = BLOCKED;
+  accounting.voluntarySwitches++;
   while ((nextThread = scheduler->FindNextToRun()) == NULL) {
     interrupt->Idle();  // no one to run, wait for an interrupt
   }
@@ -232,7 +308,9 @@ static void InterruptEnable() { interrupt->Enable(); }
 
 //----------------------------------------------------------------------
 // Thread::StackAllocate
-//	Allocate and initialize an execution stack.  The stack is
+//	Allocate and initialize an execution stack, recycled from a
+//	finished thread when possible, with a guard page below it (see
+//	AllocGuardedStack) to catch overflows.  The stack is
 //	initialized with an initial stack frame for ThreadRoot, which:
 //		enables interrupts
 //		calls (*func)(arg)
@@ -243,8 +321,7 @@ static void InterruptEnable() { interrupt->Enable(); }
 //----------------------------------------------------------------------
 
 void Thread::StackAllocate(VoidFunctionPtr func, void *arg) {
-  stack = (HostMemoryAddress *)AllocBoundedArray(StackSize *
-                                                 sizeof(HostMemoryAddress));
+  stack = NewStack();
 
   // i386 & MIPS & SPARC stack works from high addresses to low addresses
   stackTop = stack + StackSize - 4;  // -4 to be on the safe side!
@@ -255,8 +332,6 @@ void Thread::StackAllocate(VoidFunctionPtr func, void *arg) {
   // ThreadRoot.
   *(--stackTop) = (HostMemoryAddress)ThreadRoot;
 
-  *stack = STACK_FENCEPOST;
-
   machineState[PCState] = (HostMemoryAddress)ThreadRoot;
   machineState[StartupPCState] = (HostMemoryAddress)InterruptEnable;
   machineState[InitialPCState] = (HostMemoryAddress)func;
@@ -264,6 +339,72 @@ void Thread::StackAllocate(VoidFunctionPtr func, void *arg) {
   machineState[WhenDonePCState] = (HostMemoryAddress)ThreadFinish;
 }
 
+//----------------------------------------------------------------------
+// Thread::setPriority
+//	Change the base priority of the thread.  The effective priority
+//	never drops below what threads waiting on our locks donated, and
+//	if we are ourselves blocked on a lock, the new priority is passed
+//	along to its holder.
+//
+//	"newPriority" is the new base priority, larger is more important.
+//----------------------------------------------------------------------
+
+void Thread::setPriority(int newPriority) {
+  IntStatus oldLevel = interrupt->SetLevel(IntOff);
+  basePriority = newPriority;
+  RecomputePriority();
+  if (waitingLock != nullptr) {
+    waitingLock->DonatePriority(this);
+  }
+  interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Thread::RaisePriority
+//	Receive a priority donation from a thread blocked on a lock we
+//	hold.  Donations only raise the effective priority.
+//----------------------------------------------------------------------
+
+void Thread::RaisePriority(int donated) {
+  if (donated > priority) {
+    DEBUG('s', "Thread \"%s\" priority raised from %d to %d\n", name,
+          priority, donated);
+    priority = donated;
+  }
+}
+
+//----------------------------------------------------------------------
+// Thread::RecomputePriority
+//	Recompute the effective priority from the base priority and the
+//	highest priority waiter of every lock still held.  Called when a
+//	lock is released, so that its donations are given back.
+//----------------------------------------------------------------------
+
+void Thread::RecomputePriority() {
+  int newPriority = basePriority;
+  for (Lock *lock : heldLocks) {
+    Thread *waiter = lock->HighestWaiter();
+    if (waiter != nullptr && waiter->getPriority() > newPriority) {
+      newPriority = waiter->getPriority();
+    }
+  }
+  priority = newPriority;
+}
+
+//----------------------------------------------------------------------
+// Thread::RemoveHeldLock
+//	Forget about a lock this thread no longer holds.
+//----------------------------------------------------------------------
+
+void Thread::RemoveHeldLock(Lock *lock) {
+  for (auto it = heldLocks.begin(); it != heldLocks.end(); ++it) {
+    if (*it == lock) {
+      heldLocks.erase(it);
+      return;
+    }
+  }
+}
+
 #ifdef USER_PROGRAM
 #include "machine.h"
 
@@ -24,7 +24,9 @@
 //	that your thread stacks are too small.)
 //
 //	One thing to try if you find yourself with seg faults is to
-//	increase the size of thread stack -- ThreadStackSize.
+//	increase the size of thread stack -- ThreadStackSize.  Every
+//	stack has an unmapped guard page below it, so an overflow faults
+//	at once and is reported with the name of the thread.
 //
 //  	In this interface, forking a thread takes two steps.
 //	We must first allocate a data structure for it: "t = new Thread".
@@ -37,9 +39,15 @@
 #ifndef THREAD_H
 #define THREAD_H
 
+#include <vector>
+
 #include "copyright.h"
+#include "intrusivelist.h"
+#include "stats.h"
 #include "utility.h"
 
+class Lock;
+
 #ifdef USER_PROGRAM
 #include <memory>
 
@@ -91,15 +99,22 @@ class Thread {
   // basic thread operations
 
   void Fork(VoidFunctionPtr func, void* arg);  // Make thread run (*func)(arg)
-  void Yield();                                // Relinquish the CPU if any
-                                               // other thread is runnable
+  void Yield(bool preempted = false);          // Relinquish the CPU if any
+                                               // other thread is runnable,
+                                               // "preempted" if we are
+                                               // forced to
   void Sleep();                                // Put the thread to sleep and
                                                // relinquish the processor
   void Finish();                               // The thread is done executing
 
-  void CheckOverflow();  // Check if thread has
-                         // overflowed its stack
+  // Thread control blocks are recycled instead of going back to the
+  // heap, see thread.cc
+  static void* operator new(size_t size);
+  static void operator delete(void* block, size_t size);
+
+  bool InStackGuard(const char* address);  // address in our guard page?
   void setStatus(ThreadStatus st) { status = st; }
+  ThreadStatus getStatus() { return status; }
   const char* getName() { return (name); }
   void Print() { printf("%s, ", name); }
   int16_t getThreadId() { return threadId; }
@@ -107,6 +122,22 @@ class Thread {
   int16_t getParentId() { return parentId; }
   void setParentId(int16_t id) { parentId = id; }
 
+  // Priority scheduling. "priority" is the effective priority, the base
+  // priority raised by donations from threads waiting on locks we hold.
+  int getPriority() { return priority; }
+  int getBasePriority() { return basePriority; }
+  void setPriority(int newPriority);   // change the base priority
+  void RaisePriority(int donated);     // accept a priority donation
+  void RecomputePriority();            // drop donations of released locks
+  Lock* getWaitingLock() { return waitingLock; }
+  void setWaitingLock(Lock* lock) { waitingLock = lock; }
+  void AddHeldLock(Lock* lock) { heldLocks.push_back(lock); }
+  void RemoveHeldLock(Lock* lock);
+
+  ThreadStats accounting;  // ticks, faults, syscalls and switches
+  ListLink<Thread> queueLink;  // links for the ready list or the wait
+                               // queue we are on (see ThreadQueue)
+
  private:
   // some of the private data for this class is listed above
 
@@ -117,6 +148,10 @@ class Thread {
   const char* name;
   int16_t threadId;      // thread id
   int16_t parentId{-1};  // parent thread id
+  int basePriority{0};   // priority given by setPriority
+  int priority{0};       // effective priority, >= basePriority
+  Lock* waitingLock{nullptr};     // lock this thread is blocked on, if any
+  std::vector<Lock*> heldLocks;  // locks held, source of donations
 
   void StackAllocate(VoidFunctionPtr func, void* arg);
   // Allocate a stack for thread.
@@ -140,6 +175,14 @@ class Thread {
 #endif
 };
 
+// Queue of threads linked through Thread::queueLink, so that moving a
+// thread between the ready list and wait queues never allocates.
+typedef IntrusiveList<Thread, &Thread::queueLink> ThreadQueue;
+
+// Key function for ThreadQueue::FindMax/RemoveMax, so that queues of threads
+// are served highest priority first.
+inline int ThreadPriority(Thread* thread) { return thread->getPriority(); }
+
 // Magical machine-dependent routines, defined in switch.s
 
 extern "C" {
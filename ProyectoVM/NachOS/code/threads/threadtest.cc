@@ -10,10 +10,12 @@
 // of liability and disclaimer of warranty provisions.
 //
 
+#include <time.h>
 #include <unistd.h>
 
 #include "copyright.h"
 #include "diningph.h"
+#include "synch.h"
 #include "system.h"
 
 DiningPh* dp;
@@ -99,3 +101,245 @@ void ThreadTest() {
 
   SimpleThread((void*)"Hilo 0");
 }
+
+//----------------------------------------------------------------------
+// PriorityInversionTest
+// 	Classic priority inversion: a low priority thread holds a lock
+//	that a high priority thread needs, while medium priority threads
+//	keep the CPU busy.  With priority inheritance the low thread runs
+//	on the high thread's priority, so the high thread only waits for
+//	the critical section and no medium thread runs in the meantime.
+//	A second lock is taken by a middle thread in front of the high
+//	one, to exercise a transitive donation chain.
+//----------------------------------------------------------------------
+
+static const int PI_LOW = 1;
+static const int PI_MEDIUM = 5;
+static const int PI_HIGH = 10;
+static const int PI_MEDIUM_THREADS = 3;
+static const int PI_WORK = 20;  // yields done inside every critical section
+
+static Lock* piOuterLock;        // held by the low thread
+static Lock* piInnerLock;        // held by the chained thread
+static bool piHighBlocked;       // the high thread is waiting
+static int piMediumRuns;         // medium iterations while high waited
+static int piLowSectionTicks;    // length of the low critical section
+static int piHighWaitTicks;      // how long the high thread waited
+
+static void PiMedium(void* arg) {
+  for (int i = 0; i < PI_WORK; i++) {
+    if (piHighBlocked) piMediumRuns++;
+    currentThread->Yield();
+  }
+}
+
+static void PiHigh(void* arg) {
+  int start = stats->totalTicks;
+  piHighBlocked = true;
+  piInnerLock->Acquire();
+  piHighBlocked = false;
+  piHighWaitTicks = stats->totalTicks - start;
+  piInnerLock->Release();
+}
+
+// Holds the inner lock and waits for the outer one, so the high thread
+// donates through it to the low thread.
+static void PiChained(void* arg) {
+  piInnerLock->Acquire();
+  piOuterLock->Acquire();
+  piOuterLock->Release();
+  piInnerLock->Release();
+}
+
+static void PiLow(void* arg) {
+  piOuterLock->Acquire();
+  int start = stats->totalTicks;
+
+  Thread* t = new Thread("pi chained");
+  t->setPriority(PI_MEDIUM);
+  t->Fork(PiChained, NULL);
+  currentThread->Yield();  // the chained thread now blocks on us
+  for (int k = 0; k < PI_MEDIUM_THREADS; k++) {
+    t = new Thread("pi medium");
+    t->setPriority(PI_MEDIUM);
+    t->Fork(PiMedium, NULL);
+  }
+  t = new Thread("pi high");
+  t->setPriority(PI_HIGH);
+  t->Fork(PiHigh, NULL);
+
+  for (int i = 0; i < PI_WORK; i++) {
+    currentThread->Yield();  // medium threads would run here without
+                             // priority inheritance
+  }
+  ASSERT(currentThread->getPriority() == PI_HIGH);
+  piLowSectionTicks = stats->totalTicks - start;
+  piOuterLock->Release();
+  ASSERT(currentThread->getPriority() == PI_LOW);
+}
+
+void PriorityInversionTest() {
+  piOuterLock = new Lock("pi outer");
+  piInnerLock = new Lock("pi inner");
+  piHighBlocked = false;
+  piMediumRuns = 0;
+
+  Thread* low = new Thread("pi low");
+  low->setPriority(PI_LOW);
+  low->Fork(PiLow, NULL);
+
+  // main runs at priority 0, so this returns once everyone is done
+  while (scheduler->PeekNextToRun() != NULL) {
+    currentThread->Yield();
+  }
+
+  printf("Priority inversion test: high thread blocked %d ticks, "
+         "low critical section %d ticks, medium ran %d times meanwhile\n",
+         piHighWaitTicks, piLowSectionTicks, piMediumRuns);
+  ASSERT(piMediumRuns == 0);
+  ASSERT(piHighWaitTicks <= piLowSectionTicks);
+  delete piOuterLock;
+  delete piInnerLock;
+}
+
+//----------------------------------------------------------------------
+// ForkJoinBenchmark
+// 	Fork "count" trivial threads one after the other and wait for each
+//	one to finish, to measure thread creation and teardown.  Since
+//	every thread is gone before the next one is forked, its stack and
+//	control block are recycled by the next Fork.
+//----------------------------------------------------------------------
+
+static Semaphore* fbDone;  // signaled by every benchmark thread
+
+static void FbChild(void* arg) {
+  fbDone->V();
+}
+
+void ForkJoinBenchmark(int count) {
+  fbDone = new Semaphore("fork benchmark", 0);
+  struct timespec start, end;
+  int startTicks = stats->totalTicks;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int i = 0; i < count; i++) {
+    Thread* t = new Thread("fork benchmark");
+    t->Fork(FbChild, NULL);
+    fbDone->P();
+    currentThread->Yield();  // let the child finish and be destroyed
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start.tv_sec) +
+                   (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("Fork/join benchmark: %d threads in %.3f ms (%.0f per second), "
+         "%d ticks\n",
+         count, seconds * 1e3, seconds > 0 ? count / seconds : 0.0,
+         stats->totalTicks - startTicks);
+  delete fbDone;
+}
+
+//----------------------------------------------------------------------
+// RWLockTest
+// 	Readers and writers hammer a reader-writer lock, yielding inside
+//	their critical sections, under both policies.  Checks that a
+//	writer is always alone, and reports how many readers shared the
+//	lock and how many got in past a waiting writer.  Then a few
+//	threads go through a barrier several rounds in a row, checking
+//	that no thread starts a round before every thread finished the
+//	previous one.
+//----------------------------------------------------------------------
+
+static const int RW_READERS = 4;
+static const int RW_WRITERS = 2;
+static const int RW_ROUNDS = 10;
+static const int RW_WORK = 3;  // yields inside every critical section
+
+static RWLock* rwLock;
+static Semaphore* rwDone;
+static int rwActiveReaders, rwActiveWriters, rwWaitingWriters;
+static int rwMaxReaders, rwReadersPastWriter;
+
+static void RwReader(void* arg) {
+  for (int i = 0; i < RW_ROUNDS; i++) {
+    rwLock->AcquireRead();
+    ASSERT(rwActiveWriters == 0);
+    if (rwWaitingWriters > 0) rwReadersPastWriter++;
+    rwActiveReaders++;
+    if (rwActiveReaders > rwMaxReaders) rwMaxReaders = rwActiveReaders;
+    for (int k = 0; k < RW_WORK; k++) currentThread->Yield();
+    rwActiveReaders--;
+    rwLock->ReleaseRead();
+    currentThread->Yield();
+  }
+  rwDone->V();
+}
+
+static void RwWriter(void* arg) {
+  for (int i = 0; i < RW_ROUNDS; i++) {
+    rwWaitingWriters++;
+    rwLock->AcquireWrite();
+    rwWaitingWriters--;
+    ASSERT(rwActiveWriters == 0 && rwActiveReaders == 0);
+    rwActiveWriters++;
+    for (int k = 0; k < RW_WORK; k++) currentThread->Yield();
+    rwActiveWriters--;
+    rwLock->Release();
+    currentThread->Yield();
+  }
+  rwDone->V();
+}
+
+static const int BARRIER_THREADS = 4;
+static Barrier* testBarrier;
+static int barrierRound[BARRIER_THREADS];
+
+static void BarrierThread(void* arg) {
+  long me = (long)arg;
+  for (int r = 1; r <= RW_ROUNDS; r++) {
+    barrierRound[me] = r;
+    testBarrier->Wait();
+    for (int t = 0; t < BARRIER_THREADS; t++) {
+      ASSERT(barrierRound[t] >= r);
+    }
+    for (long k = 0; k < me; k++) currentThread->Yield();
+  }
+  rwDone->V();
+}
+
+void RWLockTest() {
+  static const char* policyNames[] = {"writers first", "fair"};
+  rwDone = new Semaphore("rw done", 0);
+  for (int policy = RW_PREFER_WRITERS; policy <= RW_FAIR; policy++) {
+    rwLock = new RWLock("rw test", (RWLockPolicy)policy);
+    rwActiveReaders = rwActiveWriters = rwWaitingWriters = 0;
+    rwMaxReaders = rwReadersPastWriter = 0;
+    for (int k = 0; k < RW_READERS; k++) {
+      (new Thread("rw reader"))->Fork(RwReader, NULL);
+    }
+    for (int k = 0; k < RW_WRITERS; k++) {
+      (new Thread("rw writer"))->Fork(RwWriter, NULL);
+    }
+    for (int k = 0; k < RW_READERS + RW_WRITERS; k++) {
+      rwDone->P();
+    }
+    printf("RWLock test (%s): up to %d readers at once, %d read "
+           "acquires past a waiting writer\n",
+           policyNames[policy], rwMaxReaders, rwReadersPastWriter);
+    ASSERT(rwMaxReaders > 1);
+    delete rwLock;
+  }
+
+  testBarrier = new Barrier("barrier test", BARRIER_THREADS);
+  for (long k = 0; k < BARRIER_THREADS; k++) {
+    barrierRound[k] = 0;
+    (new Thread("barrier"))->Fork(BarrierThread, (void*)k);
+  }
+  for (int k = 0; k < BARRIER_THREADS; k++) {
+    rwDone->P();
+  }
+  printf("Barrier test: %d threads went through %d rounds\n",
+         BARRIER_THREADS, RW_ROUNDS);
+  delete testBarrier;
+  delete rwDone;
+}
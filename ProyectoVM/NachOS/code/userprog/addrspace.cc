@@ -91,6 +91,7 @@ AddrSpace::AddrSpace(OpenFile *executable) {
   // Calculate the number of pages required by rounding up the size to the
   // nearest page boundary.
   this->numPages = divRoundUp(size, PageSize);
+  this->programPages = numPages;
   // Recalculate the size in case it was rounded up to the nearest page
   // boundary.
   size = numPages * PageSize;
@@ -121,7 +122,9 @@ AddrSpace::AddrSpace(AddrSpace *parentAdrSpace) {
   executableFilename = parentAdrSpace->getExecutable();
   parentId = parentAdrSpace;
   // Copy number of pages and the open files table from parent address space.
-  this->numPages = parentAdrSpace->numPages;
+  // Files the parent mapped are not shared: they come after its stack.
+  this->numPages = parentAdrSpace->programPages;
+  this->programPages = this->numPages;
   // The location of the page in the physical memory.
   u_int32_t pageLocation = 0;
   u_int32_t virtualPageLocation = 0;
@@ -319,9 +322,106 @@ AddrSpace::AddrSpace(AddrSpace *parentAdrSpace) {
 #endif
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space, unmapping the files still mapped.
 //----------------------------------------------------------------------
-AddrSpace::~AddrSpace() { delete pageTable; }
+AddrSpace::~AddrSpace() {
+#ifdef VM
+  unmapAllFiles();
+#endif
+  delete pageTable;
+}
+
+#ifdef VM
+//----------------------------------------------------------------------
+// AddrSpace::mapFile
+// 	Grow the address space by the pages of a file mapping, and remember
+//	which file they come from.  The new pages are not valid, so the
+//	first access to each one faults, and the pager reads it from the
+//	file (cf. MemoryManagementUnit::loadFromMappedFile).
+//----------------------------------------------------------------------
+int32_t AddrSpace::mapFile(int unixHandle, int32_t length) {
+  if (length <= 0) {
+    return -1;
+  }
+  MappedFile file;
+  file.firstPage = numPages;
+  file.numPages = divRoundUp(length, PageSize);
+  file.length = length;
+  file.unixHandle = unixHandle;
+
+  TranslationEntry *newPageTable =
+      new TranslationEntry[numPages + file.numPages];
+  for (u_int32_t i = 0; i < numPages; i++) {
+    newPageTable[i] = pageTable[i];
+  }
+  for (u_int32_t i = numPages; i < numPages + file.numPages; i++) {
+    newPageTable[i].virtualPage = i;
+    newPageTable[i].physicalPage = -1;
+    newPageTable[i].valid = false;
+    newPageTable[i].use = false;
+    newPageTable[i].dirty = false;
+    newPageTable[i].readOnly = false;
+  }
+  delete[] pageTable;
+  pageTable = newPageTable;
+  numPages += file.numPages;
+  mappedFiles.push_back(file);
+  DEBUG('a', "Mapped %d bytes of a file at pages %d to %d\n", length,
+        file.firstPage, numPages - 1);
+  return file.firstPage * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::unmapFile
+// 	Write back the modified pages of the file mapped at "address", and
+//	take all of its pages out of memory.  Its virtual pages stay in the
+//	page table, invalid, unless they were the last ones, so that using
+//	them again is an illegal access (cf. NachOS_PAGE_FAULT_HANDLER).
+//----------------------------------------------------------------------
+bool AddrSpace::unmapFile(int32_t address) {
+  if (address < 0 || address % PageSize != 0) {
+    return false;
+  }
+  for (auto file = mappedFiles.begin(); file != mappedFiles.end(); ++file) {
+    if (file->firstPage * PageSize != static_cast<u_int32_t>(address)) {
+      continue;
+    }
+    SdMemController->releaseMappedFile(this, *file);
+    Close(file->unixHandle);
+    if (file->firstPage + file->numPages == numPages) {
+      numPages = file->firstPage;
+    }
+    mappedFiles.erase(file);
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::unmapAllFiles
+// 	Unmap every file still mapped, last mapped first, writing back
+//	their modified pages.
+//----------------------------------------------------------------------
+void AddrSpace::unmapAllFiles() {
+  while (!mappedFiles.empty()) {
+    unmapFile(mappedFiles.back().firstPage * PageSize);
+  }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::findMappedFile
+// 	Return the file mapped at "virtualPage", or nullptr.
+//----------------------------------------------------------------------
+MappedFile *AddrSpace::findMappedFile(u_int32_t virtualPage) {
+  for (auto &file : mappedFiles) {
+    if (virtualPage >= file.firstPage &&
+        virtualPage < file.firstPage + file.numPages) {
+      return &file;
+    }
+  }
+  return nullptr;
+}
+#endif
 
 //----------------------------------------------------------------------
 // AddrSpace::InitRegisters
@@ -16,6 +16,7 @@
 #include <memory>
 #ifdef VM
 #include <string>
+#include <vector>
 #endif
 
 #include "copyright.h"
@@ -25,6 +26,17 @@
 
 #define UserStackSize 1024  // increase this as necessary!
 
+#ifdef VM
+// A file mapped into an address space by the Mmap system call: its first
+// "length" bytes are pages [firstPage, firstPage + numPages).
+struct MappedFile {
+  u_int32_t firstPage;
+  u_int32_t numPages;
+  int32_t length;
+  int unixHandle;  // our own handle on the file, closed by Munmap
+};
+#endif
+
 class AddrSpace {
  public:
   // share pointer to a open file table
@@ -55,6 +67,27 @@ class AddrSpace {
   u_int32_t getNumPages() { return numPages; }
   void setParentId(AddrSpace *parent) { parentId = parent; }
   AddrSpace *getParentId() { return parentId; }
+  /**
+   * @brief Maps the first "length" bytes of a file after the end of the
+   * address space. Nothing is read yet: the pager reads each page from the
+   * file the first time it is touched.
+   * @param unixHandle Handle on the file, that the address space now owns.
+   * @param length Number of bytes to map.
+   * @return The virtual address of the first byte, -1 on failure.
+   */
+  int32_t mapFile(int unixHandle, int32_t length);
+  /**
+   * @brief Unmaps the file mapped at "address", writing its modified pages
+   * back to it.
+   * @return false if no file is mapped at "address".
+   */
+  bool unmapFile(int32_t address);
+  // Unmaps every file still mapped, when the program exits
+  void unmapAllFiles();
+  // Returns the file mapped at "virtualPage", nullptr if there is none
+  MappedFile *findMappedFile(u_int32_t virtualPage);
+  // Pages of code, data and stack; mapped files come after them
+  u_int32_t getProgramPages() { return programPages; }
 #endif
 
  private:
@@ -67,6 +100,8 @@ class AddrSpace {
   // on demand
   std::string executableFilename;
   AddrSpace *parentId{nullptr};
+  u_int32_t programPages{0};
+  std::vector<MappedFile> mappedFiles;
 #endif
 };
 
@@ -22,13 +22,17 @@
 // of liability and disclaimer of warranty provisions.
 
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 
 #include <cerrno>
+#include <functional>
 #include <iostream>
+#include <vector>
 
 #include "copyright.h"
 #include "syscall.h"
+#include "syscalltrace.h"
 #include "system.h"
 /**
  * @brief Fetches the file name from a given address in the machine's memory.
@@ -130,6 +134,11 @@ void NachOS_Exit() {
   // Use the debug interface to log the exit status of the current thread.
   DEBUG('x', "Thread %s exited with status %d\n", currentThread->getName(),
         exitStatus);
+#ifdef VM
+  // Write the mapped files back now: the address space of the last thread
+  // is never destroyed before Nachos halts
+  currentThread->space->unmapAllFiles();
+#endif
   // If the thread is of type 'USR_EXEC':
   if (Kind == USR_EXEC) {
     // Log that the user thread is exiting.
@@ -337,7 +346,8 @@ void NachOS_Create() {  // System call 4
     } else {
       // If file creation was successful, add the file descriptor to the open
       // files table of the current thread
-      currentThread->openFiles->Open(fileDescriptor);
+      currentThread->openFiles->Open(
+          std::make_shared<FileDescriptor>(fileDescriptor));
     }
     // Release system semaphore after file creation process is complete
     sysSemaphoreTable->GetSemaphore(2)->V();
@@ -382,7 +392,8 @@ void NachOS_Open() {  // System call 5
   DEBUG('o', "Opened file: %s\n", fileName.c_str());
   // Add the file descriptor to the open files table of the current thread,
   // getting the OpenFileId
-  OpenFileId openFileId = currentThread->openFiles->Open(fd);
+  OpenFileId openFileId =
+      currentThread->openFiles->Open(std::make_shared<FileDescriptor>(fd));
   // Check if there was enough space in the Nachos file table
   if (openFileId == -1) {
     // If not enough space, output error message
@@ -428,68 +439,18 @@ void NachOS_Write() {  // System call 7
   DEBUG('o', "Buffer: %s\n", buffer.c_str());
   // Variable to store the number of bytes written
   int32_t bytesWritten = -1;
-  // Check the file descriptor to determine where to write the data
-  switch (fileDescriptor) {
-    case ConsoleInput:
-      // Writing to console input isn't allowed, report error (-1)
-      DEBUG('o', "Writing to console input is not allowed!\n");
-      break;
-    case ConsoleOutput:
-      // Use system semaphore to restrict access to console output (semaphore 0)
-      sysSemaphoreTable->GetSemaphore(0)->P();
-      DEBUG('o', "Writing to console output...\n");
-      // Write the buffer to the console output
-      bytesWritten = write(1, buffer.c_str(), buffer.size());
-      if (bytesWritten == -1) {
-        // If unable to write to console output, report error
-        DEBUG('o', "Error writing to console output!\n");
-        DEBUG('o', "Error: %s\n", strerror(errno));
-      }
-      sysSemaphoreTable->GetSemaphore(0)->V();
-      break;
-    default:
-      // We're writing to a file, print debug message
-      DEBUG('o', "Writing to file %d (NachOS handle)...\n", fileDescriptor);
-      // Check if the file is open
-      if (sysSocketTable->IsSocket(fileDescriptor)) {
-        // If the file descriptor is a socket, write to the socket
-        DEBUG('y', "Writing to socket %d...\n", fileDescriptor);
-        // Write the buffer to the socket
-        sysSocket* socket = sysSocketTable->GetSocket(fileDescriptor);
-        try {
-          socket->sockWrite(buffer);
-          DEBUG('y', "Successfully wrote to socket %d\n", fileDescriptor);
-        } catch (std::exception& e) {
-          DEBUG('y', "Error writing to socket: %s\n", e.what());
-          // Increment the program counter
-          NachOS_IncreasePC();
-          return;
-        }
-      } else if (currentThread->openFiles->isOpened(fileDescriptor)) {
-        // Use system semaphore to restrict access to file (semaphore 1)
-        sysSemaphoreTable->GetSemaphore(1)->P();
-        // Get the UNIX file handle
-        int32_t unixFileHandle =
-            currentThread->openFiles->getUnixHandle(fileDescriptor);
-        // Write the buffer to the UNIX file
-        bytesWritten = write(unixFileHandle, buffer.c_str(), buffer.size());
-        // Debug message for successful file write
-        if (bytesWritten == -1) {
-          DEBUG('o', "Error writing to file %d (UNIX) | %d (NachOS).\n",
-                unixFileHandle, fileDescriptor);
-          DEBUG('o', "Error: %s\n", strerror(errno));
-        } else {
-          DEBUG(
-              'o',
-              "Successfully wrote %d bytes to file %d (UNIX) | %d (NachOS).\n",
-              buffer.size(), unixFileHandle, fileDescriptor);
-        }
-        sysSemaphoreTable->GetSemaphore(1)->V();
-      } else {  // File is not open locally, report error
-        DEBUG('o', "File %d (NachOS handle) is not open!\n", fileDescriptor);
-      }
-      break;
+  // Find what the handle stands for (console, file, socket); it knows how to
+  // write to itself
+  std::shared_ptr<Descriptor> descriptor =
+      currentThread->openFiles->Get(fileDescriptor);
+  if (descriptor == nullptr) {  // File is not open locally, report error
+    DEBUG('o', "File %d (NachOS handle) is not open!\n", fileDescriptor);
+  } else {
+    bytesWritten = descriptor->Write(buffer.data(), buffer.size());
+    DEBUG('o', "Wrote %d bytes to %d (NachOS handle)\n", bytesWritten,
+          fileDescriptor);
   }
+  machine->WriteRegister(2, bytesWritten);
   // Increment the program counter
   NachOS_IncreasePC();
 }
@@ -516,82 +477,23 @@ void NachOS_Read() {  // System call 6
   OpenFileId descriptorFile = machine->ReadRegister(6);
   // Allocate a buffer to temporarily store the data that's read
   char* readBuffer = new char[size + 1];
-  // Check the file descriptor to determine where to read data from
-  switch (descriptorFile) {
-    case ConsoleInput: {
-      // Use semaphore to restrict access to console input (semaphore 3)
-      sysSemaphoreTable->GetSemaphore(3)->P();
-      // Read from the console into the buffer
-      std::string line;
-      std::getline(std::cin, line);
-      line.push_back('\n');
-      // Copy the string into the buffer
-      strncpy(readBuffer, line.c_str(), size);
-      sysSemaphoreTable->GetSemaphore(3)->V();
-      int32_t readChar = 0;
-      // For each character read, write it into user memory at the corresponding
-      // address
-      for (int32_t charPos = 0; charPos < size; charPos++) {
-        if (readBuffer[charPos] == '\n') {
-          break;
-        }
-        // Write the character into user memory
-        machine->WriteMem(bufferAddr + charPos, 1, readBuffer[charPos]);
-        // Increment the number of characters read
-        readChar++;
-      }
-      // Write the number of characters read into register 2
-      machine->WriteRegister(2, readChar);
-      break;
+  // Find what the handle stands for (console, file, socket); it knows how to
+  // read from itself
+  std::shared_ptr<Descriptor> descriptor =
+      currentThread->openFiles->Get(descriptorFile);
+  if (descriptor == nullptr) {
+    // If the file is not open, report error (-1)
+    DEBUG('w', "File %d (NachOS handle) is not open!\n", descriptorFile);
+    machine->WriteRegister(2, -1);
+  } else {
+    int32_t bytesRead = descriptor->Read(readBuffer, size);
+    // For each byte read, write it into user memory at the corresponding
+    // address
+    for (int32_t charPos = 0; charPos < bytesRead; charPos++) {
+      machine->WriteMem(bufferAddr + charPos, 1, readBuffer[charPos]);
     }
-    case ConsoleOutput:
-      // Console output descriptor is not valid for reading, report error (-1)
-      machine->WriteRegister(2, -1);
-      break;
-    default:  // Can read from any other file
-      // check if it is a socket
-      if (sysSocketTable->IsSocket(descriptorFile)) {
-        DEBUG('y', "Reading from socket %d...\n", descriptorFile);
-        sysSocket* socket = sysSocketTable->GetSocket(descriptorFile);
-        try {
-          DEBUG('y', "Reading from socket...\n");
-          int32_t bytesRead = socket->sockRead(readBuffer, size);
-          DEBUG('y', "Read %d bytes from socket\n", bytesRead);
-        } catch (std::exception& e) {
-          DEBUG('y', "Error reading from socket %d: %s\n", descriptorFile,
-                e.what());
-          machine->WriteRegister(2, -1);
-          delete[] readBuffer;
-          NachOS_IncreasePC();
-          return;
-        }
-        for (int i = 0; i < size; i++) {
-          machine->WriteMem(bufferAddr + i, 1, readBuffer[i]);
-        }
-        machine->WriteRegister(2, size);
-        DEBUG('y', "Finished reading from socket\n");
-        //  Check if the file is open
-      } else if (currentThread->openFiles->isOpened(descriptorFile)) {
-        // If the file is open, read from it
-        DEBUG('w', "Reading from local file table %d (NachOS handle)...\n",
-              descriptorFile);
-        // Read from the Unix file into the buffer
-        int32_t bytesRead =
-            read(currentThread->openFiles->getUnixHandle(descriptorFile),
-                 readBuffer, size);
-        // For each byte read, write it into user memory at the corresponding
-        // address
-        for (int32_t charPos = 0; charPos < bytesRead; charPos++) {
-          machine->WriteMem(bufferAddr + charPos, 1, readBuffer[charPos]);
-        }
-        // Write the number of bytes read into register 2
-        machine->WriteRegister(2, bytesRead);
-      } else {
-        // If the file is not open, report error (-1)
-        DEBUG('w', "File %d (NachOS handle) is not open!\n", descriptorFile);
-        machine->WriteRegister(2, -1);
-      }
-      break;
+    // Write the number of bytes read into register 2
+    machine->WriteRegister(2, bytesRead);
   }
   // Free the memory allocated for the buffer
   delete[] readBuffer;
@@ -610,30 +512,13 @@ void NachOS_Close() {  // System call 8
   // Get the OpenFileId from register 4. This is the ID assigned to the open
   // file by the operating system.
   OpenFileId fileId = machine->ReadRegister(4);
-  // check if it is a socket
-  if (sysSocketTable->IsSocket(fileId)) {
-    sysSocketTable->RemoveSocket(fileId);
-    // Check if the file identified by the fileId is open.
-  } else if (currentThread->openFiles->isOpened(fileId)) {
-    // If open, retrieve the corresponding Unix file descriptor
-    int32_t unixFileId = currentThread->openFiles->getUnixHandle(fileId);
-    // Attempt to close the file using the Unix file descriptor.
-    int32_t status = close(unixFileId);
-    // Check if the file was successfully closed.
-    if (status == -1) {
-      // If unsuccessful, log the failure and set return value to -1 to signify
-      // error.
-      DEBUG('c', "Unable to close the file with OpenFileId: %d\n", fileId);
-      machine->WriteRegister(2, -1);
-    } else {
-      // If successful, remove the file's reference from the open files table
-      // and set return value to 0 to signify success.
-      currentThread->openFiles->Close(fileId);
-    }
-  } else {
+  // Take it out of the open files table; the file or socket itself is closed
+  // once no thread is using it anymore
+  if (currentThread->openFiles->Close(fileId) == -1) {
     // If the file is not open, log the failure and set return value to -1 to
     // signify error.
     DEBUG('c', "Unable to close the file with OpenFileId: %d\n", fileId);
+    machine->WriteRegister(2, -1);
   }
   // Increment the program counter.
   NachOS_IncreasePC();
@@ -820,6 +705,94 @@ void NachOS_CondWait() {  // System call 22
 void NachOS_CondBroadcast() {  // System call 23
 }
 
+/**
+ * @brief Creates a reader-writer lock.
+ * @param fair Not zero for the fair policy, writers first otherwise (in
+ * register 4).
+ * @return The lock id in register 2, -1 if there is no room left.
+ */
+void NachOS_RWLockCreate() {  // System call 24
+  int32_t fair = static_cast<int32_t>(machine->ReadRegister(4));
+  RWLock* rwLock =
+      new RWLock("user rwlock", fair ? RW_FAIR : RW_PREFER_WRITERS);
+  int16_t rwId = sysRWLockTable->Add(rwLock);
+  if (rwId == -1) {
+    delete rwLock;
+  }
+  machine->WriteRegister(2, rwId);
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Destroys a reader-writer lock.
+ * @param rwId Identifier of the lock (in register 4).
+ * @return 0 in register 2, -1 if there is no such lock or a thread holds it
+ * or waits for it.
+ */
+void NachOS_RWLockDestroy() {  // System call 25
+  int16_t rwId = static_cast<int16_t>(machine->ReadRegister(4));
+  machine->WriteRegister(2, sysRWLockTable->Remove(rwId) ? 0 : -1);
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Acquires a reader-writer lock.
+ * @param rwId Identifier of the lock (in register 4).
+ * @param mode RW_READ or RW_WRITE (in register 5).
+ * @return 0 in register 2, -1 if there is no such lock or the caller already
+ * holds it for writing (it is not recursive).
+ */
+void NachOS_RWLockAcquire() {  // System call 26
+  int16_t rwId = static_cast<int16_t>(machine->ReadRegister(4));
+  int32_t mode = static_cast<int32_t>(machine->ReadRegister(5));
+  std::shared_ptr<RWLock> rwLock = sysRWLockTable->Get(rwId);
+  if (rwLock == nullptr || rwLock->isWriteHeldByCurrentThread()) {
+    machine->WriteRegister(2, -1);
+  } else {
+    if (mode == RW_WRITE) {
+      rwLock->AcquireWrite();
+    } else {
+      rwLock->AcquireRead();
+    }
+    machine->WriteRegister(2, 0);
+  }
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Releases a reader-writer lock, in the mode it was acquired.
+ * @param rwId Identifier of the lock (in register 4).
+ * @return 0 in register 2, -1 if there is no such lock or the caller doesn't
+ * hold it.
+ */
+void NachOS_RWLockRelease() {  // System call 27
+  int16_t rwId = static_cast<int16_t>(machine->ReadRegister(4));
+  std::shared_ptr<RWLock> rwLock = sysRWLockTable->Get(rwId);
+  if (rwLock == nullptr || !rwLock->TryRelease()) {
+    machine->WriteRegister(2, -1);
+  } else {
+    machine->WriteRegister(2, 0);
+  }
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Adds a socket to the open files of the process. The host socket is
+ * made non-blocking (see SocketDescriptor).
+ * @param socket The socket; it is deleted if it can't be added.
+ * @return Its handle, -1 if it can't be added.
+ */
+static int32_t AddSocket(sysSocket* socket) {
+  try {
+    socket->SetNonBlocking(true);
+  } catch (const SocketException& e) {
+    delete socket;
+    return -1;
+  }
+  return currentThread->openFiles->Open(
+      std::make_shared<SocketDescriptor>(socket));
+}
+
 /**
  *  System call interface: Socket_t Socket( int, int, int)
  */
@@ -839,10 +812,9 @@ void NachOS_Socket() {  // System call 30
     DEBUG('y', "Socket creation failed\n");
     machine->WriteRegister(2, -1);
   }
-  int16_t socketT = sysSocketTable->AddSocket(socket);
+  int32_t socketT = AddSocket(socket);
   if (socketT == -1) {
-    DEBUG('y', "Socket table is full\n");
-    delete socket;
+    DEBUG('y', "Open files table is full\n");
     machine->WriteRegister(2, -1);
   } else {
     DEBUG('y', "Socket table index: %d\n", socketT);
@@ -862,19 +834,27 @@ void NachOS_Connect() {  // System call 31
   std::string host = readFileName(ipAddr);
   int32_t port = static_cast<int32_t>(machine->ReadRegister(6));
   DEBUG('y', "Socket table index: %d\n", socketT);
-  sysSocket* socket = sysSocketTable->GetSocket(socketT);
+  std::shared_ptr<SocketDescriptor> descriptor =
+      currentThread->openFiles->GetSocket(socketT);
+  sysSocket* socket = (descriptor != nullptr) ? descriptor->Socket() : nullptr;
   if (socket == nullptr) {
     DEBUG('y', "Socket not found\n");
     machine->WriteRegister(2, -1);
   } else {
     DEBUG('y', "Socket found\n");
-    try {
-      socket->Connect(host.c_str(), port);
-      DEBUG('y', "Socket connection successful\n");
-    } catch (const std::exception& e) {
-      DEBUG('y', "Socket connection failed\n");
-      machine->WriteRegister(2, -1);
-    }
+    // Once the connection is on its way, connecting again tells how it went
+    int32_t status = descriptor->Operation(POLLOUT, [&] {
+      try {
+        socket->Connect(host.c_str(), port);
+      } catch (const SocketException& e) {
+        if (e.errorCode() != EISCONN) {
+          throw;
+        }
+      }
+      return 0;
+    });
+    DEBUG('y', "Socket connection status: %d\n", status);
+    machine->WriteRegister(2, status);
   }
   NachOS_IncreasePC();
 }
@@ -887,7 +867,9 @@ void NachOS_Bind() {  // System call 32
   int16_t socketT = static_cast<int16_t>(machine->ReadRegister(4));
   int32_t port = static_cast<int32_t>(machine->ReadRegister(5));
   DEBUG('y', "Socket table index: %d\n", socketT);
-  sysSocket* socket = sysSocketTable->GetSocket(socketT);
+  std::shared_ptr<SocketDescriptor> descriptor =
+      currentThread->openFiles->GetSocket(socketT);
+  sysSocket* socket = (descriptor != nullptr) ? descriptor->Socket() : nullptr;
   if (socket == nullptr) {
     DEBUG('y', "Socket not found\n");
     machine->WriteRegister(2, -1);
@@ -912,7 +894,9 @@ void NachOS_Listen() {  // System call 33
   int16_t socketT = static_cast<int16_t>(machine->ReadRegister(4));
   int32_t backlog = static_cast<int32_t>(machine->ReadRegister(5));
   DEBUG('y', "Socket table index: %d\n", socketT);
-  sysSocket* socket = sysSocketTable->GetSocket(socketT);
+  std::shared_ptr<SocketDescriptor> descriptor =
+      currentThread->openFiles->GetSocket(socketT);
+  sysSocket* socket = (descriptor != nullptr) ? descriptor->Socket() : nullptr;
   if (socket == nullptr) {
     DEBUG('y', "Socket not found\n");
     machine->WriteRegister(2, -1);
@@ -936,28 +920,32 @@ void NachOS_Accept() {  // System call 34
   DEBUG('y', "AcceptSyscall\n");
   int serverSocketT = static_cast<int16_t>(machine->ReadRegister(4));
   DEBUG('y', "Socket table index: %d\n", serverSocketT);
-  sysSocket* serverSocket = sysSocketTable->GetSocket(serverSocketT);
+  std::shared_ptr<SocketDescriptor> descriptor =
+      currentThread->openFiles->GetSocket(serverSocketT);
+  sysSocket* serverSocket = (descriptor != nullptr) ? descriptor->Socket() : nullptr;
   sysSocket* clientSocket = nullptr;
   if (serverSocket == nullptr) {
     DEBUG('y', "Socket not found\n");
     machine->WriteRegister(2, -1);
   } else {
     DEBUG('y', "Socket found\n");
-    try {
+    int32_t status = descriptor->Operation(POLLIN, [&] {
       clientSocket = serverSocket->Accept();
+      return 0;
+    });
+    if (status != 0) {
+      DEBUG('y', "Socket accept failed: %d\n", status);
+      machine->WriteRegister(2, status);
+    } else {
       DEBUG('y', "Socket accept successful\n");
-      int16_t clientSocketT = sysSocketTable->AddSocket(clientSocket);
+      int32_t clientSocketT = AddSocket(clientSocket);
       if (clientSocketT == -1) {
-        DEBUG('y', "Socket table is full\n");
-        delete clientSocket;
+        DEBUG('y', "Open files table is full\n");
         machine->WriteRegister(2, -1);
       } else {
         DEBUG('y', "Socket table index: %d\n", clientSocketT);
         machine->WriteRegister(2, clientSocketT);
       }
-    } catch (const std::exception& e) {
-      DEBUG('y', "Socket accept failed\n");
-      machine->WriteRegister(2, -1);
     }
   }
   NachOS_IncreasePC();
@@ -970,7 +958,9 @@ void NachOS_Shutdown() {  // System call 25
   int16_t socketT = static_cast<int16_t>(machine->ReadRegister(4));
   int32_t how = static_cast<int32_t>(machine->ReadRegister(5));
   DEBUG('y', "Socket table index: %d\n", socketT);
-  sysSocket* socket = sysSocketTable->GetSocket(socketT);
+  std::shared_ptr<SocketDescriptor> descriptor =
+      currentThread->openFiles->GetSocket(socketT);
+  sysSocket* socket = (descriptor != nullptr) ? descriptor->Socket() : nullptr;
   if (socket == nullptr) {
     DEBUG('y', "Socket not found\n");
     machine->WriteRegister(2, -1);
@@ -985,15 +975,215 @@ void NachOS_Shutdown() {  // System call 25
   }
   NachOS_IncreasePC();
 }
+
+/**
+ *  System call interface: int SetNonBlocking( Socket_t, int )
+ */
+void NachOS_SetNonBlocking() {  // System call 41
+  int16_t socketT = static_cast<int16_t>(machine->ReadRegister(4));
+  bool nonBlocking = machine->ReadRegister(5) != 0;
+  DEBUG('y', "Socket table index: %d, non-blocking: %d\n", socketT,
+        nonBlocking);
+  std::shared_ptr<SocketDescriptor> descriptor =
+      currentThread->openFiles->GetSocket(socketT);
+  if (descriptor == nullptr) {
+    DEBUG('y', "Socket not found\n");
+    machine->WriteRegister(2, -1);
+  } else {
+    descriptor->SetNonBlocking(nonBlocking);
+    machine->WriteRegister(2, 0);
+  }
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Most handles a single Poll can wait on.
+ */
+static const int32_t MAX_POLL_HANDLES = 64;
+
+/**
+ * @brief Waits until one of several handles is ready, or the time is up. The
+ * calling thread parks in the poller, so the other threads keep running.
+ * System call interface: int Poll( int *, int *, int, int )
+ * @param register 4 the address of the handles.
+ * @param register 5 the address of the events to wait for on each one;
+ * the events each one is ready for are written back there. A handle another
+ * thread closes meanwhile comes back with POLLERR_NachOS.
+ * @param register 6 how many handles there are.
+ * @param register 7 ticks to wait at most, -1 for ever, 0 for none.
+ * @return How many handles are ready in register 2, 0 if the time is up,
+ * -1 on error.
+ */
+void NachOS_Poll() {  // System call 42
+  int32_t handlesAddr = machine->ReadRegister(4);
+  int32_t eventsAddr = machine->ReadRegister(5);
+  int32_t count = machine->ReadRegister(6);
+  int32_t timeout = machine->ReadRegister(7);
+  DEBUG('y', "PollSyscall- %d handles, timeout %d\n", count, timeout);
+  if (count < 0 || count > MAX_POLL_HANDLES) {
+    machine->WriteRegister(2, -1);
+    NachOS_IncreasePC();
+    return;
+  }
+  std::vector<struct pollfd> fds(count);
+  // Keep the descriptors until the wait is over, so that their host
+  // descriptors stay open even if another thread closes the handles
+  std::vector<std::shared_ptr<Descriptor>> descriptors(count);
+  int32_t buffered = 0;  // console lines read ahead by std::cin
+  for (int32_t i = 0; i < count; i++) {
+    int32_t handle = 0, events = 0;
+    machine->ReadMem(handlesAddr + i * 4, 4, &handle);
+    machine->ReadMem(eventsAddr + i * 4, 4, &events);
+    descriptors[i] = currentThread->openFiles->Get(handle);
+    if (descriptors[i] == nullptr) {
+      DEBUG('y', "Handle %d is not open\n", handle);
+      machine->WriteRegister(2, -1);
+      NachOS_IncreasePC();
+      return;
+    }
+    fds[i].fd = descriptors[i]->HostHandle();
+    fds[i].events = ((events & POLLIN_NachOS) ? POLLIN : 0) |
+                    ((events & POLLOUT_NachOS) ? POLLOUT : 0);
+    if (handle == ConsoleInput && (events & POLLIN_NachOS) &&
+        std::cin.rdbuf()->in_avail() > 0) {
+      buffered++;
+    }
+  }
+  int32_t ready = sysPoller->Wait(&fds, buffered > 0 ? 0 : timeout);
+  for (int32_t i = 0; ready >= 0 && i < count; i++) {
+    int32_t handle = 0, revents = 0;
+    machine->ReadMem(handlesAddr + i * 4, 4, &handle);
+    if (fds[i].revents & POLLIN) revents |= POLLIN_NachOS;
+    if (fds[i].revents & POLLOUT) revents |= POLLOUT_NachOS;
+    if (fds[i].revents & (POLLERR | POLLNVAL)) revents |= POLLERR_NachOS;
+    if (fds[i].revents & POLLHUP) revents |= POLLHUP_NachOS;
+    if (handle == ConsoleInput && revents == 0 && buffered > 0 &&
+        std::cin.rdbuf()->in_avail() > 0) {
+      revents = POLLIN_NachOS;
+      ready++;
+    }
+    machine->WriteMem(eventsAddr + i * 4, 4, revents);
+  }
+  DEBUG('y', "Poll: %d handles ready\n", ready);
+  machine->WriteRegister(2, ready);
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Creates a barrier.
+ * @param count Threads that must reach the barrier to pass it (in register
+ * 4).
+ * @return The barrier id in register 2, -1 on failure.
+ */
+void NachOS_BarrierCreate() {  // System call 36
+  int32_t count = static_cast<int32_t>(machine->ReadRegister(4));
+  int16_t barrierId = -1;
+  if (count > 0) {
+    Barrier* barrier = new Barrier("user barrier", count);
+    barrierId = sysBarrierTable->Add(barrier);
+    if (barrierId == -1) {
+      delete barrier;
+    }
+  }
+  machine->WriteRegister(2, barrierId);
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Destroys a barrier.
+ * @param barrierId Identifier of the barrier (in register 4).
+ * @return 0 in register 2, -1 if there is no such barrier or threads are
+ * waiting at it.
+ */
+void NachOS_BarrierDestroy() {  // System call 37
+  int16_t barrierId = static_cast<int16_t>(machine->ReadRegister(4));
+  machine->WriteRegister(2, sysBarrierTable->Remove(barrierId) ? 0 : -1);
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Waits until the whole round of threads reaches the barrier.
+ * @param barrierId Identifier of the barrier (in register 4).
+ * @return 0 in register 2, -1 if there is no such barrier.
+ */
+void NachOS_BarrierWait() {  // System call 38
+  int16_t barrierId = static_cast<int16_t>(machine->ReadRegister(4));
+  std::shared_ptr<Barrier> barrier = sysBarrierTable->Get(barrierId);
+  if (barrier == nullptr) {
+    machine->WriteRegister(2, -1);
+  } else {
+    barrier->Wait();
+    machine->WriteRegister(2, 0);
+  }
+  NachOS_IncreasePC();
+}
+/**
+ * @brief Maps an open file into the address space of the caller, after its
+ * stack. The pages are read from the file when they are first touched, and
+ * the modified ones are written back to it, not to the swap. Needs VM.
+ * System call interface: int Mmap(OpenFileId id, int length)
+ * @param register 4 contains the OpenFileId of the file.
+ * @param register 5 contains how many bytes of the file to map.
+ * @return The address of the first byte in register 2, -1 on failure.
+ */
+void NachOS_Mmap() {  // System call 39
+  int32_t address = -1;
+#ifdef VM
+  OpenFileId fileId = machine->ReadRegister(4);
+  int32_t length = machine->ReadRegister(5);
+  std::shared_ptr<Descriptor> descriptor =
+      currentThread->openFiles->Get(fileId);
+  if (length > 0 && descriptor != nullptr &&
+      descriptor->Kind() == FILE_DESCRIPTOR) {
+    // Open the file again: Open uses O_APPEND, which would put every page
+    // written back at the end, and the mapping outlives Close
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d",
+             descriptor->HostHandle());
+    int unixHandle = open(path, O_RDWR);
+    if (unixHandle == -1) {
+      DEBUG('o', "Unable to map file %d: %s\n", fileId, strerror(errno));
+    } else {
+      address = currentThread->space->mapFile(unixHandle, length);
+      if (address == -1) {
+        close(unixHandle);
+      }
+    }
+  }
+#endif
+  machine->WriteRegister(2, address);
+  NachOS_IncreasePC();
+}
+
+/**
+ * @brief Unmaps a file mapped by Mmap, writing its modified pages back.
+ * Files still mapped are unmapped when the address space goes away.
+ * System call interface: int Munmap(int address)
+ * @param register 4 contains the address Mmap returned.
+ * @return 0 in register 2, -1 if no file is mapped there.
+ */
+void NachOS_Munmap() {  // System call 40
+  int32_t status = -1;
+#ifdef VM
+  int32_t address = machine->ReadRegister(4);
+  if (currentThread->space->unmapFile(address)) {
+    status = 0;
+  }
+#endif
+  machine->WriteRegister(2, status);
+  NachOS_IncreasePC();
+}
+
 #ifdef VM
 #define HARD_FAULT_DIRTY 0
 #define HARD_FAULT_CLEAN 1
 #define SOFT_FAULT 2
 #define COPY_ON_WRITE_FAULT 3
+#define MAPPED_FILE_FAULT 4
 
 int NachOS_PAGE_FAULT_HANDLER() {
   stats->numPageFaults++;
-  int a = stats->numPageFaults;
+  currentThread->accounting.pageFaults++;
   DEBUG('y', "Page fault handler\n");
   // 1. Get the faulting address
   u_int32_t faultingAddress = machine->ReadRegister(BadVAddrReg);
@@ -1001,8 +1191,12 @@ int NachOS_PAGE_FAULT_HANDLER() {
   u_int32_t pageNumber = faultingAddress / PageSize;
   int faultType;
   u_int32_t numOfPages = currentThread->space->getNumPages();
-  // 3. Check if the page number is valid
-  if (pageNumber >= numOfPages) {
+  MappedFile* mappedFile = currentThread->space->findMappedFile(pageNumber);
+  // 3. Check if the page number is valid: past the program, only the pages
+  // of files still mapped are
+  if (pageNumber >= numOfPages ||
+      (pageNumber >= currentThread->space->getProgramPages() &&
+       mappedFile == nullptr)) {
     DEBUG('x', "Illegal page fault. Exiting.\n");
     currentThread->Finish();
     return -1;
@@ -1013,8 +1207,10 @@ int NachOS_PAGE_FAULT_HANDLER() {
     faultType = COPY_ON_WRITE_FAULT;
     /* 5. Check if it's a hard page fault*/
   } else if (pageTable[pageNumber].valid == false) {
-    // Check if the page is dirty
-    if (pageTable[pageNumber].dirty) {
+    if (mappedFile != nullptr) {
+      // The page is part of a mapped file. Read it from the file.
+      faultType = MAPPED_FILE_FAULT;
+    } else if (pageTable[pageNumber].dirty) {  // Check if the page is dirty
       // The page is in the swap. Load it from the swap space.
       faultType = HARD_FAULT_DIRTY;
     } else {  // The page is clean. Load it from the executable.
@@ -1057,9 +1253,12 @@ int NachOS_PAGE_FAULT_HANDLER() {
 
 void ExceptionHandler(ExceptionType which) {
   int type = machine->ReadRegister(2);
+  int startTicks = stats->totalTicks;
 
   switch (which) {
-    case SyscallException:
+    case SyscallException: {
+      SYSCALL_TRACE_SCOPE(type);
+      currentThread->accounting.syscalls++;
       switch (type) {
         case SC_Halt:  // System call # 0
           NachOS_Halt();
@@ -1139,6 +1338,19 @@ void ExceptionHandler(ExceptionType which) {
           NachOS_CondBroadcast();
           break;
 
+        case SC_RWLockCreate:  // System call # 24
+          NachOS_RWLockCreate();
+          break;
+        case SC_RWLockDestroy:  // System call # 25
+          NachOS_RWLockDestroy();
+          break;
+        case SC_RWLockAcquire:  // System call # 26
+          NachOS_RWLockAcquire();
+          break;
+        case SC_RWLockRelease:  // System call # 27
+          NachOS_RWLockRelease();
+          break;
+
         case SC_Socket:  // System call # 30
           NachOS_Socket();
           break;
@@ -1158,12 +1370,38 @@ void ExceptionHandler(ExceptionType which) {
           NachOS_Shutdown();
           break;
 
+        case SC_BarrierCreate:  // System call # 36
+          NachOS_BarrierCreate();
+          break;
+        case SC_BarrierDestroy:  // System call # 37
+          NachOS_BarrierDestroy();
+          break;
+        case SC_BarrierWait:  // System call # 38
+          NachOS_BarrierWait();
+          break;
+
+        case SC_Mmap:  // System call # 39
+          NachOS_Mmap();
+          break;
+        case SC_Munmap:  // System call # 40
+          NachOS_Munmap();
+          break;
+
+        case SC_SetNonBlocking:  // System call # 41
+          NachOS_SetNonBlocking();
+          break;
+        case SC_Poll:  // System call # 42
+          NachOS_Poll();
+          break;
+
         default:
           printf("Unexpected syscall exception %d\n", type);
           ASSERT(false);
           break;
       }
+      stats->syscallLatency.Add(stats->totalTicks - startTicks);
       break;
+    }
 
     case PageFaultException: {
       NachOS_PAGE_FAULT_HANDLER();
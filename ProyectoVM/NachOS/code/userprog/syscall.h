@@ -45,6 +45,10 @@
 #define SC_CondSignal	21
 #define SC_CondWait	22
 #define SC_CondBroadcast	23
+#define SC_RWLockCreate	24
+#define SC_RWLockDestroy	25
+#define SC_RWLockAcquire	26
+#define SC_RWLockRelease	27
 
 /*
  *  Socket system calls
@@ -56,6 +60,25 @@
 #define SC_Accept	34
 #define SC_Shutdown	35
 
+/*
+ *  Barrier system calls
+ */
+#define SC_BarrierCreate	36
+#define SC_BarrierDestroy	37
+#define SC_BarrierWait	38
+
+/*
+ *  Memory mapped files
+ */
+#define SC_Mmap		39
+#define SC_Munmap	40
+
+/*
+ *  Non-blocking sockets and waiting on several handles
+ */
+#define SC_SetNonBlocking	41
+#define SC_Poll		42
+
 #ifndef IN_ASM
 
 /* The system call interface.  These are the operations the Nachos
@@ -196,6 +219,53 @@ int CondWait( Cond_t condId, Lock_t lockId );
 /* CondBroadcast awakes all waiting threads on this variable */
 int CondBroadcast( Cond_t condId, Lock_t lockId );
 
+typedef int RWLock_t;
+/* Modes of RWLockAcquire */
+#define RW_READ		0
+#define RW_WRITE	1
+/* RWLockCreate creates a reader-writer lock. Waiting writers go first
+ * unless "fair" is not zero, then a writer leaving the lock lets the
+ * waiting readers in before the next writer. Returns the lock id, -1 on
+ * failure
+ */
+RWLock_t RWLockCreate( int fair );
+
+/* RWLockDestroy destroys a reader-writer lock, returns -1 if there is none */
+int RWLockDestroy( RWLock_t rwId );
+
+/* RWLockAcquire obtains the lock for reading (RW_READ), shared with other
+ * readers, or for writing (RW_WRITE), alone
+ */
+int RWLockAcquire( RWLock_t rwId, int mode );
+
+/* RWLockRelease releases the lock, in the mode it was acquired */
+int RWLockRelease( RWLock_t rwId );
+
+typedef int Barrier_t;
+/* BarrierCreate creates a barrier for "count" threads, returns its id */
+Barrier_t BarrierCreate( int count );
+
+/* BarrierDestroy destroys a barrier, returns -1 if there is none */
+int BarrierDestroy( Barrier_t barrierId );
+
+/* BarrierWait blocks until "count" threads are waiting on the barrier,
+ * then they all go on and the barrier is ready for the next round
+ */
+int BarrierWait( Barrier_t barrierId );
+
+/* Mmap maps the first "length" bytes of the open file "id" into the
+ * address space, and returns the address of the first one, -1 on failure.
+ * Loads and stores there read and write the file, a page at a time, with
+ * no further system calls; the file must stay as long as "length"
+ */
+int Mmap( OpenFileId id, int length );
+
+/* Munmap writes back the modified pages of the file mapped at "address"
+ * (as returned by Mmap) and unmaps it; returns -1 if there is none.
+ * Files still mapped are unmapped at Exit
+ */
+int Munmap( int address );
+
 /*
  *  NachOS sockets system call family
  */
@@ -228,6 +298,35 @@ int Accept( Socket_t SockId );
 /* Shutdowns a socket connection, mode indicates Read, Write, ReadWrite */
 int Shutdown( Socket_t SockId, int mode );
 
+/* Returned by an operation on a non-blocking socket that would have to wait */
+#define WOULD_BLOCK_NachOS	-2
+
+/* SetNonBlocking makes a socket non-blocking ("nonBlocking" not zero), or
+ * blocking again.  Then Read, Write and Accept return WOULD_BLOCK_NachOS
+ * instead of waiting; Write writes what fits, and returns how much it was.
+ * Connect returns WOULD_BLOCK_NachOS while the connection is on its way;
+ * once Poll says the socket is ready for writing, Connect again returns 0
+ * if it went through, -1 if it failed.  Either way, only the calling thread
+ * ever waits on a socket, never the other ones.  Returns -1 if there is
+ * no such socket
+ */
+int SetNonBlocking( Socket_t SockId, int nonBlocking );
+
+/* Events of Poll */
+#define POLLIN_NachOS		1	/* can read, or accept */
+#define POLLOUT_NachOS		2	/* can write, or connected */
+#define POLLERR_NachOS		4	/* failed; only in the results */
+#define POLLHUP_NachOS		8	/* closed by the peer; only in the results */
+
+/* Poll waits until one of "count" handles -- sockets, open files or the
+ * console -- is ready for the events asked for it, "events[ i ]" for
+ * "handles[ i ]", or until "timeout" ticks have gone by (-1 waits for
+ * ever, 0 doesn't wait at all).  On return, "events[ i ]" holds what
+ * "handles[ i ]" is ready for.  Files are always ready.  Returns how many
+ * handles are ready, 0 if the time is up, -1 on error
+ */
+int Poll( int * handles, int * events, int count, int timeout );
+
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */
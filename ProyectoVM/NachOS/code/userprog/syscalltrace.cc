@@ -0,0 +1,147 @@
+// syscalltrace.cc
+//	System call tracer and latency profiler, see syscalltrace.h.
+
+#include "syscalltrace.h"
+
+#ifdef SYSCALL_TRACE
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "syscall.h"
+#include "system.h"
+
+/**
+ * @brief Name of a system call number, for the report.
+ */
+static const char* SyscallName(int syscall) {
+  switch (syscall) {
+    case SC_Halt: return "Halt";
+    case SC_Exit: return "Exit";
+    case SC_Exec: return "Exec";
+    case SC_Join: return "Join";
+    case SC_Create: return "Create";
+    case SC_Open: return "Open";
+    case SC_Read: return "Read";
+    case SC_Write: return "Write";
+    case SC_Close: return "Close";
+    case SC_Fork: return "Fork";
+    case SC_Yield: return "Yield";
+    case SC_SemCreate: return "SemCreate";
+    case SC_SemDestroy: return "SemDestroy";
+    case SC_SemSignal: return "SemSignal";
+    case SC_SemWait: return "SemWait";
+    case SC_LckCreate: return "LckCreate";
+    case SC_LckDestroy: return "LckDestroy";
+    case SC_LckAcquire: return "LckAcquire";
+    case SC_LckRelease: return "LckRelease";
+    case SC_CondCreate: return "CondCreate";
+    case SC_CondDestroy: return "CondDestroy";
+    case SC_CondSignal: return "CondSignal";
+    case SC_CondWait: return "CondWait";
+    case SC_CondBroadcast: return "CondBroadcast";
+    case SC_RWLockCreate: return "RWLockCreate";
+    case SC_RWLockDestroy: return "RWLockDestroy";
+    case SC_RWLockAcquire: return "RWLockAcquire";
+    case SC_RWLockRelease: return "RWLockRelease";
+    case SC_Socket: return "Socket";
+    case SC_Connect: return "Connect";
+    case SC_Bind: return "Bind";
+    case SC_Listen: return "Listen";
+    case SC_Accept: return "Accept";
+    case SC_Shutdown: return "Shutdown";
+    case SC_BarrierCreate: return "BarrierCreate";
+    case SC_BarrierDestroy: return "BarrierDestroy";
+    case SC_BarrierWait: return "BarrierWait";
+    case SC_Mmap: return "Mmap";
+    case SC_Munmap: return "Munmap";
+    case SC_SetNonBlocking: return "SetNonBlocking";
+    case SC_Poll: return "Poll";
+    default: return "?";
+  }
+}
+
+int64_t SyscallTracer::HostNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+void SyscallTracer::Add(int syscall, int startTick, int64_t startNs) {
+  if (syscall < 0 || syscall >= MAX_SYSCALLS) {
+    return;
+  }
+  Record& record = ring[recorded % RING_SIZE];
+  record.syscall = syscall;
+  record.threadId = currentThread->getThreadId();
+  record.startTick = startTick;
+  record.ticks = stats->totalTicks - startTick;
+  record.hostNs = HostNanoseconds() - startNs;
+  recorded++;
+
+  totals[syscall].count++;
+  totals[syscall].ticks += record.ticks;
+  totals[syscall].hostNs += record.hostNs;
+}
+
+void SyscallTracer::Report() {
+  int64_t kept = std::min<int64_t>(recorded, RING_SIZE);
+  if (kept == 0) {
+    return;
+  }
+  // latencies of the calls still in the ring, per system call
+  std::vector<int64_t> latencies[MAX_SYSCALLS];
+  for (int64_t i = 0; i < kept; i++) {
+    latencies[ring[i].syscall].push_back(ring[i].hostNs);
+  }
+
+  printf("\nSystem calls (percentiles over the last %lld calls):\n",
+         static_cast<long long>(kept));
+  printf("%-14s %8s %10s %10s %10s %10s %10s %10s\n", "syscall", "count",
+         "ticks", "avg ticks", "p50 ns", "p90 ns", "p99 ns", "max ns");
+  for (int syscall = 0; syscall < MAX_SYSCALLS; syscall++) {
+    const Totals& total = totals[syscall];
+    if (total.count == 0) {
+      continue;
+    }
+    std::vector<int64_t>& sample = latencies[syscall];
+    std::sort(sample.begin(), sample.end());
+    auto percentile = [&sample](double fraction) -> long long {
+      if (sample.empty()) return 0;
+      size_t index = static_cast<size_t>(fraction * (sample.size() - 1));
+      return sample[index];
+    };
+    printf("%-14s %8lld %10lld %10lld %10lld %10lld %10lld %10lld\n",
+           SyscallName(syscall), static_cast<long long>(total.count),
+           static_cast<long long>(total.ticks),
+           static_cast<long long>(total.ticks / total.count), percentile(0.5),
+           percentile(0.9), percentile(0.99), percentile(1.0));
+  }
+
+  // slowest calls still in the ring, by host time
+  std::vector<Record> slowest(ring, ring + kept);
+  int shown = std::min<int64_t>(TOP_N, kept);
+  std::partial_sort(slowest.begin(), slowest.begin() + shown, slowest.end(),
+                    [](const Record& a, const Record& b) {
+                      return a.hostNs > b.hostNs;
+                    });
+  printf("Slowest %d calls:\n", shown);
+  printf("%-14s %8s %10s %10s %12s\n", "syscall", "thread", "at tick",
+         "ticks", "ns");
+  for (int i = 0; i < shown; i++) {
+    printf("%-14s %8d %10d %10d %12lld\n", SyscallName(slowest[i].syscall),
+           slowest[i].threadId, slowest[i].startTick, slowest[i].ticks,
+           static_cast<long long>(slowest[i].hostNs));
+  }
+}
+
+SyscallTraceScope::SyscallTraceScope(int syscallNumber)
+    : syscall(syscallNumber),
+      startTick(stats->totalTicks),
+      startNs(SyscallTracer::HostNanoseconds()) {}
+
+SyscallTraceScope::~SyscallTraceScope() {
+  syscallTracer->Add(syscall, startTick, startNs);
+}
+#endif  // SYSCALL_TRACE
@@ -0,0 +1,82 @@
+// syscalltrace.h
+//	System call tracer and latency profiler.
+//
+//	Compiled in only when SYSCALL_TRACE is defined (for instance
+//	"make TRACE=-DSYSCALL_TRACE"), otherwise SYSCALL_TRACE_SCOPE expands
+//	to nothing and the dispatch in ExceptionHandler is untouched.
+
+#ifndef SYSCALL_TRACE_H
+#define SYSCALL_TRACE_H
+
+#ifdef SYSCALL_TRACE
+#include <cstdint>
+
+/**
+ * @brief Keeps the last RING_SIZE system calls in a ring buffer, plus
+ * running totals per system call number.
+ *
+ * Percentiles and the slowest calls are computed from the ring buffer when
+ * the report is printed, so they describe the most recent calls only. Halt
+ * and Exit never return to the dispatcher, so they are not recorded.
+ */
+class SyscallTracer {
+ public:
+  static const int RING_SIZE = 8192;
+  static const int MAX_SYSCALLS = 64;
+  static const int TOP_N = 10;
+
+  /// One traced system call.
+  struct Record {
+    int16_t syscall;   ///< system call number (SC_*)
+    int16_t threadId;  ///< thread id of the caller
+    int startTick;     ///< stats->totalTicks when the call started
+    int ticks;         ///< simulated ticks spent in the call
+    int64_t hostNs;    ///< host nanoseconds spent in the call
+  };
+
+  /**
+   * @brief Record a finished system call.
+   * @param syscall The system call number.
+   * @param startTick Simulated time when the call entered the kernel.
+   * @param startNs Host time, from HostNanoseconds(), when it entered.
+   */
+  void Add(int syscall, int startTick, int64_t startNs);
+
+  /// Print the per-syscall table and the slowest calls to stdout.
+  void Report();
+
+  /// Host monotonic clock, in nanoseconds.
+  static int64_t HostNanoseconds();
+
+ private:
+  struct Totals {
+    int64_t count{0};
+    int64_t ticks{0};
+    int64_t hostNs{0};
+  };
+  Record ring[RING_SIZE];         ///< last calls, oldest overwritten first
+  int64_t recorded{0};            ///< calls recorded so far
+  Totals totals[MAX_SYSCALLS];    ///< totals over every call
+};
+
+/**
+ * @brief Measures the system call dispatched in its scope, and hands it to
+ * the tracer when the scope is left.
+ */
+class SyscallTraceScope {
+ public:
+  explicit SyscallTraceScope(int syscallNumber);
+  ~SyscallTraceScope();
+
+ private:
+  int syscall;
+  int startTick;
+  int64_t startNs;
+};
+
+#define SYSCALL_TRACE_SCOPE(type) SyscallTraceScope syscallTraceScope(type)
+#else
+#define SYSCALL_TRACE_SCOPE(type)
+#endif  // SYSCALL_TRACE
+
+#endif  // SYSCALL_TRACE_H
@@ -1,110 +1,201 @@
 // Include the header file for Filestable
 #include "table.h"
 
-void OpenFilesTable::Print() {
-  // for all possible files
-  for (int file = 0; file < MAX_OPEN_FILES; file++) {
-    // if current file position is open
-    if (this->isOpened(file)) {
-      // print the NachOs handle and Unix Handle
-      printf("%i, %i\n", file, this->openFiles[file]);
-    }
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "syscall.h"
+#include "system.h"
+
+/*DESCRIPTOR*/
+void Descriptor::HandleClosed() {
+  closed = true;
+  // the console isn't closed on the host, and other processes wait for it
+  if (kind != CONSOLE_DESCRIPTOR) {
+    sysPoller->Cancel(HostHandle());
   }
 }
-// Constructor for OpenFilesTable class
-OpenFilesTable::OpenFilesTable() {
-  // Initializing array to store open file handles
-  openFiles = new int[MAX_OPEN_FILES];
-  // Setting all elements of array to -1 to indicate no open files
-  for (int16_t i = 0; i < MAX_OPEN_FILES; i++) {
-    openFiles[i] = -1;
+
+/*CONSOLE*/
+int ConsoleDescriptor::HostHandle() const {
+  return output ? STDOUT_FILENO : STDIN_FILENO;
+}
+
+int32_t ConsoleDescriptor::Read(char* buffer, int32_t size) {
+  if (output) {
+    // Console output isn't valid for reading
+    return -1;
   }
-  // Creating a BitMap to manage open files
-  filesMap = new BitMap(MAX_OPEN_FILES);
-  // Marking the 0th and 1st file as open (usually standard input and output)
-  filesMap->Mark(0);
-  filesMap->Mark(1);
-  // Setting usage counter to 0
-  // Set the Unix handles of the first two entries as 0 and 1, representing
-  // stdin and stdout
-  openFiles[0] = 0;
-  openFiles[1] = 1;
-}
-
-// Method to open a file using a Unix handle
-int OpenFilesTable::Open(int UnixHandle) {
-  // Placeholder for the file handle
-  int handle = 0;
-  // Variables to track if file is open and to be reopened
-  bool fileIsOpen = 0;
-  bool reopen = false;
-  // Iterating over the BitMap to check for open files
-  for (int fileIndex = 0; fileIndex < MAX_OPEN_FILES; fileIndex++) {
-    fileIsOpen = filesMap->Test(fileIndex);
-    bool handlesAreEqual = (openFiles[fileIndex] == UnixHandle);
-    // If the file is open and handles match, mark file for reopening
-    if (fileIsOpen && handlesAreEqual) {
-      reopen = true;
-      handle = fileIndex;
-    }
+  // Use semaphore to restrict access to console input (semaphore 3)
+  sysSemaphoreTable->GetSemaphore(3)->P();
+  std::string line;
+  std::getline(std::cin, line);
+  sysSemaphoreTable->GetSemaphore(3)->V();
+  int32_t readChar = std::min(static_cast<int32_t>(line.size()), size);
+  memcpy(buffer, line.data(), readChar);
+  return readChar;
+}
+
+int32_t ConsoleDescriptor::Write(const char* buffer, int32_t size) {
+  if (!output) {
+    DEBUG('o', "Writing to console input is not allowed!\n");
+    return -1;
   }
-  // If file is marked for reopening, return the handle
-  if (reopen == true) {
-    return handle;
+  // Use system semaphore to restrict access to console output (semaphore 0)
+  sysSemaphoreTable->GetSemaphore(0)->P();
+  DEBUG('o', "Writing to console output...\n");
+  int32_t bytesWritten = write(STDOUT_FILENO, buffer, size);
+  if (bytesWritten == -1) {
+    DEBUG('o', "Error writing to console output!\n");
+    DEBUG('o', "Error: %s\n", strerror(errno));
   }
-  // If not reopening, find the next available handle
-  handle = filesMap->Find();
-  // If a handle was found and the corresponding entry in the openFiles array
-  // unused, assign the Unix handle
-  if (handle != -1) {
-    if (openFiles[handle] == -1) {
-      openFiles[handle] = UnixHandle;
-      filesMap->Mark(handle);
-    } else {
-      DEBUG('f', "Error: Unix handle already exists in openFiles array\n");
-    }
+  sysSemaphoreTable->GetSemaphore(0)->V();
+  return bytesWritten;
+}
+
+/*FILE*/
+FileDescriptor::~FileDescriptor() {
+  sysPoller->Forget(unixHandle);
+  if (close(unixHandle) == -1) {
+    DEBUG('c', "Unable to close file %d (UNIX): %s\n", unixHandle,
+          strerror(errno));
   }
-  // Return the handle
-  return handle;
 }
 
-// Method to close a file using a Nachos handle
-int OpenFilesTable::Close(int NachosHandle) {
-  // If file is open, close it and return the Unix handle
-  if (isOpened(NachosHandle)) {
-    int UnixHandle = getUnixHandle(NachosHandle);
-    filesMap->Clear(NachosHandle);
-    openFiles[NachosHandle] = -1;
-    return UnixHandle;
+int32_t FileDescriptor::Read(char* buffer, int32_t size) {
+  DEBUG('w', "Reading from file %d (UNIX)...\n", unixHandle);
+  return read(unixHandle, buffer, size);
+}
+
+int32_t FileDescriptor::Write(const char* buffer, int32_t size) {
+  // Use system semaphore to restrict access to file (semaphore 1)
+  sysSemaphoreTable->GetSemaphore(1)->P();
+  int32_t bytesWritten = write(unixHandle, buffer, size);
+  if (bytesWritten == -1) {
+    DEBUG('o', "Error writing to file %d (UNIX): %s\n", unixHandle,
+          strerror(errno));
   } else {
-    return -1;
+    DEBUG('o', "Successfully wrote %d bytes to file %d (UNIX).\n",
+          bytesWritten, unixHandle);
   }
+  sysSemaphoreTable->GetSemaphore(1)->V();
+  return bytesWritten;
 }
 
-// Method to retrieve Unix handle from a Nachos handle
-int OpenFilesTable::getUnixHandle(int nachosHandle) {
-  // If file is open, return Unix handle
-  if (isOpened(nachosHandle)) {
-    return openFiles[nachosHandle];
-  } else {
-    return -1;
+/*SOCKET*/
+/**
+ * @brief Tells whether a socket operation failed only because the host
+ * socket wasn't ready.
+ * @param e The exception the operation threw.
+ * @return True if the operation must be tried again once the socket is ready.
+ */
+static bool WouldBlock(const SocketException& e) {
+  return e.errorCode() == EAGAIN || e.errorCode() == EWOULDBLOCK ||
+         e.errorCode() == EINPROGRESS || e.errorCode() == EALREADY;
+}
+
+SocketDescriptor::~SocketDescriptor() { sysPoller->Forget(HostHandle()); }
+
+int32_t SocketDescriptor::Operation(
+    int16_t events, const std::function<int32_t()>& operation) {
+  for (;;) {
+    try {
+      return operation();
+    } catch (const SocketException& e) {
+      if (!WouldBlock(e)) {
+        DEBUG('y', "Socket %d: %s\n", HostHandle(), e.what());
+        return -1;
+      }
+      if (nonBlocking) {
+        return WOULD_BLOCK_NachOS;
+      }
+      if (IsClosed()) {
+        DEBUG('y', "Socket %d was closed while waiting\n", HostHandle());
+        return -1;
+      }
+      sysPoller->WaitFor(HostHandle(), events);
+    }
   }
 }
 
-// Method to check if a file is open using a Nachos handle
-bool OpenFilesTable::isOpened(int nachosHandle) {
-  // Check if file is marked as open in BitMap
-  return filesMap->Test(nachosHandle);
+int32_t SocketDescriptor::Read(char* buffer, int32_t size) {
+  return Operation(POLLIN, [&] { return socket->sockRead(buffer, size); });
+}
+
+int32_t SocketDescriptor::Write(const char* buffer, int32_t size) {
+  int32_t sent = 0;
+  int32_t bytesWritten;
+  do {
+    bytesWritten = Operation(POLLOUT, [&] {
+      return socket->sockWrite(buffer + sent, size - sent);
+    });
+    if (bytesWritten > 0) {
+      sent += bytesWritten;
+    }
+  } while (bytesWritten > 0 && sent < size && !nonBlocking);
+  return (sent > 0) ? sent : bytesWritten;
+}
+
+/*OPEN FILES TABLE*/
+void OpenFilesTable::Print() {
+  static const char* kindNames[] = {"console", "file", "socket"};
+  // for all possible handles
+  for (int file = 0; file < MAX_OPEN_FILES; file++) {
+    // if current handle is open, print it with its host descriptor
+    if (descriptors[file] != nullptr) {
+      printf("%i, %s %i\n", file, kindNames[descriptors[file]->Kind()],
+             descriptors[file]->HostHandle());
+    }
+  }
+}
+
+// Constructor for OpenFilesTable class
+OpenFilesTable::OpenFilesTable() {
+  // Creating a BitMap to manage the handles
+  filesMap = new BitMap(MAX_OPEN_FILES);
+  // Handles 0 and 1 are the console input and output
+  descriptors[ConsoleInput] = std::make_shared<ConsoleDescriptor>(false);
+  descriptors[ConsoleOutput] = std::make_shared<ConsoleDescriptor>(true);
+  filesMap->Mark(ConsoleInput);
+  filesMap->Mark(ConsoleOutput);
 }
 
 // Destructor for OpenFilesTable class
-OpenFilesTable::~OpenFilesTable() {
-  delete[] openFiles;
-  delete filesMap;
+OpenFilesTable::~OpenFilesTable() { delete filesMap; }
+
+// Method to add a descriptor, returning its handle
+int OpenFilesTable::Open(std::shared_ptr<Descriptor> descriptor) {
+  // Find the next available handle
+  int handle = filesMap->Find();
+  if (handle != -1) {
+    descriptors[handle] = std::move(descriptor);
+  }
+  return handle;
 }
 
-// Method to add an entry to the openFiles array
-void OpenFilesTable::addEntry(int NachosHandle, int UnixHandle) {
-  openFiles[NachosHandle] = UnixHandle;
-  filesMap->Mark(NachosHandle);
-}
\ No newline at end of file
+// Method to take a descriptor out, using its Nachos handle
+int OpenFilesTable::Close(int nachosHandle) {
+  if (Get(nachosHandle) == nullptr) {
+    return -1;
+  }
+  descriptors[nachosHandle]->HandleClosed();
+  descriptors[nachosHandle].reset();
+  filesMap->Clear(nachosHandle);
+  return 0;
+}
+
+// Method to get the socket behind a handle
+std::shared_ptr<SocketDescriptor> OpenFilesTable::GetSocket(
+    int nachosHandle) const {
+  std::shared_ptr<Descriptor> descriptor = Get(nachosHandle);
+  if (descriptor == nullptr || descriptor->Kind() != SOCKET_DESCRIPTOR) {
+    return nullptr;
+  }
+  return std::static_pointer_cast<SocketDescriptor>(descriptor);
+}
@@ -1,31 +1,225 @@
 
 #ifndef OPENFILESTABLE_H
 #define OPENFILESTABLE_H
+/**
+ * @file table.h
+ * @brief The descriptors a user process has open: the console, its files and
+ * its sockets, all in one table.
+ * @details A handle is an index in the table of the process, whatever it
+ * stands for; each entry knows what it is (Kind) and how to do I/O on it
+ * (its virtual methods), so a Read, Write or Close finds it with a single
+ * array index. The threads of a process (see Fork) share the table; Exec
+ * starts a new one.
+ */
+#include <functional>
+#include <memory>
+
 #include "bitmap.h"
+#include "sysSocket.h"
+
+/**
+ * @brief What a descriptor stands for.
+ */
+enum DescriptorKind { CONSOLE_DESCRIPTOR, FILE_DESCRIPTOR, SOCKET_DESCRIPTOR };
+
+class Descriptor {
+ public:
+  /**
+   * @brief Constructor.
+   * @param descriptorKind - What the descriptor stands for.
+   */
+  explicit Descriptor(DescriptorKind descriptorKind) : kind(descriptorKind) {}
+
+  /**
+   * @brief Destructor. Closes what the descriptor stands for on the host.
+   */
+  virtual ~Descriptor() {}
+
+  /**
+   * @brief What the descriptor stands for.
+   */
+  DescriptorKind Kind() const { return kind; }
+
+  /**
+   * @brief Called when its handle is closed. The threads still waiting for
+   * it (in Poll, or in a blocking socket operation) stop waiting.
+   */
+  void HandleClosed();
+
+  /**
+   * @brief Whether its handle was closed.
+   */
+  bool IsClosed() const { return closed; }
+
+  /**
+   * @brief The host descriptor behind it, to poll it.
+   */
+  virtual int HostHandle() const = 0;
+
+  /**
+   * @brief Reads up to "size" bytes into "buffer".
+   * @return How many bytes were read, or -1 on error.
+   */
+  virtual int32_t Read(char* buffer, int32_t size) = 0;
+
+  /**
+   * @brief Writes "size" bytes from "buffer".
+   * @return How many bytes were written, or -1 on error.
+   */
+  virtual int32_t Write(const char* buffer, int32_t size) = 0;
+
+ private:
+  DescriptorKind kind;
+  bool closed{false};
+};
+
+/**
+ * @brief The console: handle 0 reads from it, handle 1 writes to it.
+ */
+class ConsoleDescriptor : public Descriptor {
+ public:
+  /**
+   * @param isOutput - True for the console output, false for its input.
+   */
+  explicit ConsoleDescriptor(bool isOutput)
+      : Descriptor(CONSOLE_DESCRIPTOR), output(isOutput) {}
+  int HostHandle() const override;
+  /**
+   * @brief Reads a line, without its end of line.
+   */
+  int32_t Read(char* buffer, int32_t size) override;
+  int32_t Write(const char* buffer, int32_t size) override;
+
+ private:
+  bool output;
+};
+
+/**
+ * @brief A host file, opened by Open or Create.
+ */
+class FileDescriptor : public Descriptor {
+ public:
+  /**
+   * @param handle - The host file; the descriptor closes it.
+   */
+  explicit FileDescriptor(int handle)
+      : Descriptor(FILE_DESCRIPTOR), unixHandle(handle) {}
+  ~FileDescriptor() override;
+  int HostHandle() const override { return unixHandle; }
+  int32_t Read(char* buffer, int32_t size) override;
+  int32_t Write(const char* buffer, int32_t size) override;
+
+ private:
+  int unixHandle;
+};
+
+/**
+ * @brief A socket. The host socket is always non-blocking, so that no
+ * operation on it stops Nachos (see sysPoller.h); to the user program, it is
+ * blocking until SetNonBlocking says otherwise.
+ */
+class SocketDescriptor : public Descriptor {
+ public:
+  /**
+   * @param hostSocket - The socket, already non-blocking on the host; the
+   * descriptor deletes it.
+   */
+  explicit SocketDescriptor(sysSocket* hostSocket)
+      : Descriptor(SOCKET_DESCRIPTOR), socket(hostSocket), nonBlocking(false) {}
+  ~SocketDescriptor() override;
+  int HostHandle() const override { return socket->getIDSocket(); }
+  int32_t Read(char* buffer, int32_t size) override;
+  /**
+   * @brief A blocking socket writes it all, a non-blocking one what fits.
+   */
+  int32_t Write(const char* buffer, int32_t size) override;
+
+  /**
+   * @brief Runs an operation on the socket the way the user program wants
+   * it. On a non-blocking socket, it is tried once. Otherwise, whenever the
+   * host socket isn't ready, the calling thread parks in the poller until it
+   * is, and tries again; the other threads keep running meanwhile.
+   * @param events - What the host socket must be ready for (POLLIN, POLLOUT).
+   * @param operation - The operation; it throws SocketException when it
+   * fails.
+   * @return What the operation returns, WOULD_BLOCK_NachOS if the socket is
+   * non-blocking and not ready, or -1 if the operation failed or the handle
+   * was closed while waiting.
+   */
+  int32_t Operation(int16_t events, const std::function<int32_t()>& operation);
+
+  /**
+   * @brief The socket itself.
+   */
+  sysSocket* Socket() const { return socket.get(); }
+
+  /**
+   * @brief Sets whether the user program wants the socket non-blocking.
+   */
+  void SetNonBlocking(bool enabled) { nonBlocking = enabled; }
+
+ private:
+  std::unique_ptr<sysSocket> socket;
+  bool nonBlocking;
+};
+
 class OpenFilesTable {
  public:
-  OpenFilesTable();   // Initialize
-  ~OpenFilesTable();  // De-allocate
-
-  int Open(int UnixHandle);     // Register the file handle
-  int Close(int NachosHandle);  // Unregister the file handle
-  // bool isOpened( int NachosHandle, int idThread );
-  bool isOpened(int NachosHandle);
-  int getUnixHandle(int NachosHandle);  // Devuelve el UNIX handle, según el
-                                        // thread correspondiente y el nachos
-                                        // handle it
-  void addEntry(int NachosHandle, int UnixHandle);
-  void Print();  // Print contents
+  /**
+   * @brief Constructor. Handles 0 and 1 are the console.
+   */
+  OpenFilesTable();
+
+  /**
+   * @brief Destructor.
+   */
+  ~OpenFilesTable();
+
+  /**
+   * @brief Adds a descriptor to the table.
+   * @return Its handle, -1 if the table is full.
+   */
+  int Open(std::shared_ptr<Descriptor> descriptor);
+
+  /**
+   * @brief Takes a descriptor out of the table. The threads waiting on it
+   * stop waiting (see Descriptor::HandleClosed), and it is closed once they
+   * are done with it.
+   * @return 0, -1 if the handle isn't open.
+   */
+  int Close(int nachosHandle);
+
+  /**
+   * @brief The descriptor behind a handle, nullptr if it isn't open. Keep it
+   * while using it: another thread may close the handle meanwhile.
+   */
+  std::shared_ptr<Descriptor> Get(int nachosHandle) const {
+    return (nachosHandle >= 0 && nachosHandle < MAX_OPEN_FILES)
+               ? descriptors[nachosHandle]
+               : nullptr;
+  }
+
+  /**
+   * @brief The socket behind a handle, nullptr if it isn't an open socket.
+   */
+  std::shared_ptr<SocketDescriptor> GetSocket(int nachosHandle) const;
+
+  /**
+   * @brief Prints the open handles, with their kind and host descriptor.
+   */
+  void Print();
 
  private:
-  int* openFiles;    // A vector with user opened files
-  BitMap* filesMap;  // A bitmap to control our vector, controla los
-                     // archivos abiertos por cada thread (?)
-
-  // Para controlar todos los threads a la vez, se utiliza un vector de bitmaps,
-  // cada espacio del vector es un thread diferente, cada thread tiene entonces,
-  // su propio bitmap vector<BitMap*> *vecMapsOpenFiles; // Por ahora, se
-  // comenta esto para usar otra solución
   static const int16_t MAX_OPEN_FILES = 128;
+
+  /**
+   * @brief The descriptors, by handle; nullptr where none is open.
+   */
+  std::shared_ptr<Descriptor> descriptors[MAX_OPEN_FILES];
+
+  /**
+   * @brief Which handles are taken, to find a free one.
+   */
+  BitMap* filesMap;
 };
-#endif  // OPENFILESTABLE_H
\ No newline at end of file
+#endif  // OPENFILESTABLE_H
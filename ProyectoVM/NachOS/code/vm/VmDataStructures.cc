@@ -14,6 +14,9 @@ static void swapHeader(NoffHeader* noffH) {
   noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
   noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
+#include <unistd.h>
+
+#include <algorithm>
 #include <iostream>
 #include <vector>
 void MemoryManagementUnit::iptSnapshot() {
@@ -253,6 +256,9 @@ void MemoryManagementUnit::handlePageFault(int address, int virtualPage,
     case SOFT_FAULT:
       reloadTLBwithValidEntry(address, virtualPage, space);
       break;
+    case MAPPED_FILE_FAULT:
+      loadFromMappedFile(virtualPage, space);
+      break;
     default:
       break;
   }
@@ -265,13 +271,23 @@ void MemoryManagementUnit::evictPage() {
   // 2. Remove this page from memory and update the page table, TLB, and
   // invPageTable
   IPTEntry* evictedEntry = &this->invPageTable[frameNumber];
-  if (evictedEntry->dirty) {
+  MappedFile* mappedFile =
+      evictedEntry->space != nullptr
+          ? evictedEntry->space->findMappedFile(evictedEntry->virtualPage)
+          : nullptr;
+  if (evictedEntry->dirty && mappedFile != nullptr) {
+    // A page of a mapped file goes back to the file, and is clean again:
+    // the next fault on it reads it from there
+    writeBackMappedPage(frameNumber, *mappedFile);
+    evictedEntry->dirty = false;
+  } else if (evictedEntry->dirty) {
     // TODO: Write to swap before evicting
     // If the page is dirty, write it back to the swap file
   }
   // 2.1 if the page is in the TLB, remove it from the TLB
   if (evictedEntry->tlbLocation >= 0) {
     invalidateTLBEntry(evictedEntry->tlbLocation);
+    evictedEntry->tlbLocation = -1;
   }
   invalidateInvPageTableEntry(frameNumber);
   // 3. clear the main memory on that frame
@@ -390,7 +406,10 @@ int MemoryManagementUnit::reloadTLBwithValidEntry(int address, int virtualPage,
   if (iptEntry == nullptr) {
     return -1;
   }
-  int freeTLBEntry = findFreeTLBEntry();
+  // keep the TLB entry the page already has, if any
+  int freeTLBEntry = iptEntry->tlbLocation >= 0 ? iptEntry->tlbLocation
+                                                : findFreeTLBEntry();
+  iptEntry->tlbLocation = freeTLBEntry;
   this->TLB[freeTLBEntry].virtualPage = virtualPage;
   this->TLB[freeTLBEntry].physicalPage = iptEntry->physicalPage;
   this->TLB[freeTLBEntry].valid = true;
@@ -447,13 +466,89 @@ int MemoryManagementUnit::writePageToSwap(int virtualPage, addrSpaceId space) {
   return 0;
 }
 
+int MemoryManagementUnit::loadFromMappedFile(int virtualPage,
+                                             addrSpaceId space) {
+  MappedFile* file = space->findMappedFile(virtualPage);
+  if (file == nullptr) {
+    return -1;
+  }
+  int freeFrame = findFreeFrame();
+  int freeTLBEntry = findFreeTLBEntry();
+  // Read the part of the file in this page; past its end, the page is zeros
+  char* frame = &memory[freeFrame * PageSize];
+  int offset = (virtualPage - file->firstPage) * PageSize;
+  int size = std::min(static_cast<int>(PageSize), file->length - offset);
+  bzero(frame, PageSize);
+  if (pread(file->unixHandle, frame, size, offset) < 0) {
+    DEBUG('a', "Unable to read page %d of a mapped file\n", virtualPage);
+  }
+  invPageTable[freeFrame].virtualPage = virtualPage;
+  invPageTable[freeFrame].valid = true;
+  invPageTable[freeFrame].dirty = false;
+  invPageTable[freeFrame].space = space;
+  invPageTable[freeFrame].tlbLocation = freeTLBEntry;
+  TranslationEntry* pageTable = space->getPageTable();
+  pageTable[virtualPage].physicalPage = freeFrame;
+  pageTable[virtualPage].valid = true;
+  pageTable[virtualPage].dirty = false;
+  this->TLB[freeTLBEntry].virtualPage = virtualPage;
+  this->TLB[freeTLBEntry].physicalPage = freeFrame;
+  this->TLB[freeTLBEntry].valid = true;
+  this->TLB[freeTLBEntry].dirty = false;
+  this->TLB[freeTLBEntry].use = false;
+  this->TLB[freeTLBEntry].readOnly = false;
+  return freeFrame;
+}
+
+int MemoryManagementUnit::writeBackMappedPage(int frameNumber,
+                                              const MappedFile& file) {
+  int offset = (invPageTable[frameNumber].virtualPage - file.firstPage) *
+               PageSize;
+  // the last page may be only partly in the file; don't make the file longer
+  int size = std::min(static_cast<int>(PageSize), file.length - offset);
+  if (pwrite(file.unixHandle, &memory[frameNumber * PageSize], size, offset) !=
+      size) {
+    DEBUG('a', "Unable to write back page %d of a mapped file\n",
+          invPageTable[frameNumber].virtualPage);
+    return -1;
+  }
+  return 0;
+}
+
+void MemoryManagementUnit::releaseMappedFile(addrSpaceId space,
+                                             const MappedFile& file) {
+  TranslationEntry* pageTable = space->getPageTable();
+  for (u_int32_t page = file.firstPage; page < file.firstPage + file.numPages;
+       page++) {
+    IPTEntry* entry = findPage(page, space);
+    if (entry != nullptr) {
+      int frameNumber = entry->physicalPage;
+      if (entry->dirty) {
+        writeBackMappedPage(frameNumber, file);
+        entry->dirty = false;
+      }
+      int tlbEntry = findInTLB(page, frameNumber);
+      if (tlbEntry != -1) {
+        invalidateTLBEntry(tlbEntry);
+      }
+      entry->tlbLocation = -1;
+      invalidateInvPageTableEntry(frameNumber);
+      bzero(&memory[frameNumber * PageSize], PageSize);
+    }
+    pageTable[page].valid = false;
+    pageTable[page].physicalPage = -1;
+    pageTable[page].dirty = false;
+  }
+}
+
 u_int32_t MemoryManagementUnit::findLeastRecentlyUsed() {
   // 1. Loop through the invPageTable
   // 2. Keep track of the page with the smallest lastAccessCount
   // 3. Return the index of this page
   uint64_t minLastAccessCount = invPageTable[0].lastAccessCount;
   u_int32_t minLastAccessCountIndex = 0;
-  for (u_int32_t i = 1; i < this->invPageTable.size(); i++) {
+  // only the first IPT_SIZE entries are frames
+  for (u_int32_t i = 1; i < IPT_SIZE; i++) {
     if (invPageTable[i].lastAccessCount < minLastAccessCount) {
       minLastAccessCount = invPageTable[i].lastAccessCount;
       minLastAccessCountIndex = i;
@@ -471,7 +566,7 @@ u_int16_t MemoryManagementUnit::findTLBLeastRecentlyUsed() {
   int16_t IPTEntrysOnTLBIndex = 0;
   // Find all IPTEntrys on TLB
   for (u_int32_t i = 0; i < IPT_SIZE; i++) {
-    if (invPageTable[i].tlbLocation) {
+    if (invPageTable[i].virtualPage != -1 && invPageTable[i].tlbLocation >= 0) {
       if (IPTEntrysOnTLBIndex >= static_cast<int16_t>(IPTEntrysOnTLB.size())) {
         // handle the error, e.g., stop the loop, throw an exception, etc.
         break;
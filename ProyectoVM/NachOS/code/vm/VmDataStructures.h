@@ -15,6 +15,7 @@
 #define HARD_FAULT_CLEAN 1
 #define SOFT_FAULT 2
 #define COPY_ON_WRITE_FAULT 3
+#define MAPPED_FILE_FAULT 4
 // address space id
 class Swap;
 using addrSpaceId = AddrSpace*;
@@ -72,6 +73,15 @@ class MemoryManagementUnit {
   // loads a page from the swap file to memory
   int loadFromSwapToMemory(int virtualPage, addrSpaceId space);
   int writePageToSwap(int virtualPage, addrSpaceId space);
+  // loads a page of a file mapped by Mmap from the file to memory
+  int loadFromMappedFile(int virtualPage, addrSpaceId space);
+  /**
+   * @brief Takes the pages of a mapped file out of memory and out of the TLB,
+   * writing the modified ones back to the file (not to the swap)
+   * @param space - the address space the file is mapped in
+   * @param file - the mapping
+   */
+  void releaseMappedFile(addrSpaceId space, const MappedFile& file);
   /**
    * @brief when a soft page fault occurs, the page is in memory but not in the
    * TLB so we need to reload the TLB with the valid entry
@@ -106,6 +116,7 @@ class MemoryManagementUnit {
   int invalidatePageTableEntry(int virtualPage, addrSpaceId space);
   int loadPageToMemory(int address, int virtualPage, addrSpaceId space,
                        int frameNumber);
+  int writeBackMappedPage(int frameNumber, const MappedFile& file);
   void tlbSnapshot();
   void iptSnapshot();
   void memSnapshot();